@@ -0,0 +1,15 @@
+-- Box.lua
+-- Physics body for the boxes thrown around by spells, spawn it with a scale to change its size
+
+local body = BodyDef.new()
+body.type = Physics_DYNAMICBODY
+
+local fixture = FixtureDef.new()
+fixture:setShape(BoxShape(60, 60))
+fixture.density = 500
+fixture.friction = 100
+
+local boxBody = PhysicsPrefab.new()
+boxBody:setBody(body)
+boxBody:addFixture(fixture)
+return Resource_PHYSICS, "BoxBody", boxBody
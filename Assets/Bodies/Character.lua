@@ -0,0 +1,17 @@
+-- Character.lua
+-- Physics body for characters, an upright box that doesn't fall over
+
+local body = BodyDef.new()
+body.type = Physics_DYNAMICBODY
+body.isFixedRotation = true
+
+local fixture = FixtureDef.new()
+fixture:setShape(BoxShape(64, 128))
+fixture.density = 100
+fixture.friction = 10
+
+local characterBody = PhysicsPrefab.new()
+characterBody:setBody(body)
+characterBody:addFixture(fixture)
+characterBody:makeGroundSensor()
+return Resource_PHYSICS, "CharacterBody", characterBody
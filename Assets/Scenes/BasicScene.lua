@@ -51,13 +51,14 @@ local function onBegin()
   abilities:addAbility(2, "Flight")
 
   -- Make healthbar
+  -- Keep the entity rather than its sprite, components move when their entity changes
   print("Creating healthbar..")
-  local bar = World:createEntity()
-  local trans = bar:assignTransform()
+  healthbar = World:createEntity()
+  local trans = healthbar:assignTransform()
   trans.position = Vector2f.new(50, 50)
-  local ui = bar:assignUIWidget()
+  local ui = healthbar:assignUIWidget()
   ui.anchor = Vector2f.new(-1, -1)
-  healthbarSprite = bar:assignSprite()
+  local healthbarSprite = healthbar:assignSprite()
   healthbarSprite:setSprite("HealthbarTexture")
   healthbarSprite.origin = Vector2f.new(0, 0)
   healthbarSprite.size = Vector2f.new(1000, 4) healthbarSprite.scale = Vector2f.new(1, 5)
@@ -84,9 +85,10 @@ end
 
 -- On Update
 local function onUpdate(dt)
-  if (healthbarSprite ~= nil and player ~= nil and player:hasCombat()) then
+  if (healthbar ~= nil and healthbar.isValid and player ~= nil and player.isValid and player:hasCombat()) then
     local length = player:getCombat().currentHealth
     if length < 0 then length = 0 end
+    local healthbarSprite = healthbar:getSprite()
     healthbarSprite.size.x = (length * (Game.displaySize.x * 0.3 - 50)) / 100
     healthbarSprite:updateSprite()
   end
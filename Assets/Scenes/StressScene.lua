@@ -0,0 +1,91 @@
+-- StressScene.lua
+-- Spawns waves of entities that all expire on the same frame
+
+-- How many entities are in each wave and how long they live for
+local waveSize = 10000
+local waveLifetime = 2
+local timeUntilWave = 0
+
+-- Frame times are tracked around the frame the wave expires on
+local expiryTimer = -1
+local slowestFrame = 0
+local averageFrame = 0
+local frameCount = 0
+
+-- Spawn a grid of boxes that expire together
+local function spawnWave()
+  local size = Game.displaySize
+  local columns = 100
+  for i = 0, waveSize - 1 do
+    local e = World:createEntity()
+    local trans = e:assignTransform()
+    trans.position = Vector2f.new(
+      size.x * ((i % columns) + 0.5) / columns,
+      size.y * (math.floor(i / columns) + 0.5) / (waveSize / columns))
+    local sprite = e:assignSprite()
+    sprite:setSprite("BoxTexture")
+    sprite.size = Vector2f.new(8, 8)
+    expireEntity(e, waveLifetime)
+  end
+  print("Spawned " .. waveSize .. " entities")
+end
+
+-- When the scene is shown for the first time
+local function onBegin()
+  World.useCameraSystem()
+  World.useRenderSystem()
+  World.useExpirySystem()
+end
+
+-- On Update
+local function onUpdate(dt)
+  local ms = dt:asSeconds() * 1000
+
+  -- Measure every frame from just before the wave expires until the next one spawns
+  if expiryTimer >= 0 then
+    expiryTimer = expiryTimer + dt:asSeconds()
+    if expiryTimer >= waveLifetime - 0.25 then
+      if ms > slowestFrame then slowestFrame = ms end
+      averageFrame = averageFrame + ms
+      frameCount = frameCount + 1
+    end
+  end
+
+  -- Report the last wave and spawn the next
+  timeUntilWave = timeUntilWave - dt:asSeconds()
+  if timeUntilWave <= 0 then
+    if frameCount > 0 then
+      print(string.format("Expiry frames: slowest %.2fms, average %.2fms", slowestFrame, averageFrame / frameCount))
+    end
+    slowestFrame = 0
+    averageFrame = 0
+    frameCount = 0
+    expiryTimer = 0
+    timeUntilWave = waveLifetime + 1
+    spawnWave()
+  end
+end
+
+-- On Window events
+local function onWindowEvent(ev)
+
+  -- Key pressed
+  if ev.type == EventType_KeyPressed then
+
+    -- Toggle debug on F1
+    if ev.key.code == Key_F1 then
+      Game.debug = not Game.debug
+
+    -- Open console on F2
+    elseif ev.key.code == Key_F2 then
+      Game:openDevConsole()
+    end
+  end
+end
+
+-- Make and return the scene
+local scene = Scene.new()
+scene.onBegin = onBegin
+scene.onUpdate = onUpdate
+scene.onWindowEvent = onWindowEvent
+return Resource_SCENE, "StressScene", scene
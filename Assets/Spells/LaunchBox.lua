@@ -17,18 +17,9 @@ local function spawnBox(x, y, scale)
   sprite.scale = Vector2f.new(scale, scale)
   sprite:setSprite("BoxTexture")
   sprite:updateSprite()
-  local spriteSize = sprite.size
-  local boxBody = box:assignRigidBody()
-  local bodyDef = BodyDef.new()
-  bodyDef.type = Physics_DYNAMICBODY
-  local boxFixture = FixtureDef.new()
-  boxFixture.density = 500
-  boxFixture.friction = 100
   spawnPos = Vector2f.new(x, y)
   boxTrans.position = spawnPos
-  boxBody:instantiate(bodyDef)
-  boxFixture:setShape(BoxShape(60 * scale, 60 * scale))
-  boxBody:addFixture(boxFixture)
+  box:assignRigidBody("BoxBody", scale)
   return box
 end
 
@@ -45,19 +36,19 @@ end
 
 -- Hold it in place
 local function holdBox()
-  if boxToThrow ~= nil then
+  if boxToThrow ~= nil and boxToThrow.isValid then
     boxToThrow:getRigidBody():warpTo(spawnPos)
   end
 end
 
 -- Fire on spell release
 local function launchBox()
-  if boxToThrow ~= nil then
+  if boxToThrow ~= nil and boxToThrow.isValid then
     local throwScale = 25
     local impulse = Vector2f.new((Game.mousePosition.x - spawnPos.x) * throwScale, (Game.mousePosition.y - spawnPos.y) * throwScale)
     boxToThrow:getRigidBody():applyImpulseToCentre(impulse)
-    boxToThrow = nil
   end
+  boxToThrow = nil
 end
 
 -- Make and return the spell
@@ -2,23 +2,24 @@
 -- Levitates stuff
 
 -- Variables for this spell
-local nullbody = nil
+local nullbody = nil -- Entity holding the body, as its RigidBody can move
 local joint = nil
 
 -- Pick up an object
 local function beginLevitation()
-  if lastSpawnedBox ~= nil then
+  if lastSpawnedBox ~= nil and lastSpawnedBox.isValid then
 
     -- Make a null body if necessary
-    if nullbody == nil then
-      nullbody = World:createEntity():assignRigidBody()
+    if nullbody == nil or not nullbody.isValid then
+      nullbody = World:createEntity()
+      nullbody:assignRigidBody()
     end
 
     -- Use null body in creation of joint
     local def = MouseJointDef.new()
     local r = lastSpawnedBox:getRigidBody();
     def.target = r.location
-    def:setBodyA(nullbody)
+    def:setBodyA(nullbody:getRigidBody())
     def:setBodyB(r)
     def.maxForce = 500
     def.dampingRatio = 1
@@ -7,6 +7,18 @@ print("Running GameConfig.lua")
 -- Simply enable debug from the very beginning
 Game.debug = false
 
+-- How often to update and render each second, 0 runs as fast as possible
+-- With vsync, rendering is also held to the display's refresh rate
+-- Gameplay and physics always step at the simulation rate, rendering interpolates between steps
+-- If a frame falls more than maxSimulationSteps behind, the extra time is dropped
+FramePacing = {
+  updateRate = 120,
+  renderRate = 60,
+  simulationRate = 60,
+  maxSimulationSteps = 5,
+  vsync = false
+}
+
 -- Convenience function for spawning a character
 function spawnCharacter(pos, texture, hp)
   char = World:createEntity()
@@ -31,17 +43,7 @@ function spawnCharacter(pos, texture, hp)
   sprite:playAnimation("idle", true)
   local trans = char:assignTransform()
   trans.position = pos
-  local body = char:assignRigidBody()
-  local bodyDef = BodyDef.new()
-  bodyDef.type = Physics_DYNAMICBODY
-  bodyDef.isFixedRotation = true
-  body:instantiate(bodyDef)
-  fixture = FixtureDef.new()
-  fixture:setShape(BoxShape(64, 128))
-  fixture.density = 100
-  fixture.friction = 10
-  body:addFixture(fixture)
-  body:makeGroundSensor()
+  char:assignRigidBody("CharacterBody")
   return char
 end
 
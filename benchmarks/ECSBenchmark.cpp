@@ -0,0 +1,253 @@
+// ECSBenchmark.cpp
+// Measures the per-entity cost of iterating, spawning and sending events in the ECS
+
+#include "../src/ECS.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+// Components similar in size to the ones systems iterate every frame
+struct Position { float x = 0.f, y = 0.f; };
+struct Velocity { float x = 1.f, y = 1.f; };
+struct Health { int value = 100; };
+struct Tag { int id = 0; };
+
+// Time a function over a number of repeats and return nanoseconds per entity visited
+template<typename Func>
+double
+timePerEntity(size_t entityCount, int repeats, Func&& func) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    func();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  return ns / (double)(entityCount * repeats);
+}
+
+// Fill a world where only a quarter of entities match <Position, Velocity>
+void
+populate(ECS::World* world, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    auto* e = world->create();
+    e->assign<Position>();
+    if (i % 4 == 0) e->assign<Velocity>();
+    if (i % 3 == 0) e->assign<Health>();
+    if (i % 5 == 0) e->assign<Tag>();
+  }
+}
+
+// Stand-in for the old per-entity layout, where every component was its own heap allocation found through a map
+struct HeapContainer { virtual ~HeapContainer() {} };
+template<typename T> struct HeapComponent : HeapContainer { T data; };
+struct HeapEntity { std::unordered_map<std::type_index, HeapContainer*> components; };
+
+// Find a component in the old layout, or nullptr if the entity doesn't have it
+template<typename T>
+T*
+findHeapComponent(HeapEntity& e) {
+  auto found = e.components.find(typeid(T));
+  return found != e.components.end() ? &static_cast<HeapComponent<T>*>(found->second)->data : nullptr;
+}
+
+// Compare the old iteration pattern to the inlined archetype iteration
+void
+benchmarkIteration(size_t count, int repeats) {
+
+  auto* world = ECS::World::createWorld();
+  populate(world, count);
+
+  // Baseline: the way each() worked before entities were grouped into archetypes
+  // Every entity looks its components up in its own map, and matches are passed to a std::function callback
+  std::vector<HeapEntity> heapEntities(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto& components = heapEntities[i].components;
+    components[typeid(Position)] = new HeapComponent<Position>();
+    if (i % 4 == 0) components[typeid(Velocity)] = new HeapComponent<Velocity>();
+    if (i % 3 == 0) components[typeid(Health)] = new HeapComponent<Health>();
+    if (i % 5 == 0) components[typeid(Tag)] = new HeapComponent<Tag>();
+  }
+  float sink = 0.f;
+  const std::function<void(Position&, Velocity&)> wrapped = [&](Position& p, Velocity& v) {
+    p.x += v.x;
+    p.y += v.y;
+    sink += p.x;
+  };
+  const double legacy = timePerEntity(count, repeats, [&]() {
+    for (auto& e : heapEntities) {
+      Position* p = findHeapComponent<Position>(e);
+      Velocity* v = p != nullptr ? findHeapComponent<Velocity>(e) : nullptr;
+      if (v != nullptr) {
+        wrapped(*p, *v);
+      }
+    }
+  });
+  for (auto& e : heapEntities) {
+    for (auto& pair : e.components) { delete pair.second; }
+  }
+
+  // Archetype iteration with the lambda inlined into the loop
+  const double inlined = timePerEntity(count, repeats, [&]() {
+    world->each<Position, Velocity>([&](ECS::Entity* e, ECS::ComponentHandle<Position> p, ECS::ComponentHandle<Velocity> v) {
+      p->x += v->x;
+      p->y += v->y;
+      sink += p->x;
+    });
+  });
+
+  printf("== Iteration ==\n");
+  printf("Entities: %zu (%zu archetypes), repeats: %d\n", count, world->getArchetypeCount(), repeats);
+  printf("Per-entity map lookup, std::function: %8.3f ns/entity\n", legacy);
+  printf("Inlined archetype each():             %8.3f ns/entity\n", inlined);
+  printf("Speedup: %.2fx (checksum %f)\n", legacy / inlined, sink);
+
+  world->destroyWorld();
+}
+
+// Spawn entities shaped like floating damage numbers (three components) and expire them all at once
+void
+benchmarkSpawnExpire(size_t count, int cycles) {
+
+  // Baseline: one allocation per entity and per component
+  const double heap = timePerEntity(count, cycles, [&]() {
+    std::vector<HeapEntity*> entities;
+    entities.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      auto* e = new HeapEntity();
+      e->components[typeid(Position)] = new HeapComponent<Position>();
+      e->components[typeid(Health)] = new HeapComponent<Health>();
+      e->components[typeid(Tag)] = new HeapComponent<Tag>();
+      entities.push_back(e);
+    }
+    for (auto* e : entities) {
+      for (auto& pair : e->components) { delete pair.second; }
+      delete e;
+    }
+  });
+
+  // The world's pools, measuring the first cycle separately as it has to allocate chunks
+  auto* world = ECS::World::createWorld();
+  auto cycle = [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      auto* e = world->create();
+      e->assign<Position>();
+      e->assign<Health>();
+      e->assign<Tag>();
+    }
+    world->each<Tag>([&](ECS::Entity* e, ECS::ComponentHandle<Tag> t) {
+      world->destroy(e);
+    });
+    world->cleanup();
+  };
+  const double cold = timePerEntity(count, 1, cycle);
+  const double warm = timePerEntity(count, cycles, cycle);
+
+  const ECS::PoolStats entities = world->getEntityPoolStats();
+  const ECS::PoolStats components = world->getComponentPoolStats();
+
+  printf("== Spawn and expire ==\n");
+  printf("Entities per cycle: %zu, cycles: %d\n", count, cycles);
+  printf("Heap allocation per object:  %8.3f ns/entity\n", heap);
+  printf("Pooled, first cycle:         %8.3f ns/entity\n", cold);
+  printf("Pooled, recycled slots:      %8.3f ns/entity\n", warm);
+  printf("Entity pool: %zu slots in %zu chunks, %zu reused\n", entities.capacity, entities.chunks, entities.reused);
+  printf("Component columns: %zu slots in %zu chunks, %zu reused\n", components.capacity, components.chunks, components.reused);
+
+  world->destroyWorld();
+}
+
+// Events shaped like the ones combat sends every hit
+struct Damage { ECS::Entity* target; int amount; };
+
+// Count damage one event at a time
+struct DamageCounter : public ECS::EventSubscriber<Damage> {
+  long total = 0;
+  void receive(ECS::World* world, const Damage& event) override { total += event.amount; }
+};
+
+// Count damage once per flush
+struct DamageBatchCounter : public ECS::BatchEventSubscriber<Damage> {
+  long total = 0;
+  void receiveBatch(ECS::World* world, const std::vector<Damage>& events) override {
+    for (const auto& event : events) total += event.amount;
+  }
+};
+
+// Compare a hashed subscriber lookup per emit to indexed and batched dispatch
+void
+benchmarkEvents(size_t count, int repeats) {
+
+  auto* world = ECS::World::createWorld();
+
+  // Baseline: a map from type_index to subscribers, searched on every emit as emit() used to
+  DamageCounter mapped;
+  std::unordered_map<std::type_index, std::vector<ECS::Internal::BaseEventSubscriber*>> map;
+  map[typeid(Damage)].push_back(&mapped);
+  const double hashed = timePerEntity(count, repeats, [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      auto found = map.find(typeid(Damage));
+      if (found != map.end()) {
+        for (auto* base : found->second) {
+          static_cast<ECS::EventSubscriber<Damage>*>(base)->receive(world, { nullptr, 1 });
+        }
+      }
+    }
+  });
+
+  // Nobody listening, like OnEntityCreated in most scenes
+  const double unheard = timePerEntity(count, repeats, [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      world->emit<ECS::Events::OnEntityCreated>({ nullptr });
+    }
+  });
+
+  // One subscriber receiving each event
+  DamageCounter counter;
+  world->subscribe<Damage>(&counter);
+  const double indexed = timePerEntity(count, repeats, [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      world->emit<Damage>({ nullptr, 1 });
+    }
+  });
+  world->unsubscribe<Damage>(&counter);
+
+  // One batch subscriber receiving everything queued in a single call
+  DamageBatchCounter batchCounter;
+  world->subscribe<Damage>(&batchCounter);
+  const double batched = timePerEntity(count, repeats, [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      world->queue<Damage>({ nullptr, 1 });
+    }
+    world->flushEvents();
+  });
+  world->unsubscribe<Damage>(&batchCounter);
+
+  printf("== Events ==\n");
+  printf("Events: %zu, repeats: %d\n", count, repeats);
+  printf("Hashed lookup per emit:     %8.3f ns/event\n", hashed);
+  printf("Indexed, no subscribers:    %8.3f ns/event\n", unheard);
+  printf("Indexed, one subscriber:    %8.3f ns/event\n", indexed);
+  printf("Queued, one batch per tick: %8.3f ns/event\n", batched);
+  printf("Checksum: %ld\n", mapped.total + counter.total + batchCounter.total);
+
+  world->destroyWorld();
+}
+
+// Run every benchmark
+int
+main(int argc, char* argv[]) {
+
+  // Allow the entity count and repeats to be chosen on the command line
+  const size_t count = argc > 1 ? (size_t)std::atol(argv[1]) : 100000;
+  const int repeats = argc > 2 ? std::atoi(argv[2]) : 100;
+
+  benchmarkIteration(count, repeats);
+  benchmarkSpawnExpire(count, 10);
+  benchmarkEvents(count, repeats);
+  return 0;
+}
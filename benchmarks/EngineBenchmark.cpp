@@ -0,0 +1,371 @@
+// EngineBenchmark.cpp
+// Headless micro and macro benchmarks of the engine, written out as JSON to track regressions
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/Config.h"
+#include "../src/Game.h"
+#include "../src/Scene.h"
+#include "../src/Transform.h"
+#include "../src/Sprite.h"
+#include "../src/Animation.h"
+
+// How many units a sample processed, and how long that took
+struct Sample {
+  std::size_t count;
+  double ns;
+};
+
+// A measured benchmark, value is the median of every sample
+struct Result {
+  std::string name;
+  std::string unit;
+  double median;
+  double min;
+  std::size_t count;
+  int samples;
+};
+
+// Every result so far, in the order they ran
+static std::vector<Result> results;
+
+// How many times each benchmark is repeated
+static int sampleCount = 5;
+
+// Time a function in nanoseconds
+template<typename Func>
+double
+timeNs(Func&& func) {
+  const auto start = std::chrono::steady_clock::now();
+  func();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Run a benchmark several times and record the median time per unit, in the unit's scale (1 for ns, 1e6 for ms)
+// Each sample does its own setup and only times the part being measured
+void
+measure(const std::string& name, const std::string& unit, double scale, const std::function<Sample()>& func) {
+  std::vector<double> samples;
+  std::size_t count = 0;
+  for (int i = 0; i < sampleCount; ++i) {
+    const Sample sample = func();
+    count = sample.count;
+    samples.push_back(sample.ns / scale / (double)std::max<std::size_t>(count, 1));
+  }
+  std::sort(samples.begin(), samples.end());
+  results.push_back({ name, unit, samples[samples.size() / 2], samples.front(), count, sampleCount });
+  printf("%-28s %12.3f %-10s (min %.3f, %zu per sample)\n",
+    name.c_str(), results.back().median, unit.c_str(), results.back().min, count);
+}
+
+// Run some lua in the global state, where the current scene is available as World
+bool
+runLua(const std::string& code) {
+  auto attempt = Game::lua.safe_script(code, &sol::script_pass_on_error);
+  if (!attempt.valid()) {
+    sol::error err = attempt;
+    printf("Error: %s\n", err.what());
+    return false;
+  }
+  return true;
+}
+
+// A fresh scene made current for the length of a benchmark
+class BenchmarkScene {
+  public:
+
+    // Create and switch to an empty scene
+    BenchmarkScene()
+      : scene_(new Scene()) {
+      Game::switchScene(scene_);
+    }
+
+    // Switch away and release everything the scene created
+    ~BenchmarkScene() {
+      Game::switchScene(nullptr);
+      delete scene_;
+    }
+
+    // Get the scene
+    Scene& get() { return *scene_; }
+
+  private:
+
+    // The scene being benchmarked
+    Scene* scene_;
+};
+
+// Events shaped like the ones combat sends every hit
+struct BenchmarkDamage { ECS::Entity* target; int amount; };
+
+// Count damage one event at a time
+struct BenchmarkDamageCounter : public ECS::EventSubscriber<BenchmarkDamage> {
+  long total = 0;
+  void receive(ECS::World* world, const BenchmarkDamage& event) override { total += event.amount; }
+};
+
+// Creating and destroying entities with the components most things in a scene have
+void
+benchmarkCreateDestroy(std::size_t count) {
+  BenchmarkScene scene;
+  ECS::World* world = scene.get().getWorld();
+  measure("ecs.create_destroy", "ns/entity", 1.0, [&]() {
+    return Sample{ count, timeNs([&]() {
+      for (std::size_t i = 0; i < count; ++i) {
+        ECS::Entity* e = world->create();
+        e->assign<Transform>(e, (float)i, 0.f);
+        e->assign<Sprite>(e);
+      }
+      world->each<Transform>([&](ECS::Entity* e, ECS::ComponentHandle<Transform> t) {
+        world->destroy(e);
+      });
+      world->cleanup();
+    }) };
+  });
+}
+
+// Iterating entities with two components
+void
+benchmarkEach(std::size_t count, int repeats) {
+  BenchmarkScene scene;
+  ECS::World* world = scene.get().getWorld();
+  for (std::size_t i = 0; i < count; ++i) {
+    ECS::Entity* e = world->create();
+    e->assign<Transform>(e, (float)i, 0.f);
+    if (i % 2 == 0) { e->assign<Sprite>(e); }
+  }
+  float sink = 0.f;
+  measure("ecs.each", "ns/entity", 1.0, [&]() {
+    return Sample{ (count / 2) * repeats, timeNs([&]() {
+      for (int r = 0; r < repeats; ++r) {
+        world->each<Transform, Sprite>([&](ECS::Entity* e, ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<Sprite> s) {
+          t->position.x += 1.f;
+          sink += t->position.x;
+        });
+      }
+    }) };
+  });
+  if (sink == 0.f) { printf("Unexpected checksum\n"); }
+}
+
+// Emitting an event to a single subscriber
+void
+benchmarkEmit(std::size_t count) {
+  BenchmarkScene scene;
+  ECS::World* world = scene.get().getWorld();
+  BenchmarkDamageCounter counter;
+  world->subscribe<BenchmarkDamage>(&counter);
+  measure("ecs.emit", "ns/event", 1.0, [&]() {
+    return Sample{ count, timeNs([&]() {
+      for (std::size_t i = 0; i < count; ++i) {
+        world->emit<BenchmarkDamage>({ nullptr, 1 });
+      }
+    }) };
+  });
+  world->unsubscribe<BenchmarkDamage>(&counter);
+}
+
+// Advancing the animation of many sprites, a frame changes every few updates
+void
+benchmarkUpdateAnimation(std::size_t count, int repeats) {
+  BenchmarkScene scene;
+  ECS::World* world = scene.get().getWorld();
+  Animation animation;
+  for (int i = 0; i < 8; ++i) {
+    animation.addFrame(sf::IntRect(i * 32, 0, 32, 32));
+  }
+  std::vector<Sprite*> sprites;
+  for (std::size_t i = 0; i < count; ++i) {
+    ECS::Entity* e = world->create();
+    Sprite& sprite = e->assign<Sprite>(e).get();
+    sprite.setAnimation(&animation);
+    sprite.play();
+    sprites.push_back(&sprite);
+  }
+  const sf::Time dt = sf::seconds(1.f / 60.f);
+  measure("sprite.update_animation", "ns/sprite", 1.0, [&]() {
+    return Sample{ count * repeats, timeNs([&]() {
+      for (int r = 0; r < repeats; ++r) {
+        for (Sprite* sprite : sprites) {
+          sprite->updateAnimation(dt);
+        }
+      }
+    }) };
+  });
+}
+
+// Reading a component from lua, as scene and spell scripts do every frame
+void
+benchmarkLuaGetTransform(std::size_t count) {
+  BenchmarkScene scene;
+  runLua(
+    "benchmarkEntity = World:createEntity()\n"
+    "benchmarkEntity:assignTransform()\n"
+    "function benchmarkGetTransform(n)\n"
+    "  local sum = 0\n"
+    "  for i = 1, n do\n"
+    "    local t = benchmarkEntity:getTransform()\n"
+    "    sum = sum + t.position.x\n"
+    "  end\n"
+    "  return sum\n"
+    "end\n");
+  sol::protected_function func = Game::lua["benchmarkGetTransform"];
+  measure("lua.get_transform", "ns/call", 1.0, [&]() {
+    return Sample{ count, timeNs([&]() { func(count); }) };
+  });
+  runLua("benchmarkEntity = nil\nbenchmarkGetTransform = nil\n");
+}
+
+// Simulating a pile of dynamic boxes falling onto the ground
+void
+benchmarkPhysicsBoxes(std::size_t count, int ticks) {
+  measure("physics.boxes", "ms/tick", 1000000.0, [&]() {
+    BenchmarkScene scene;
+    runLua(
+      "World.usePhysicsSystem()\n"
+      "local ground = World:createEntity()\n"
+      "ground:assignTransform()\n"
+      "local groundFixture = FixtureDef.new()\n"
+      "groundFixture:setShape(LineShape(-100000, 0, 100000, 0))\n"
+      "ground:assignRigidBody():addFixture(groundFixture)\n"
+      "for i = 0, " + std::to_string(count) + " - 1 do\n"
+      "  local e = World:createEntity()\n"
+      "  e:assignTransform().position = Vector2f.new((i % 100) * 40 - 2000, -40 - math.floor(i / 100) * 40)\n"
+      "  local body = e:assignRigidBody()\n"
+      "  local def = BodyDef.new()\n"
+      "  def.type = Physics_DYNAMICBODY\n"
+      "  body:instantiate(def)\n"
+      "  local fixture = FixtureDef.new()\n"
+      "  fixture:setShape(BoxShape(32, 32))\n"
+      "  fixture.density = 1\n"
+      "  body:addFixture(fixture)\n"
+      "end\n");
+
+    // Only time the simulation
+    const sf::Time dt = sf::seconds(1.f / 60.f);
+    return Sample{ (std::size_t)ticks, timeNs([&]() {
+      for (int i = 0; i < ticks; ++i) {
+        scene.get().update(dt);
+      }
+    }) };
+  });
+}
+
+// Spawning characters like BasicScene's every tick, each expiring a second later
+void
+benchmarkSpawnStorm(std::size_t perTick, int ticks) {
+  measure("scene.spawn_storm", "ms/tick", 1000000.0, [&]() {
+    BenchmarkScene scene;
+    runLua(
+      "World.usePhysicsSystem()\n"
+      "World.useControlSystem()\n"
+      "World.useCameraSystem()\n"
+      "World.useRenderSystem()\n"
+      "World.useExpirySystem()\n"
+      "World.useStatSystem()\n"
+      "World.useCombatSystem()\n"
+      "World.useSpellSystem()\n"
+      "local ground = World:createEntity()\n"
+      "ground:assignTransform().position = Vector2f.new(0, 1000)\n"
+      "local groundFixture = FixtureDef.new()\n"
+      "groundFixture:setShape(LineShape(-100000, 0, 100000, 0))\n"
+      "ground:assignRigidBody():addFixture(groundFixture)\n"
+      "local spawned = 0\n"
+      "function benchmarkSpawn(n)\n"
+      "  for i = 1, n do\n"
+      "    local char = spawnCharacter(Vector2f.new((spawned % 200) * 80 - 8000, 0), \"OrcTexture\", 50)\n"
+      "    expireEntity(char, 1)\n"
+      "    spawned = spawned + 1\n"
+      "  end\n"
+      "end\n");
+    sol::protected_function spawn = Game::lua["benchmarkSpawn"];
+    const sf::Time dt = sf::seconds(1.f / 60.f);
+    const double ns = timeNs([&]() {
+      for (int i = 0; i < ticks; ++i) {
+        spawn(perTick);
+        scene.get().update(dt);
+      }
+    });
+    runLua("benchmarkSpawn = nil\n");
+    return Sample{ (std::size_t)ticks, ns };
+  });
+}
+
+// Write every result as JSON
+bool
+writeJson(const std::string& fp) {
+  FILE* file = fopen(fp.c_str(), "w");
+  if (file == nullptr) {
+    printf("Error: Could not open %s\n", fp.c_str());
+    return false;
+  }
+  fprintf(file, "{\n  \"suite\": \"engine\",\n");
+  fprintf(file, "  \"version\": \"%d.%d.%d\",\n", Build_VERSION_MAJOR, Build_VERSION_MINOR, Build_VERSION_TWEAK);
+#ifdef __VERSION__
+  fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+  fprintf(file, "  \"samples\": %d,\n  \"results\": [\n", sampleCount);
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"median\": %.4f, \"min\": %.4f, \"count\": %zu}%s\n",
+      r.name.c_str(), r.unit.c_str(), r.median, r.min, r.count, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  fclose(file);
+  printf("Wrote %zu results to %s\n", results.size(), fp.c_str());
+  return true;
+}
+
+// Run every benchmark
+// Usage: [--json FILE] [--samples N] [--quick]
+int
+main(int argc, char* argv[]) {
+
+  // Read the command line
+  std::string jsonPath;
+  bool quick = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--json" && i + 1 < argc) { jsonPath = argv[++i]; }
+    else if (arg == "--samples" && i + 1 < argc) { sampleCount = std::max(1, std::atoi(argv[++i])); }
+    else if (arg == "--quick") { quick = true; }
+    else { printf("Error: Unknown or incomplete option %s\n", arg.c_str()); return 1; }
+  }
+
+  // Start the engine without a window, keeping scripts deterministic
+  Game::setHeadless(Game::HeadlessSettings());
+  Game::initialise(sf::VideoMode(1920, 1080), "Benchmark");
+  if (Game::getStatus() != Game::Status::Ready) {
+    printf("Error: Could not initialise the engine, run from the directory containing GameConfig.lua\n");
+    return 1;
+  }
+  Console::setOutputToTerminal(false);
+  std::srand(0);
+  runLua("math.randomseed(0)");
+
+  // Smaller sizes for a quick check that everything still runs
+  const std::size_t scale = quick ? 10 : 1;
+
+  // Micro-benchmarks
+  benchmarkCreateDestroy(100000 / scale);
+  benchmarkEach(100000 / scale, 100);
+  benchmarkEmit(1000000 / scale);
+  benchmarkUpdateAnimation(100000 / scale, 100);
+  benchmarkLuaGetTransform(1000000 / scale);
+
+  // Macro-benchmarks
+  benchmarkPhysicsBoxes(2000 / scale, 300);
+  benchmarkSpawnStorm(20 / (quick ? 4 : 1), 300);
+
+  // Write the results
+  if (!jsonPath.empty() && !writeJson(jsonPath)) { return 1; }
+  Game::shutdown();
+  return 0;
+}
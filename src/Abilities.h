@@ -70,7 +70,7 @@ class Abilities : Component {
     bool castSpell(unsigned slot) {
       auto* spell = getSpell(slot);
       if (spell != nullptr) {
-        spell->cast(owner_);
+        spell->cast(owner_->getHandle());
         return true;
       }
       return false;
@@ -80,7 +80,7 @@ class Abilities : Component {
     bool releaseSpell(unsigned slot) {
       auto* spell = getSpell(slot);
       if (spell != nullptr) {
-        spell->release(owner_);
+        spell->release(owner_->getHandle());
         return true;
       }
       return false;
@@ -89,7 +89,7 @@ class Abilities : Component {
     // Passively casts a given spell in a slot
     void updateAllSpells(const sf::Time& dt) {
       for (auto i = spells_.begin(); i != spells_.end(); ++i) {
-        i->second.passive(owner_, dt);
+        i->second.passive(owner_->getHandle(), dt);
       }
     }
 
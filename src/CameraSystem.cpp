@@ -21,15 +21,26 @@ CameraSystem::registerCameraSystem(sol::environment& env, ECS::World* world) {
   });
 }
 
+// Constructor, moving the view must happen on the main thread once per frame
+CameraSystem::CameraSystem() {
+  setName("CameraSystem");
+  setUpdateGroup((unsigned)UpdateGroup::Presentation);
+  reads<Camera, Transform>();
+  setAffinity(Affinity::MainThread);
+}
+
 // Follow entities with Cameras
 void
 CameraSystem::update(ECS::World* world, const sf::Time& dt) {
 
+  // Follow where the entity is rendered, between simulation steps
+  const float alpha = Game::getInterpolation();
+
   // Find entities with cameras
   world->each<Camera, Transform>(
     [&](ECS::Entity* e, ECS::ComponentHandle<Camera> c, ECS::ComponentHandle<Transform> t) {
 
       // Combine position of transform and offset of camera
-      Game::view.setCenter(t->position + c->offset);
+      Game::view.setCenter(t->getInterpolatedPosition(alpha) + c->offset);
   });
 }
@@ -19,6 +19,9 @@ class CameraSystem : public ECS::EntitySystem {
     // Register Camera System in the world
     static void registerCameraSystem(sol::environment& env, ECS::World* world);
 
+    // Constructor, declare component access for scheduling
+    CameraSystem();
+
     // Manipulate the window's view every frame
     virtual void update(ECS::World* world, const sf::Time& dt) override;
 };
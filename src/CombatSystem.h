@@ -31,6 +31,12 @@ class CombatSystem : public ECS::EntitySystem {
       });
     }
 
+    // Constructor, dead entities are expired and lose possession so this runs exclusively
+    CombatSystem() {
+      setName("CombatSystem");
+      writes<Combat, Sprite, Expire, Possession>();
+    }
+
     // Manipulate the window's view every frame
     virtual void update(ECS::World* world, const sf::Time& dt) override {
 
@@ -4,6 +4,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include "Profiler.h"
 #include "ECS.h"
 #include "Sol.h"
 
@@ -11,6 +12,59 @@
 struct addDebugMenuEntryEvent {};
 struct addDebugInfoEvent {};
 
+// Groups that systems are updated in
+// The simulation runs at a fixed rate, presentation runs once per frame between simulation steps
+enum class UpdateGroup : unsigned { Simulation, Presentation };
+
+// Events for work that overlaps the rest of the frame
+// Background work can start once the scene has updated, and must be finished when synced
+struct BackgroundWorkStartEvent {};
+struct BackgroundWorkSyncEvent {};
+
+// How the scene's fixed step simulation is keeping up
+struct SimulationStats {
+
+  // Constructor
+  SimulationStats()
+    : steps(0)
+    , maxSteps(0)
+    , clamped(false)
+    , clampedUpdates(0)
+    , quality(1.f)
+    , load(0.f) {}
+
+  // How long each step is, and how many can be taken in one update
+  sf::Time step;
+  unsigned maxSteps;
+
+  // Steps taken in the last update
+  unsigned steps;
+
+  // Time waiting to be simulated after the last update, including any that was dropped
+  sf::Time backlog;
+
+  // Whether the last update hit the step limit and dropped time
+  bool clamped;
+
+  // How many updates have hit the step limit, and how much time they dropped altogether
+  unsigned clampedUpdates;
+  sf::Time dropped;
+
+  // How much work systems should do per step, from 0 to 1, lowered by adaptive simulation when it can't keep up
+  float quality;
+
+  // Smoothed share of real time spent simulating, only measured with adaptive simulation
+  float load;
+};
+
+// Sent when adaptive simulation changes quality, systems can do less work each step when it's lower
+struct SimulationQualityEvent {
+  float quality;
+};
+
+// Event for systems to report their statistics, such as at the end of a headless run
+struct ReportStatsEvent {};
+
 // Base class for all components
 class Component {
   public:
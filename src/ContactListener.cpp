@@ -4,6 +4,24 @@
 #include "ContactListener.h"
 #include "RigidBody.h"
 
+// Get the entity of a body, if it has one
+static ECS::EntityHandle
+getEntity(const b2Body* body) {
+  const RigidBody* rigidBody = static_cast<const RigidBody*>(body->GetUserData());
+  return rigidBody != nullptr ? rigidBody->getEntity() : ECS::EntityHandle();
+}
+
+// Constructor, make room for a busy step up front
+ContactListener::ContactListener() {
+  contacts_.reserve(256);
+}
+
+// Swap the recorded contacts into a list, so recording can carry on while they're handled
+void
+ContactListener::takeContacts(std::vector<ContactEvent>& contacts) {
+  contacts_.swap(contacts);
+}
+
 // When contact begins
 void 
 ContactListener::BeginContact(b2Contact* contact) {
@@ -18,7 +36,6 @@ ContactListener::BeginContact(b2Contact* contact) {
 
   // Get the velocity of the collision
   double impact = 0.0;
-  float mult = 0.f;
   if (fixtureAType != FixtureType::GroundSensor && fixtureBType != GroundSensor) {
 
     // Get the world manifold
@@ -43,40 +60,23 @@ ContactListener::BeginContact(b2Contact* contact) {
     impact = abs((vel1 - vel2).Length());
   }
 
-  // Check A for fixtures and bodies if it has userdata to pass to
-  if (bodyA->GetUserData() != nullptr) {
-    RigidBody* other = static_cast<RigidBody*>(bodyB->GetUserData());
-    static_cast<RigidBody*>(bodyA->GetUserData())->startContact(fixtureAType, other, impact);
-  }
-
-  // Check B for fixtures and bodies if it has userdata to pass to
-  if (bodyB->GetUserData() != nullptr) {
-    RigidBody* other = static_cast<RigidBody*>(bodyA->GetUserData());
-    static_cast<RigidBody*>(bodyB->GetUserData())->startContact(fixtureBType, other, impact);
-  }
+  // Record the contact to be handled after the step
+  contacts_.push_back({ true, getEntity(bodyA), getEntity(bodyB), fixtureAType, fixtureBType, impact });
 }
 
 // When the contact with an entity stops
 void 
 ContactListener::EndContact(b2Contact* contact) {
 
-  // Get bodies
-  b2Body* const bodyA = contact->GetFixtureA()->GetBody();
-  b2Body* const bodyB = contact->GetFixtureB()->GetBody();
-
   // Get fixtures
   FixtureType fixtureAType = static_cast<FixtureType>((long)contact->GetFixtureA()->GetUserData());
   FixtureType fixtureBType = static_cast<FixtureType>((long)contact->GetFixtureB()->GetUserData());
 
-  // Check A for fixtures and bodies if it has userdata to pass to
-  if (bodyA->GetUserData() != nullptr) {
-    RigidBody* other = static_cast<RigidBody*>(bodyB->GetUserData());
-    static_cast<RigidBody*>(bodyA->GetUserData())->endContact(fixtureAType, other);
-  }
-
-  // Check B for fixtures and bodies if it has userdata to pass to
-  if (bodyB->GetUserData() != nullptr) {
-    RigidBody* other = static_cast<RigidBody*>(bodyA->GetUserData());
-    static_cast<RigidBody*>(bodyB->GetUserData())->endContact(fixtureBType, other);
-  }
+  // Record the contact to be handled after the step
+  contacts_.push_back({ false,
+    getEntity(contact->GetFixtureA()->GetBody()),
+    getEntity(contact->GetFixtureB()->GetBody()),
+    fixtureAType,
+    fixtureBType,
+    0.0 });
 }
@@ -4,10 +4,12 @@
 #ifndef CONTACTLISTENER_H
 #define CONTACTLISTENER_H
 
+#include <vector>
+
 #include <Box2D/Box2D.h>
 
-// Forward declaration
-class RigidBody;
+#include "Profiler.h"
+#include "ECS.h"
 
 // Fixture classification
 enum FixtureType
@@ -15,10 +17,42 @@ enum FixtureType
 , GroundSensor
 };
 
-// Class which resolves collisions
+// A contact that started or ended during a physics step
+// Entities are held by handle, as they may be destroyed before the contact is handled
+struct ContactEvent {
+  bool began;
+  ECS::EntityHandle entityA;
+  ECS::EntityHandle entityB;
+  FixtureType fixtureA;
+  FixtureType fixtureB;
+  double impact;
+};
+
+// Sent by the physics system after each step with every contact that started or ended, in the order they happened
+struct PhysicsContactsEvent {
+  const std::vector<ContactEvent>& contacts;
+};
+
+// Class which records collisions
+// Nothing is handled during the step, contacts are collected so they can be handled together afterwards
 class ContactListener : public b2ContactListener {
-  void BeginContact(b2Contact* contact);
-  void EndContact(b2Contact* contact);
+  public:
+
+    // Constructor
+    ContactListener();
+
+    // Swap the recorded contacts into a list, which should be empty, so recording can carry on while they're handled
+    // Both lists keep their memory, so once they've grown nothing is allocated
+    void takeContacts(std::vector<ContactEvent>& contacts);
+
+  private:
+
+    // Contacts waiting to be handled
+    std::vector<ContactEvent> contacts_;
+
+    // Called by Box2D during a step
+    void BeginContact(b2Contact* contact);
+    void EndContact(b2Contact* contact);
 };
 
 #endif
@@ -26,7 +26,12 @@ ControlSystem::registerControlSystem(sol::environment& env, ECS::World* world) {
 }
 
 // Constructors
-ControlSystem::ControlSystem() {}
+// Casting spells calls into Lua, so this system runs exclusively
+ControlSystem::ControlSystem() {
+  setName("ControlSystem");
+  reads<Possession, Movement>();
+  writes<RigidBody, Sprite, Abilities>();
+}
 ControlSystem::~ControlSystem() {}
 
 // Control all possessed entities
@@ -26,10 +26,23 @@ SOFTWARE.
 
 #include <unordered_map>
 #include <functional>
+#include <memory>
 #include <vector>
+#include <array>
+#include <bitset>
 #include <algorithm>
+#include <atomic>
+#include <utility>
+#include <new>
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <stdint.h>
 #include <type_traits>
+#include <tuple>
 
 //////////////////////////////////////////////////////////////////////////
 // SETTINGS //
@@ -51,6 +64,49 @@ SOFTWARE.
 #define ECS_ALLOCATOR_TYPE std::allocator<ECS::Entity>
 #endif
 
+// Define the maximum number of distinct component types. Each archetype is identified by a bitset of this size.
+#ifndef ECS_MAX_COMPONENTS
+#define ECS_MAX_COMPONENTS 64
+#endif
+
+// Define how many rows of an archetype are allocated together. Components are stored by value in these chunks, with
+// an array per component type, so they move when their entity gains or loses a component, or when another entity
+// leaves the archetype. Pointers and ComponentHandles are only valid until then, use EntityHandles to keep hold of
+// entities for longer. Components must be move constructible.
+#ifndef ECS_COMPONENT_CHUNK_SIZE
+#define ECS_COMPONENT_CHUNK_SIZE 256
+#endif
+
+// Define how many entities are allocated together.
+#ifndef ECS_ENTITY_CHUNK_SIZE
+#define ECS_ENTITY_CHUNK_SIZE 256
+#endif
+
+// Define how many worker threads the world uses to run systems and parallelEach() in parallel. 0 uses one less than
+// the number of hardware threads. Define ECS_NO_WORKER_THREADS to do all work on the calling thread instead.
+#ifndef ECS_WORKER_THREADS
+#define ECS_WORKER_THREADS 0
+#endif
+//#define ECS_NO_WORKER_THREADS
+
+// Define how many entities parallelEach() hands to a task at once.
+#ifndef ECS_PARALLEL_CHUNK_SIZE
+#define ECS_PARALLEL_CHUNK_SIZE 512
+#endif
+
+// ECS_PROFILE_SCOPE(name) times the rest of a block. It is used around each system's update, cleanup and event
+// dispatch. The name is a const char* that stays valid for the whole program. It comes from Profiler.h, included
+// here so every file sees the same definition whichever order headers are included in. Define ECS_NO_PROFILER for
+// the whole build to use the ECS on its own without timing.
+#ifndef ECS_NO_PROFILER
+#include "Profiler.h"
+#ifndef ECS_PROFILE_SCOPE
+#error "ECS_PROFILE_SCOPE must be defined by Profiler.h"
+#endif
+#else
+#define ECS_PROFILE_SCOPE(name)
+#endif
+
 // Define ECS_TICK_NO_CLEANUP if you don't want the world to automatically cleanup dead entities
 // at the beginning of each tick. This will require you to call cleanup() manually to prevent memory
 // leaks.
@@ -135,6 +191,33 @@ namespace ECS
 	typedef float DefaultTickData;
 	typedef ECS_ALLOCATOR_TYPE Allocator;
 
+	/**
+	* Allocation statistics for a world's entity or component pools.
+	*/
+	struct PoolStats
+	{
+		// Objects currently alive
+		size_t live = 0;
+
+		// Slots allocated, live or free
+		size_t capacity = 0;
+
+		// Chunks allocated from ECS_ALLOCATOR_TYPE
+		size_t chunks = 0;
+
+		// Objects created in a slot recycled from the free list rather than a new one
+		size_t reused = 0;
+
+		PoolStats& operator+=(const PoolStats& other)
+		{
+			live += other.live;
+			capacity += other.capacity;
+			chunks += other.chunks;
+			reused += other.reused;
+			return *this;
+		}
+	};
+
 	// Do not use anything in the Internal namespace yourself.
 	namespace Internal
 	{
@@ -143,973 +226,2701 @@ namespace ECS
 
 		class EntityView;
 
-		struct BaseComponentContainer
+		typedef std::bitset<ECS_MAX_COMPONENTS> ComponentMask;
+
+		inline size_t nextComponentTypeId()
 		{
-		public:
-			virtual ~BaseComponentContainer() { }
+			static std::atomic<size_t> nextId(0);
+			return nextId++;
+		}
 
-			// This should only ever be called by the entity itself.
-			virtual void destroy(World* world) = 0;
+		// Component types get small, dense ids the first time they are used. These index archetype columns and masks.
+		template<typename T>
+		size_t getComponentTypeId()
+		{
+			static const size_t id = nextComponentTypeId();
+			assert(id < ECS_MAX_COMPONENTS && "Too many component types, increase ECS_MAX_COMPONENTS");
+			return id;
+		}
 
-			// This will be called by the entity itself
-			virtual void removed(Entity* ent) = 0;
-		};
+		inline size_t nextEventTypeId()
+		{
+			static std::atomic<size_t> nextId(0);
+			return nextId++;
+		}
 
-		class BaseEventSubscriber
+		// Event types get dense ids as well, so their subscribers can be found by indexing instead of hashing. With
+		// ECS_NO_RTTI the type registry already hands out dense indices, so those are used directly.
+		template<typename T>
+		size_t getEventTypeId()
 		{
-		public:
-			virtual ~BaseEventSubscriber() {};
-		};
-		
+#ifdef ECS_NO_RTTI
+			return getTypeIndex<T>();
+#else
+			static const size_t id = nextEventTypeId();
+			return id;
+#endif
+		}
+
 		template<typename... Types>
-		class EntityComponentIterator
+		ComponentMask makeComponentMask()
 		{
-		public:
-			EntityComponentIterator(World* world, size_t index, bool bIsEnd, bool bIncludePendingDestroy);
-
-			size_t getIndex() const
+			ComponentMask mask;
+			const size_t ids[] = { getComponentTypeId<Types>()..., 0 };
+			for (size_t i = 0; i < sizeof...(Types); ++i)
 			{
-				return index;
+				mask.set(ids[i]);
 			}
 
-			bool isEnd() const;
+			return mask;
+		}
 
-			bool includePendingDestroy() const
+		template<typename... Types>
+		const ComponentMask& getComponentMask()
+		{
+			static const ComponentMask mask = makeComponentMask<Types...>();
+			return mask;
+		}
+
+		/**
+		* A slab allocator for objects of one type. Objects are constructed in fixed size chunks and never move, and
+		* destroyed objects leave their slot on a free list to be reused by the next create().
+		*/
+		template<typename T, size_t ChunkSize>
+		class Pool
+		{
+		public:
+			struct Chunk
 			{
-				return bIncludePendingDestroy;
-			}
+				typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[ChunkSize];
+			};
 
-			World* getWorld() const
+			using ChunkAllocator = typename std::allocator_traits<ECS_ALLOCATOR_TYPE>::template rebind_alloc<Chunk>;
+
+			Pool(const ECS_ALLOCATOR_TYPE& alloc)
+				: chunkAlloc(alloc)
 			{
-				return world;
 			}
 
-			Entity* get() const;
+			Pool(const Pool&) = delete;
+			Pool& operator=(const Pool&) = delete;
 
-			Entity* operator*() const
+			// All objects must have been destroyed before the pool is.
+			~Pool()
 			{
-				return get();
+				for (Chunk* chunk : chunks)
+				{
+					std::allocator_traits<ChunkAllocator>::deallocate(chunkAlloc, chunk, 1);
+				}
 			}
 
-			bool operator==(const EntityComponentIterator<Types...>& other) const
+			template<typename... Args>
+			T* create(Args&&... args)
 			{
-				if (world != other.world)
-					return false;
+				void* slot;
+				if (!freeSlots.empty())
+				{
+					slot = freeSlots.back();
+					freeSlots.pop_back();
+					++stats.reused;
+				}
+				else
+				{
+					if (chunks.empty() || usedInLastChunk == ChunkSize)
+					{
+						chunks.push_back(std::allocator_traits<ChunkAllocator>::allocate(chunkAlloc, 1));
+						usedInLastChunk = 0;
+						++stats.chunks;
+						stats.capacity += ChunkSize;
+					}
+
+					slot = &chunks.back()->slots[usedInLastChunk++];
+				}
 
-				if (isEnd())
-					return other.isEnd();
+				++stats.live;
+				return new (slot) T(std::forward<Args>(args)...);
+			}
 
-				return index == other.index;
+			void destroy(T* object)
+			{
+				object->~T();
+				freeSlots.push_back(object);
+				--stats.live;
 			}
 
-			bool operator!=(const EntityComponentIterator<Types...>& other) const
+			PoolStats getStats() const
 			{
-				if (world != other.world)
-					return true;
+				return stats;
+			}
 
-				if (isEnd())
-					return !other.isEnd();
+		private:
+			ChunkAllocator chunkAlloc;
+			std::vector<Chunk*> chunks;
+			std::vector<void*> freeSlots;
+			size_t usedInLastChunk = 0;
+			PoolStats stats;
+		};
 
-				return index != other.index;
+		/**
+		* Type-erased operations on one component type, used by archetypes to move and destroy the components they
+		* store without knowing their types.
+		*/
+		class BaseComponentStorage
+		{
+		public:
+			BaseComponentStorage(size_t size)
+				: size(size)
+			{
 			}
 
-			EntityComponentIterator<Types...>& operator++();
+			virtual ~BaseComponentStorage() { }
 
-		private:
-			bool bIsEnd = false;
-			size_t index;
-			class ECS::World* world;
-			bool bIncludePendingDestroy;
+			// Emit OnComponentRemoved for the component. It is destroyed when its row leaves the archetype.
+			virtual void release(Entity* ent, void* component) = 0;
+
+			// Move a component into uninitialised memory, leaving the original to be destroyed.
+			virtual void moveConstruct(void* to, void* from) = 0;
+
+			virtual void destroy(void* component) = 0;
+
+			// Bytes between neighbouring components in a column
+			const size_t size;
 		};
 
-		template<typename... Types>
-		class EntityComponentView
+		template<typename T>
+		class ComponentStorage : public BaseComponentStorage
 		{
 		public:
-			EntityComponentView(const EntityComponentIterator<Types...>& first, const EntityComponentIterator<Types...>& last);
-
-			const EntityComponentIterator<Types...>& begin() const
+			ComponentStorage()
+				: BaseComponentStorage(sizeof(T))
 			{
-				return firstItr;
 			}
 
-			const EntityComponentIterator<Types...>& end() const
+			virtual void release(Entity* ent, void* component) override;
+
+			virtual void moveConstruct(void* to, void* from) override
 			{
-				return lastItr;
+				new (to) T(std::move(*static_cast<T*>(from)));
 			}
 
-		private:
-			EntityComponentIterator<Types...> firstItr;
-			EntityComponentIterator<Types...> lastItr;
+			virtual void destroy(void* component) override
+			{
+				static_cast<T*>(component)->~T();
+			}
 		};
-	}
 
-	/**
-	* Think of this as a pointer to a component. Whenever you get a component from the world or an entity,
-	* it'll be wrapped in a ComponentHandle.
-	*/
-	template<typename T>
-	class ComponentHandle
-	{
-	public:
-		ComponentHandle()
-			: component(nullptr)
+		/**
+		* An archetype groups every entity that has exactly the same set of components. Each component type in the set
+		* has a column, and every entity in the archetype has a row. Columns store their components by value in chunks
+		* of ECS_COMPONENT_CHUNK_SIZE rows, so iterating an archetype walks flat arrays and chunks never move once
+		* allocated, even while rows are added during iteration.
+		*
+		* The archetype graph is cached through addEdges/removeEdges so assigning or removing a component does not
+		* need to hash the component mask.
+		*/
+		struct Archetype
 		{
-		}
+			// Chunks are allocated as arrays of this, so components can't need stricter alignment
+			using Block = std::max_align_t;
+			using BlockAllocator = typename std::allocator_traits<ECS_ALLOCATOR_TYPE>::template rebind_alloc<Block>;
 
-		ComponentHandle(T* component)
-			: component(component)
-		{
-		}
+			struct Column
+			{
+				BaseComponentStorage* storage;
+				std::vector<unsigned char*> chunks;
 
-		T* operator->() const
-		{
-			return component;
-		}
+				void* at(size_t row) const
+				{
+					return chunks[row / ECS_COMPONENT_CHUNK_SIZE] + (row % ECS_COMPONENT_CHUNK_SIZE) * storage->size;
+				}
+			};
 
-		operator bool() const
-		{
-			return isValid();
-		}
+			Archetype(const ComponentMask& mask, BaseComponentStorage* const* storages, const ECS_ALLOCATOR_TYPE& alloc)
+				: mask(mask), blockAlloc(alloc)
+			{
+				columnIndex.fill(-1);
+				addEdges.fill(nullptr);
+				removeEdges.fill(nullptr);
+				for (size_t type = 0; type < ECS_MAX_COMPONENTS; ++type)
+				{
+					if (mask.test(type))
+					{
+						columnIndex[type] = static_cast<int>(types.size());
+						types.push_back(type);
+						columns.push_back({ storages[type], {} });
+					}
+				}
+			}
 
-		T& get()
-		{
-			return *component;
-		}
+			Archetype(const Archetype&) = delete;
+			Archetype& operator=(const Archetype&) = delete;
 
-		bool isValid() const
-		{
-			return component != nullptr;
-		}
+			// Every component must have been destroyed before the archetype is.
+			~Archetype()
+			{
+				for (auto& column : columns)
+				{
+					for (unsigned char* chunk : column.chunks)
+					{
+						std::allocator_traits<BlockAllocator>::deallocate(blockAlloc, reinterpret_cast<Block*>(chunk), getChunkBlocks(column));
+					}
+				}
+			}
 
-	private:
-		T* component;
-	};
+			bool has(size_t type) const
+			{
+				return columnIndex[type] >= 0;
+			}
 
-	/**
-	* A system that acts on entities. Generally, this will act on a subset of entities using World::each().
-	*
-	* Systems often will respond to events by subclassing EventSubscriber. You may use configure() to subscribe to events,
-	* but remember to unsubscribe in unconfigure().
-	*/
-	class EntitySystem
-	{
-	public:
-		virtual ~EntitySystem() {}
+			void* get(size_t type, size_t row) const
+			{
+				const int column = columnIndex[type];
+				return column >= 0 ? columns[column].at(row) : nullptr;
+			}
+
+			// Add a row for an entity, allocating a chunk for every column if the last one is full. The components in
+			// the row are left uninitialised for the caller to construct.
+			size_t addRow(Entity* ent)
+			{
+				const size_t row = entities.size();
+				if (row == capacity)
+				{
+					for (auto& column : columns)
+					{
+						Block* chunk = std::allocator_traits<BlockAllocator>::allocate(blockAlloc, getChunkBlocks(column));
+						column.chunks.push_back(reinterpret_cast<unsigned char*>(chunk));
+					}
+
+					capacity += ECS_COMPONENT_CHUNK_SIZE;
+				}
+
+				if (row < highestRow)
+				{
+					++reusedRows;
+				}
+				else
+				{
+					highestRow = row + 1;
+				}
+
+				entities.push_back(ent);
+				return row;
+			}
+
+			// Destroy every component in a row
+			void destroyRow(size_t row)
+			{
+				for (auto& column : columns)
+				{
+					column.storage->destroy(column.at(row));
+				}
+			}
+
+			// Move every component from one row into another whose components have been destroyed
+			void moveRow(size_t to, size_t from)
+			{
+				for (auto& column : columns)
+				{
+					column.storage->moveConstruct(column.at(to), column.at(from));
+					column.storage->destroy(column.at(from));
+				}
+			}
+
+			static size_t getChunkBlocks(const Column& column)
+			{
+				return (column.storage->size * ECS_COMPONENT_CHUNK_SIZE + sizeof(Block) - 1) / sizeof(Block);
+			}
+
+			ComponentMask mask;
+			std::vector<size_t> types;
+			std::array<int, ECS_MAX_COMPONENTS> columnIndex;
+			std::vector<Column> columns;
+			std::vector<Entity*> entities;
+
+			// Rows allocated, the most that have been used at once, and how many were added into a row used before
+			size_t capacity = 0;
+			size_t highestRow = 0;
+			size_t reusedRows = 0;
+
+			// Rows that were vacated while the world was being iterated. Their components are still alive, and are
+			// destroyed or moved when the archetype is compacted afterwards.
+			size_t tombstones = 0;
+
+			std::array<Archetype*, ECS_MAX_COMPONENTS> addEdges;
+			std::array<Archetype*, ECS_MAX_COMPONENTS> removeEdges;
+
+		private:
+			BlockAllocator blockAlloc;
+		};
 
 		/**
-		* Called when this system is added to a world.
+		* The archetypes matching a set of components. Archetypes are never destroyed, so the list only ever grows and
+		* is brought up to date by checking the archetypes created since the last time it was used.
 		*/
-		virtual void configure(World* world)
+		struct Query
 		{
-		}
+			std::vector<Archetype*> archetypes;
+			size_t archetypesChecked = 0;
+		};
 
-		/**
-		* Called when this system is being removed from a world.
-		*/
-		virtual void unconfigure(World* world)
+		struct EntitySlot
 		{
-		}
+			Entity* entity;
+			uint32_t generation;
+		};
 
 		/**
-		* Called when World::tick() is called. See ECS_TICK_TYPE at the top of this file for more
-		* information about passing data to tick.
+		* A fixed set of worker threads that run batches of tasks. Every thread has its own queue: a thread takes work
+		* from the back of its own queue and steals from the front of the others once it runs dry. The thread that
+		* submits a batch works on it too, and run() only returns once every task in the batch has finished, so batches
+		* may be submitted from inside other tasks.
 		*/
-#ifdef ECS_TICK_TYPE_VOID
-		virtual void update(World* world)
-#else
-		virtual void update(World* world, ECS_TICK_TYPE data)
-#endif
+		class TaskPool
 		{
-		}
-	};
+		public:
+			TaskPool(size_t threadCount)
+			{
+				// The last queue is shared by threads outside of the pool
+				for (size_t i = 0; i <= threadCount; ++i)
+				{
+					queues.emplace_back(new WorkQueue());
+				}
 
-	/**
-	* Subclass this as EventSubscriber<EventType> and then call World::subscribe() in order to subscribe to events. Make sure
-	* to call World::unsubscribe() or World::unsubscribeAll() when your subscriber is deleted!
-	*/
-	template<typename T>
-	class EventSubscriber : public Internal::BaseEventSubscriber
-	{
-	public:
-		virtual ~EventSubscriber() {}
+				for (size_t i = 0; i < threadCount; ++i)
+				{
+					workers.emplace_back([this, i]() { workerLoop(i); });
+				}
+			}
 
-		/**
-		* Called when an event is emitted by the world.
+			~TaskPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex);
+					bStopping = true;
+				}
+
+				wake.notify_all();
+				for (auto& worker : workers)
+				{
+					worker.join();
+				}
+
+				for (auto* queue : queues)
+				{
+					delete queue;
+				}
+			}
+
+			size_t getThreadCount() const
+			{
+				return workers.size();
+			}
+
+			/**
+			* Run every task, calling onCaller on the submitting thread while the workers start on the batch.
+			*/
+			void run(std::vector<std::function<void()>>& tasks, const std::function<void()>& onCaller = nullptr)
+			{
+				std::atomic<size_t> remaining(tasks.size());
+				const size_t home = getQueueIndex();
+
+				// Deal the batch out across every queue so that idle workers start without needing to steal
+				// Each task is counted before it can be popped, so the count can't drop below zero and wrap around
+				for (size_t i = 0; i < tasks.size(); ++i)
+				{
+					WorkQueue* queue = queues[(home + i) % queues.size()];
+					std::lock_guard<std::mutex> lock(queue->mutex);
+					++queuedCount;
+					queue->tasks.push_back({ &tasks[i], &remaining });
+				}
+
+				// Taking the lock means a worker can't miss the wake up between checking the count and sleeping
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex);
+				}
+
+				wake.notify_all();
+
+				if (onCaller)
+				{
+					onCaller();
+				}
+
+				// Help with any work rather than sleeping, which also keeps nested batches from deadlocking
+				while (remaining.load() > 0)
+				{
+					Task task;
+					if (tryPop(home, task))
+					{
+						execute(task);
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+			}
+
+		private:
+			struct Task
+			{
+				std::function<void()>* func;
+				std::atomic<size_t>* remaining;
+			};
+
+			struct WorkQueue
+			{
+				std::mutex mutex;
+				std::deque<Task> tasks;
+			};
+
+			// Which queue the current thread owns, or the shared queue for threads outside of the pool
+			size_t getQueueIndex() const
+			{
+				return currentPool() == this ? currentQueue() : workers.size();
+			}
+
+			static const TaskPool*& currentPool()
+			{
+				static thread_local const TaskPool* pool = nullptr;
+				return pool;
+			}
+
+			static size_t& currentQueue()
+			{
+				static thread_local size_t queue = 0;
+				return queue;
+			}
+
+			bool tryPop(size_t home, Task& task)
+			{
+				{
+					WorkQueue* own = queues[home];
+					std::lock_guard<std::mutex> lock(own->mutex);
+					if (!own->tasks.empty())
+					{
+						task = own->tasks.back();
+						own->tasks.pop_back();
+						--queuedCount;
+						return true;
+					}
+				}
+
+				for (size_t i = 1; i < queues.size(); ++i)
+				{
+					WorkQueue* victim = queues[(home + i) % queues.size()];
+					std::lock_guard<std::mutex> lock(victim->mutex);
+					if (!victim->tasks.empty())
+					{
+						task = victim->tasks.front();
+						victim->tasks.pop_front();
+						--queuedCount;
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			void execute(const Task& task)
+			{
+				(*task.func)();
+				--(*task.remaining);
+			}
+
+			void workerLoop(size_t index)
+			{
+				currentPool() = this;
+				currentQueue() = index;
+
+				while (true)
+				{
+					Task task;
+					if (tryPop(index, task))
+					{
+						execute(task);
+						continue;
+					}
+
+					std::unique_lock<std::mutex> lock(sleepMutex);
+					wake.wait(lock, [this]() { return bStopping || queuedCount.load() > 0; });
+					if (bStopping)
+						return;
+				}
+			}
+
+			std::vector<std::thread> workers;
+			std::vector<WorkQueue*> queues;
+			std::atomic<size_t> queuedCount{ 0 };
+			std::mutex sleepMutex;
+			std::condition_variable wake;
+			bool bStopping = false;
+		};
+
+		/**
+		* Structural changes recorded while systems or parallelEach() chunks run concurrently. Each buffer belongs to a
+		* single task, and buffers are executed in a fixed order at the next sync point so the result doesn't depend on
+		* how the work was spread across threads.
 		*/
-		virtual void receive(World* world, const T& event) = 0;
-	};
+		class CommandBuffer
+		{
+		public:
+			void push(std::function<void()>&& command)
+			{
+				commands.push_back(std::move(command));
+			}
 
-	namespace Events
-	{
-		// Called when a new entity is created.
-		struct OnEntityCreated
+			// Move another buffer's commands onto the end of this one
+			void append(CommandBuffer& other)
+			{
+				for (auto& command : other.commands)
+				{
+					commands.push_back(std::move(command));
+				}
+
+				other.commands.clear();
+			}
+
+			void execute()
+			{
+				for (auto& command : commands)
+				{
+					command();
+				}
+
+				commands.clear();
+			}
+
+			bool empty() const
+			{
+				return commands.empty();
+			}
+
+		private:
+			std::vector<std::function<void()>> commands;
+		};
+
+		// The command buffer structural changes on this thread are recorded into, if any
+		inline CommandBuffer*& currentCommandBuffer()
 		{
-			ECS_DECLARE_TYPE;
+			static thread_local CommandBuffer* buffer = nullptr;
+			return buffer;
+		}
 
-			Entity* entity;
+		// Record structural changes on this thread into a buffer for as long as this is alive
+		class CommandBufferScope
+		{
+		public:
+			CommandBufferScope(CommandBuffer* buffer)
+				: previous(currentCommandBuffer())
+			{
+				currentCommandBuffer() = buffer;
+			}
+
+			~CommandBufferScope()
+			{
+				currentCommandBuffer() = previous;
+			}
+
+		private:
+			CommandBuffer* previous;
 		};
 
-		// Called when an entity is about to be destroyed.
-		struct OnEntityDestroyed
+		class BaseEventSubscriber
 		{
-			ECS_DECLARE_TYPE;
+		public:
+			virtual ~BaseEventSubscriber() {};
+		};
 
-			Entity* entity;
+		class BaseEventQueue
+		{
+		public:
+			virtual ~BaseEventQueue() {}
+
+			// Hand the queued events to their subscribers and empty the queue
+			virtual void deliver(World* world) = 0;
 		};
 
-		// Called when a component is assigned (not necessarily created).
+		// Events of one type waiting for World::flushEvents()
 		template<typename T>
-		struct OnComponentAssigned
+		class EventQueue : public BaseEventQueue
 		{
-			ECS_DECLARE_TYPE;
+		public:
+			// Events for batch subscribers, which includes emitted events, and events for the other subscribers
+			std::vector<T> batched;
+			std::vector<T> queued;
 
-			Entity* entity;
-			ComponentHandle<T> component;
+			virtual void deliver(World* world) override;
 		};
 
-		// Called when a component is removed
-		template<typename T>
-		struct OnComponentRemoved
+		// The subscribers to one event type
+		struct SubscriberList
 		{
-			ECS_DECLARE_TYPE;
+			std::vector<BaseEventSubscriber*> each;
+			std::vector<BaseEventSubscriber*> batch;
+		};
+		
+		template<typename... Types>
+		class EntityComponentIterator
+		{
+		public:
+			EntityComponentIterator(World* world, size_t index, bool bIsEnd, bool bIncludePendingDestroy);
 
-			Entity* entity;
-			ComponentHandle<T> component;
+			size_t getIndex() const
+			{
+				return index;
+			}
+
+			bool isEnd() const;
+
+			bool includePendingDestroy() const
+			{
+				return bIncludePendingDestroy;
+			}
+
+			World* getWorld() const
+			{
+				return world;
+			}
+
+			Entity* get() const;
+
+			Entity* operator*() const
+			{
+				return get();
+			}
+
+			bool operator==(const EntityComponentIterator<Types...>& other) const
+			{
+				if (world != other.world)
+					return false;
+
+				if (isEnd())
+					return other.isEnd();
+
+				return index == other.index;
+			}
+
+			bool operator!=(const EntityComponentIterator<Types...>& other) const
+			{
+				if (world != other.world)
+					return true;
+
+				if (isEnd())
+					return !other.isEnd();
+
+				return index != other.index;
+			}
+
+			EntityComponentIterator<Types...>& operator++();
+
+		private:
+			bool bIsEnd = false;
+			size_t index;
+			class ECS::World* world;
+			bool bIncludePendingDestroy;
 		};
 
-#ifdef ECS_NO_RTTI
-		template<typename T>
-		ECS_DEFINE_TYPE(ECS::Events::OnComponentAssigned<T>);
-		template<typename T>
-		ECS_DEFINE_TYPE(ECS::Events::OnComponentRemoved<T>);
-#endif
-	}
+		template<typename... Types>
+		class EntityComponentView
+		{
+		public:
+			EntityComponentView(const EntityComponentIterator<Types...>& first, const EntityComponentIterator<Types...>& last);
+
+			const EntityComponentIterator<Types...>& begin() const
+			{
+				return firstItr;
+			}
+
+			const EntityComponentIterator<Types...>& end() const
+			{
+				return lastItr;
+			}
 
+		private:
+			EntityComponentIterator<Types...> firstItr;
+			EntityComponentIterator<Types...> lastItr;
+		};
+	}
 
 	/**
-	* A container for components. Entities do not have any logic of their own, except of that which to manage
-	* components. Components themselves are generally structs that contain data with which EntitySystems can
-	* act upon, but technically any data type may be used as a component, though only one of each data type
-	* may be on a single Entity at a time.
+	* Think of this as a pointer to a component. Whenever you get a component from the world or an entity,
+	* it'll be wrapped in a ComponentHandle. Like a pointer, it's left dangling once the component moves to another row.
 	*/
-	class Entity
+	template<typename T>
+	class ComponentHandle
 	{
 	public:
-		friend class World;
+		ComponentHandle()
+			: component(nullptr)
+		{
+		}
+
+		ComponentHandle(T* component)
+			: component(component)
+		{
+		}
+
+		T* operator->() const
+		{
+			return component;
+		}
+
+		operator bool() const
+		{
+			return isValid();
+		}
+
+		T& get()
+		{
+			return *component;
+		}
+
+		bool isValid() const
+		{
+			return component != nullptr;
+		}
+
+	private:
+		T* component;
+	};
+
+	/**
+	* A system that acts on entities. Generally, this will act on a subset of entities using World::each().
+	*
+	* Systems often will respond to events by subclassing EventSubscriber. You may use configure() to subscribe to events,
+	* but remember to unsubscribe in unconfigure().
+	*/
+	/**
+	* Systems are scheduled by the components they declare with reads<>() and writes<>(). Systems whose declarations
+	* don't conflict may be run at the same time, while conflicting systems always run in the order they were registered,
+	* so the result of a tick is the same as running every system one after another. The exception is structural changes
+	* made by non-exclusive systems, which are recorded and applied in registration order at the end of each wave.
+	*/
+	class EntitySystem
+	{
+	public:
+		enum class Affinity
+		{
+			// Can run on any thread alongside other systems. The system must only touch the components it declares and
+			// must not emit events. Creating or destroying entities and assigning or removing components is deferred
+			// until the end of the system's wave.
+			Any,
+
+			// Must run on the thread that calls World::update(), but can overlap with systems running on other threads.
+			// Use this for systems that touch state shared with the main thread, such as the window or view. Main thread
+			// systems are always run in the order they were registered, and their structural changes are deferred too.
+			MainThread,
+
+			// Runs on the thread that calls World::update() with no other system running. This is the default, and is
+			// required for systems that call into scripts or need their structural changes to happen immediately.
+			Exclusive
+		};
+
+		virtual ~EntitySystem() {}
+
+		/**
+		* Get the name used to identify this system, such as when profiling.
+		*/
+		const char* getName() const
+		{
+			return name;
+		}
+
+		Affinity getAffinity() const
+		{
+			return affinity;
+		}
+
+		/**
+		* Get the group this system is updated in. See World::updateGroup().
+		*/
+		unsigned getUpdateGroup() const
+		{
+			return updateGroup;
+		}
+
+		const Internal::ComponentMask& getReads() const
+		{
+			return readMask;
+		}
+
+		const Internal::ComponentMask& getWrites() const
+		{
+			return writeMask;
+		}
+
+		/**
+		* Does this system need to be ordered against another? Exclusive systems conflict with everything, main thread
+		* systems conflict with each other, otherwise two systems conflict if either writes a component the other reads
+		* or writes.
+		*/
+		bool conflictsWith(const EntitySystem& other) const
+		{
+			if (affinity == Affinity::Exclusive || other.affinity == Affinity::Exclusive)
+				return true;
+
+			if (affinity == Affinity::MainThread && other.affinity == Affinity::MainThread)
+				return true;
+
+			return (writeMask & (other.readMask | other.writeMask)).any() || (other.writeMask & readMask).any();
+		}
+
+		/**
+		* Called when this system is added to a world.
+		*/
+		virtual void configure(World* world)
+		{
+		}
+
+		/**
+		* Called when this system is being removed from a world.
+		*/
+		virtual void unconfigure(World* world)
+		{
+		}
+
+		/**
+		* Called when World::tick() is called. See ECS_TICK_TYPE at the top of this file for more
+		* information about passing data to tick.
+		*/
+#ifdef ECS_TICK_TYPE_VOID
+		virtual void update(World* world)
+#else
+		virtual void update(World* world, ECS_TICK_TYPE data)
+#endif
+		{
+		}
+
+	protected:
+		/**
+		* Declare components this system only reads.
+		*/
+		template<typename... Types>
+		void reads()
+		{
+			readMask |= Internal::getComponentMask<Types...>();
+		}
+
+		/**
+		* Declare components this system modifies.
+		*/
+		template<typename... Types>
+		void writes()
+		{
+			writeMask |= Internal::getComponentMask<Types...>();
+		}
+
+		void setAffinity(Affinity newAffinity)
+		{
+			affinity = newAffinity;
+		}
+
+		/**
+		* Name this system. The name must stay valid for as long as the system exists.
+		*/
+		void setName(const char* newName)
+		{
+			name = newName;
+		}
+
+		/**
+		* Put this system in a group that can be updated on its own, such as to run some systems at a fixed rate and
+		* others once per frame. Call this before the system is registered.
+		*/
+		void setUpdateGroup(unsigned group)
+		{
+			updateGroup = group;
+		}
+
+	private:
+		const char* name = "EntitySystem";
+		unsigned updateGroup = 0;
+		Internal::ComponentMask readMask;
+		Internal::ComponentMask writeMask;
+		Affinity affinity = Affinity::Exclusive;
+	};
+
+	/**
+	* Subclass this as EventSubscriber<EventType> and then call World::subscribe() in order to subscribe to events. Make sure
+	* to call World::unsubscribe() or World::unsubscribeAll() when your subscriber is deleted!
+	*/
+	template<typename T>
+	class EventSubscriber : public Internal::BaseEventSubscriber
+	{
+	public:
+		virtual ~EventSubscriber() {}
+
+		/**
+		* Called when an event is emitted by the world.
+		*/
+		virtual void receive(World* world, const T& event) = 0;
+	};
+
+	/**
+	* Subclass this as BatchEventSubscriber<EventType> and then call World::subscribe() to receive events of a type together,
+	* once per tick, rather than one call per event. Events are collected until World::flushEvents(), which update() calls
+	* after the last system has run.
+	*/
+	template<typename T>
+	class BatchEventSubscriber : public Internal::BaseEventSubscriber
+	{
+	public:
+		virtual ~BatchEventSubscriber() {}
+
+		/**
+		* Called with every event of this type emitted or queued since the last flush, in the order they were sent.
+		*/
+		virtual void receiveBatch(World* world, const std::vector<T>& events) = 0;
+	};
+
+	namespace Events
+	{
+		// Called when a new entity is created.
+		struct OnEntityCreated
+		{
+			ECS_DECLARE_TYPE;
+
+			Entity* entity;
+		};
+
+		// Called when an entity is about to be destroyed.
+		struct OnEntityDestroyed
+		{
+			ECS_DECLARE_TYPE;
+
+			Entity* entity;
+		};
+
+		// Called when a component is assigned (not necessarily created).
+		template<typename T>
+		struct OnComponentAssigned
+		{
+			ECS_DECLARE_TYPE;
+
+			Entity* entity;
+			ComponentHandle<T> component;
+		};
+
+		// Called when a component is removed
+		template<typename T>
+		struct OnComponentRemoved
+		{
+			ECS_DECLARE_TYPE;
+
+			Entity* entity;
+			ComponentHandle<T> component;
+		};
+
+#ifdef ECS_NO_RTTI
+		template<typename T>
+		ECS_DEFINE_TYPE(ECS::Events::OnComponentAssigned<T>);
+		template<typename T>
+		ECS_DEFINE_TYPE(ECS::Events::OnComponentRemoved<T>);
+#endif
+	}
+
+
+	/**
+	* A reference to an entity that can outlive it. Each entity occupies a slot in its world, and the slot's generation is
+	* bumped whenever the entity in it is deleted, so a handle to a deleted entity no longer resolves even once the slot
+	* has been reused. Resolve handles with World::get().
+	*/
+	class EntityHandle
+	{
+	public:
+		EntityHandle()
+			: index(0), generation(0)
+		{
+		}
+
+		EntityHandle(uint32_t index, uint32_t generation)
+			: index(index), generation(generation)
+		{
+		}
+
+		/**
+		* Unpack a handle from the value returned by getId().
+		*/
+		static EntityHandle fromId(uint64_t id)
+		{
+			return EntityHandle(static_cast<uint32_t>(id & 0xFFFFFFFF), static_cast<uint32_t>(id >> 32));
+		}
+
+		uint32_t getIndex() const
+		{
+			return index;
+		}
+
+		uint32_t getGeneration() const
+		{
+			return generation;
+		}
+
+		/**
+		* Is this handle unset? Generations start at 1, so a null handle never refers to an entity.
+		*/
+		bool isNull() const
+		{
+			return generation == 0;
+		}
+
+		/**
+		* Pack this handle into a single 64 bit id. Ids are never 0 unless the handle is null.
+		*/
+		uint64_t getId() const
+		{
+			return (static_cast<uint64_t>(generation) << 32) | index;
+		}
+
+		bool operator==(const EntityHandle& other) const
+		{
+			return index == other.index && generation == other.generation;
+		}
+
+		bool operator!=(const EntityHandle& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		uint32_t index;
+		uint32_t generation;
+	};
+
+	/**
+	* A container for components. Entities do not have any logic of their own, except of that which to manage
+	* components. Components themselves are generally structs that contain data with which EntitySystems can
+	* act upon, but technically any data type may be used as a component, though only one of each data type
+	* may be on a single Entity at a time.
+	*/
+	class Entity
+	{
+	public:
+		friend class World;
+
+		const static size_t InvalidEntityId = 0;
+
+		// Do not create entities yourself, use World::create().
+		Entity(World* world, EntityHandle handle)
+			: world(world), handle(handle)
+		{
+		}
+
+		// Do not delete entities yourself, use World::destroy(). Components are released by the world beforehand.
+		~Entity()
+		{
+		}
+
+		/**
+		* Get the world associated with this entity.
+		*/
+		World* getWorld() const
+		{
+			return world;
+		}
+
+		/**
+		* Does this entity have a component?
+		*/
+		template<typename T>
+		bool has() const
+		{
+			return archetype->has(Internal::getComponentTypeId<T>());
+		}
+
+		/**
+		* Does this entity have this list of components? The order of components does not matter.
+		*/
+		template<typename T, typename V, typename... Types>
+		bool has() const
+		{
+			return has<T>() && has<V, Types...>();
+		}
+
+		/**
+		* Assign a new component (or replace an old one). All components must have a default constructor, though they
+		* may have additional constructors. You may pass arguments to this function the same way you would to a constructor.
+		*
+		* It is recommended that components be simple types (not const, not references, not pointers). If you need to store
+		* any of the above, wrap it in a struct.
+		*/
+		template<typename T, typename... Args>
+		ComponentHandle<T> assign(Args&&... args);
+
+		/**
+		* Remove a component of a specific type. Returns whether a component was removed.
+		*/
+		template<typename T>
+		bool remove();
+
+		/**
+		* Remove all components from this entity.
+		*/
+		void removeAll();
+
+		/**
+		* Get a component from this entity.
+		*/
+		template<typename T>
+		ComponentHandle<T> get();
+
+		/**
+		* Call a function with components from this entity as arguments. This will return true if this entity has
+		* all specified components attached, and false if otherwise.
+		*/
+		template<typename... Types>
+		bool with(typename std::common_type<std::function<void(ComponentHandle<Types>...)>>::type view)
+		{
+			if (!has<Types...>())
+				return false;
+
+			view(get<Types>()...); // variadic template expansion is fun
+			return true;
+		}
+
+		/**
+		* Get this entity's id. This is the entity's handle packed into a single value, and can be passed to World::getById().
+		*/
+		size_t getEntityId() const
+		{
+			return static_cast<size_t>(handle.getId());
+		}
+
+		/**
+		* Get a handle to this entity, which can be safely kept after the entity is deleted.
+		*/
+		EntityHandle getHandle() const
+		{
+			return handle;
+		}
+
+		bool isPendingDestroy() const
+		{
+			return bPendingDestroy;
+		}
+
+	private:
+		World* world;
+
+		// The archetype this entity belongs to and its row within the archetype's columns.
+		Internal::Archetype* archetype = nullptr;
+		size_t row = 0;
+
+		// When this entity last joined an archetype. Iteration skips entities that joined after it started.
+		uint64_t archetypeStamp = 0;
+
+		// Position in the world's entity list, so it can be swapped out without a search
+		size_t index = 0;
+
+		EntityHandle handle;
+		bool bPendingDestroy = false;
+	};
+
+	/**
+	* The world creates, destroys, and manages entities. The lifetime of entities and _registered_ systems are handled by the world
+	* (don't delete a system without unregistering it from the world first!), while event subscribers have their own lifetimes
+	* (the world doesn't delete them automatically when the world is deleted).
+	*/
+	class World
+	{
+	public:
+		friend class Entity;
+		template<typename T> friend class Internal::EventQueue;
+		using WorldAllocator = std::allocator_traits<Allocator>::template rebind_alloc<World>;
+		using EntityAllocator = std::allocator_traits<Allocator>::template rebind_alloc<Entity>;
+		using SystemAllocator = std::allocator_traits<Allocator>::template rebind_alloc<EntitySystem>;
+		using EntityPtrAllocator = std::allocator_traits<Allocator>::template rebind_alloc<Entity*>;
+		using SystemPtrAllocator = std::allocator_traits<Allocator>::template rebind_alloc<EntitySystem*>;
+
+		/**
+		* Use this function to construct the world with a custom allocator.
+		*/
+		static World* createWorld(Allocator alloc)
+		{
+			WorldAllocator worldAlloc(alloc);
+			World* world = std::allocator_traits<WorldAllocator>::allocate(worldAlloc, 1);
+			std::allocator_traits<WorldAllocator>::construct(worldAlloc, world, alloc);
+
+			return world;
+		}
+
+		/**
+		* Use this function to construct the world with the default allocator.
+		*/
+		static World* createWorld()
+		{
+			return createWorld(Allocator());
+		}
+
+		// Use this to destroy the world instead of calling delete.
+		// This will emit OnEntityDestroyed events and call EntitySystem::unconfigure as appropriate.
+		void destroyWorld()
+		{
+			WorldAllocator alloc(entAlloc);
+			std::allocator_traits<WorldAllocator>::destroy(alloc, this);
+			std::allocator_traits<WorldAllocator>::deallocate(alloc, this, 1);
+		}
+
+		World(Allocator alloc)
+			: entAlloc(alloc), systemAlloc(alloc), entityPool(alloc),
+			entities({}, EntityPtrAllocator(alloc)),
+			systems({}, SystemPtrAllocator(alloc))
+		{
+			storages.fill(nullptr);
+			rootArchetype = getArchetype(Internal::ComponentMask());
+		}
+
+		/**
+		* Destroying the world will emit OnEntityDestroyed events and call EntitySystem::unconfigure() as appropriate.
+		*
+		* Use World::destroyWorld to destroy and deallocate the world, do not manually delete the world!
+		*/
+		~World();
+
+		/**
+		* Create a new entity. This will emit the OnEntityCreated event.
+		*/
+		Entity* create()
+		{
+			// While changes are deferred the entity exists straight away, but has no components and a null handle, and isn't
+			// part of the world until the command buffer is executed
+			if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
+			{
+				Entity* ent;
+				{
+					std::lock_guard<std::mutex> lock(allocMutex);
+					ent = entityPool.create(this, EntityHandle());
+				}
+
+				ent->archetype = rootArchetype;
+				buffer->push([this, ent]() { addDeferredEntity(ent); });
+				return ent;
+			}
+
+			Entity* ent = entityPool.create(this, EntityHandle());
+			ent->handle = allocateSlot(ent);
+			addToEntityList(ent);
+			moveEntity(ent, rootArchetype);
+
+			emit<Events::OnEntityCreated>({ ent });
+
+			return ent;
+		}
+
+		/**
+		* Destroy an entity. This will emit the OnEntityDestroy event.
+		*
+		* If immediate is false (recommended), then the entity won't be immediately
+		* deleted but instead will be removed at the beginning of the next tick() or
+		* when cleanup() is called. OnEntityDestroyed will still be called immediately.
+		*
+		* This function is safe to call multiple times on a single entity. Note that calling
+		* this once with immediate = false and then calling it with immediate = true will
+		* remove the entity from the pending destroy queue and will immediately destroy it
+		* _without_ emitting a second OnEntityDestroyed event.
+		*
+		* A warning: Do not set immediate to true if you are currently iterating through entities!
+		*/
+		void destroy(Entity* ent, bool immediate = false);
+
+		/**
+		* Delete all entities in the pending destroy queue. Returns true if any entities were cleaned up,
+		* false if there were no entities to clean up.
+		*
+		* This only visits the queued entities, so its cost depends on how many were destroyed rather than on
+		* the size of the world. Entities are deleted in the order they were destroyed in.
+		*/
+		bool cleanup();
+
+		/**
+		* Reset the world, destroying all entities. Ids are not reset: slots are reused with a new generation, so
+		* handles from before the reset become stale rather than pointing at new entities.
+		*/
+		void reset();
+
+		/**
+		* Register a system. The world will manage the memory of the system unless you unregister the system.
+		*/
+		EntitySystem* registerSystem(EntitySystem* system)
+		{
+			systems.push_back(system);
+			system->configure(this);
+			bScheduleDirty = true;
+
+            		return system;
+		}
+
+		/**
+		* Unregister a system.
+		*/
+		void unregisterSystem(EntitySystem* system)
+		{
+			systems.erase(std::remove(systems.begin(), systems.end(), system), systems.end());
+			system->unconfigure(this);
+			bScheduleDirty = true;
+		}
+
+		void enableSystem(EntitySystem* system)
+		{
+			auto it = std::find(disabledSystems.begin(), disabledSystems.end(), system);
+			if (it != disabledSystems.end())
+			{
+				disabledSystems.erase(it);
+				systems.push_back(system);
+				bScheduleDirty = true;
+			}
+		}
+
+		void disableSystem(EntitySystem* system)
+		{
+			auto it = std::find(systems.begin(), systems.end(), system);
+			if (it != systems.end())
+			{
+				systems.erase(it);
+				disabledSystems.push_back(system);
+				bScheduleDirty = true;
+			}
+		}
+
+		/**
+		* Subscribe to an event.
+		*/
+		template<typename T>
+		void subscribe(EventSubscriber<T>* subscriber)
+		{
+			getSubscribers(Internal::getEventTypeId<T>()).each.push_back(subscriber);
+		}
+
+		/**
+		* Subscribe to batches of an event, delivered once per tick.
+		*/
+		template<typename T>
+		void subscribe(BatchEventSubscriber<T>* subscriber)
+		{
+			getSubscribers(Internal::getEventTypeId<T>()).batch.push_back(subscriber);
+		}
+
+		/**
+		* Unsubscribe from an event.
+		*/
+		template<typename T>
+		void unsubscribe(EventSubscriber<T>* subscriber)
+		{
+			const size_t id = Internal::getEventTypeId<T>();
+			if (id < subscribers.size())
+			{
+				auto& list = subscribers[id].each;
+				list.erase(std::remove(list.begin(), list.end(), subscriber), list.end());
+			}
+		}
+
+		/**
+		* Unsubscribe from batches of an event.
+		*/
+		template<typename T>
+		void unsubscribe(BatchEventSubscriber<T>* subscriber)
+		{
+			const size_t id = Internal::getEventTypeId<T>();
+			if (id < subscribers.size())
+			{
+				auto& list = subscribers[id].batch;
+				list.erase(std::remove(list.begin(), list.end(), subscriber), list.end());
+			}
+		}
+
+		/**
+		* Unsubscribe from all events. Don't be afraid of the void pointer, just pass in your subscriber as normal.
+		*/
+		void unsubscribeAll(void* subscriber)
+		{
+			for (auto& list : subscribers)
+			{
+				list.each.erase(std::remove(list.each.begin(), list.each.end(), subscriber), list.each.end());
+				list.batch.erase(std::remove(list.batch.begin(), list.batch.end(), subscriber), list.batch.end());
+			}
+		}
+
+		/**
+		* Emit an event. Subscribers receive it immediately, and batch subscribers with the next flush. This costs a single
+		* indexed load if there are no subscribers for the event type.
+		*/
+		template<typename T>
+		void emit(const T& event)
+		{
+			const size_t id = Internal::getEventTypeId<T>();
+			if (id >= subscribers.size() || (subscribers[id].each.empty() && subscribers[id].batch.empty()))
+				return;
+
+			ECS_PROFILE_SCOPE("World::emit");
+
+			// Index rather than iterate, as subscribers may subscribe or unsubscribe while receiving
+			for (size_t i = 0; i < subscribers[id].each.size(); ++i)
+			{
+				static_cast<EventSubscriber<T>*>(subscribers[id].each[i])->receive(this, event);
+			}
+
+			if (!subscribers[id].batch.empty())
+			{
+				getEventQueue<T>(id).batched.push_back(event);
+			}
+		}
+
+		/**
+		* Queue an event to be sent with the next flushEvents(), which update() calls after the last system has run. Every
+		* subscriber receives it then, so batch subscribers get all events of a type in one call. Events nobody subscribes
+		* to are dropped straight away.
+		*
+		* Unlike emit(), this may be called from any system. Events queued by systems that run in parallel are recorded
+		* with their other deferred changes, so they arrive in the same order every tick.
+		*/
+		template<typename T>
+		void queue(const T& event)
+		{
+			if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
+			{
+				buffer->push([this, event]() { queue<T>(event); });
+				return;
+			}
+
+			const size_t id = Internal::getEventTypeId<T>();
+			if (id >= subscribers.size())
+				return;
+
+			if (!subscribers[id].each.empty())
+			{
+				getEventQueue<T>(id).queued.push_back(event);
+			}
+
+			if (!subscribers[id].batch.empty())
+			{
+				getEventQueue<T>(id).batched.push_back(event);
+			}
+		}
+
+		/**
+		* Deliver queued events, one event type at a time in the order each type was first queued. Events sent while
+		* flushing wait for the next flush.
+		*/
+		void flushEvents()
+		{
+			ECS_PROFILE_SCOPE("World::flushEvents");
+			std::vector<size_t> flushing;
+			flushing.swap(pendingEventQueues);
+			for (size_t id : flushing)
+			{
+				eventQueues[id]->deliver(this);
+			}
+
+			// Keep the list's memory for next time
+			if (pendingEventQueues.empty())
+			{
+				flushing.clear();
+				pendingEventQueues.swap(flushing);
+			}
+		}
+
+		/**
+		* Run a function on each entity with a specific set of components. This is useful for implementing an EntitySystem.
+		*
+		* Only archetypes containing every requested component are visited. Entities that join a matching archetype while
+		* the loop is running (because they were created, or had a component assigned or removed) are not visited until
+		* the next call. Removing components or destroying entities during the loop is safe.
+		*
+		* The function can be any callable taking (Entity*, ComponentHandle<Types>...). It is called directly rather than
+		* through a std::function, so lambdas are inlined into the loop.
+		*
+		* Order: archetypes are visited in the order they were first created, and entities within an archetype in row
+		* order. Rows are filled by appending, and when an entity leaves an archetype outside of a loop the last row is
+		* swapped into its place. Order is therefore stable between calls as long as nothing joins or leaves, but don't
+		* rely on it surviving structural changes.
+		*
+		* If you want to include entities that are pending destruction, set includePendingDestroy to true.
+		*/
+		template<typename... Types, typename Func, typename = typename std::enable_if<!std::is_same<typename std::decay<Func>::type, bool>::value>::type>
+		void each(Func&& viewFunc, bool bIncludePendingDestroy = false);
+
+		/**
+		* Like each(), but matching entities are split into chunks of ECS_PARALLEL_CHUNK_SIZE which are spread across the
+		* worker threads. This returns once every entity has been visited.
+		*
+		* The function is called concurrently, so it must only touch the components of the entity it is given. Creating or
+		* destroying entities and assigning or removing components inside the loop is recorded per chunk and applied in
+		* chunk order once the loop finishes (or at the end of the wave, if this is called from a deferred system).
+		*/
+		template<typename... Types, typename Func>
+		void parallelEach(Func&& viewFunc, bool bIncludePendingDestroy = false);
 
-		const static size_t InvalidEntityId = 0;
+		/**
+		* Run a function on all entities.
+		*/
+		void all(std::function<void(Entity*)> viewFunc, bool bIncludePendingDestroy = false);
 
-		// Do not create entities yourself, use World::create().
-		Entity(World* world, size_t id)
-			: world(world), id(id)
+		/**
+		* Get a view for entities with a specific set of components. The list of entities is calculated on the fly, so this method itself
+		* has little overhead. This is mostly useful with a range based for loop.
+		*
+		* Unlike the callback version of each(), this walks every entity in the world rather than only matching archetypes.
+		* Entities are listed in creation order until one is deleted, at which point the last entity takes its place.
+		*/
+		template<typename... Types>
+		Internal::EntityComponentView<Types...> each(bool bIncludePendingDestroy = false)
 		{
+			Internal::EntityComponentIterator<Types...> first(this, 0, false, bIncludePendingDestroy);
+			Internal::EntityComponentIterator<Types...> last(this, getCount(), true, bIncludePendingDestroy);
+			return Internal::EntityComponentView<Types...>(first, last);
 		}
 
-		// Do not delete entities yourself, use World::destroy().
-		~Entity()
+		Internal::EntityView all(bool bIncludePendingDestroy = false);
+
+		size_t getCount() const
 		{
-			removeAll();
+			return entities.size();
 		}
 
-		/**
-		* Get the world associated with this entity.
-		*/
-		World* getWorld() const
+		Entity* getByIndex(size_t idx)
 		{
-			return world;
+			if (idx >= getCount())
+				return nullptr;
+
+			return entities[idx];
 		}
 
 		/**
-		* Does this entity have a component?
+		* Get an entity by an id from Entity::getEntityId(). Returns nullptr if the entity has been deleted.
 		*/
-		template<typename T>
-		bool has() const
+		Entity* getById(size_t id) const;
+
+		/**
+		* Resolve a handle to its entity in constant time. Returns nullptr if the handle is null, belongs to another world
+		* or the entity has been deleted. Entities pending destruction still resolve until they are cleaned up.
+		*/
+		Entity* get(EntityHandle handle) const
 		{
-			auto index = getTypeIndex<T>();
-			return components.find(index) != components.end();
+			if (handle.getIndex() >= slots.size())
+				return nullptr;
+
+			const Internal::EntitySlot& slot = slots[handle.getIndex()];
+			return slot.generation == handle.getGeneration() ? slot.entity : nullptr;
 		}
 
 		/**
-		* Does this entity have this list of components? The order of components does not matter.
+		* Does a handle still refer to an entity in this world?
 		*/
-		template<typename T, typename V, typename... Types>
-		bool has() const
+		bool isValid(EntityHandle handle) const
 		{
-			return has<T>() && has<V, Types...>();
+			return get(handle) != nullptr;
 		}
 
 		/**
-		* Assign a new component (or replace an old one). All components must have a default constructor, though they
-		* may have additional constructors. You may pass arguments to this function the same way you would to a constructor.
-		*
-		* It is recommended that components be simple types (not const, not references, not pointers). If you need to store
-		* any of the above, wrap it in a struct.
+		* Tick the world. See the definition for ECS_TICK_TYPE at the top of this file for more information on
+		* passing data through tick().
 		*/
-		template<typename T, typename... Args>
-		ComponentHandle<T> assign(Args&&... args);
+#ifdef ECS_TICK_TYPE_VOID
+		void update()
+#else
+		void update(ECS_TICK_TYPE data)
+#endif
+		{
+			ECS_PROFILE_SCOPE("World::update");
+#ifdef ECS_TICK_TYPE_VOID
+			runSchedule(nullptr);
+#else
+			runSchedule(nullptr, data);
+#endif
+		}
 
 		/**
-		* Remove a component of a specific type. Returns whether a component was removed.
+		* Tick only the systems in one update group, in the same order update() would run them. Systems in other groups
+		* are left alone, so groups can be ticked at different rates.
 		*/
-		template<typename T>
-		bool remove()
+#ifdef ECS_TICK_TYPE_VOID
+		void updateGroup(unsigned group)
+#else
+		void updateGroup(unsigned group, ECS_TICK_TYPE data)
+#endif
 		{
-			auto found = components.find(getTypeIndex<T>());
-			if (found != components.end())
-			{
-				found->second->removed(this);
-				found->second->destroy(world);
-
-				components.erase(found);
-
-				return true;
-			}
-
-			return false;
+			ECS_PROFILE_SCOPE("World::updateGroup");
+#ifdef ECS_TICK_TYPE_VOID
+			runSchedule(&group);
+#else
+			runSchedule(&group, data);
+#endif
 		}
 
 		/**
-		* Remove all components from this entity.
+		* Get how many groups of systems update() runs one after another. Systems in the same group may run in parallel.
 		*/
-		void removeAll()
+		size_t getScheduleWaveCount()
 		{
-			for (auto pair : components)
+			if (bScheduleDirty)
 			{
-				pair.second->removed(this);
-				pair.second->destroy(world);
+				buildSchedule();
 			}
 
-			components.clear();
+			return schedule.size();
+		}
+
+		EntityAllocator& getPrimaryAllocator()
+		{
+			return entAlloc;
 		}
 
 		/**
-		* Get a component from this entity.
+		* Get allocation statistics for the entity pool.
 		*/
-		template<typename T>
-		ComponentHandle<T> get();
+		PoolStats getEntityPoolStats() const
+		{
+			return entityPool.getStats();
+		}
 
 		/**
-		* Call a function with components from this entity as arguments. This will return true if this entity has
-		* all specified components attached, and false if otherwise.
+		* Get allocation statistics for every component column combined. Each component type in an archetype has its
+		* own chunks, and a component counts as reused when it's added in a row of its archetype that was used before.
 		*/
-		template<typename... Types>
-		bool with(typename std::common_type<std::function<void(ComponentHandle<Types>...)>>::type view)
+		PoolStats getComponentPoolStats() const
 		{
-			if (!has<Types...>())
-				return false;
+			PoolStats stats;
+			for (auto* archetype : archetypes)
+			{
+				const size_t columns = archetype->columns.size();
+				stats.live += (archetype->entities.size() - archetype->tombstones) * columns;
+				stats.capacity += archetype->capacity * columns;
+				stats.chunks += archetype->capacity / ECS_COMPONENT_CHUNK_SIZE * columns;
+				stats.reused += archetype->reusedRows * columns;
+			}
 
-			view(get<Types>()...); // variadic template expansion is fun
-			return true;
+			return stats;
 		}
 
 		/**
-		* Get this entity's id. Entity ids aren't too useful at the moment, but can be used to tell the difference between entities when debugging.
+		* Get how many archetypes (distinct sets of components) have been seen by this world.
 		*/
-		size_t getEntityId() const
+		size_t getArchetypeCount() const
 		{
-			return id;
+			return archetypes.size();
 		}
 
-		bool isPendingDestroy() const
+	private:
+		EntityAllocator entAlloc;
+		SystemAllocator systemAlloc;
+
+		// Entities are allocated from a pool owned by the world
+		Internal::Pool<Entity, ECS_ENTITY_CHUNK_SIZE> entityPool;
+
+		// How to move and destroy each type of component, indexed by component type id
+		std::array<Internal::BaseComponentStorage*, ECS_MAX_COMPONENTS> storages;
+
+		// Every archetype in creation order, plus a lookup by component mask
+		std::vector<Internal::Archetype*> archetypes;
+		std::unordered_map<Internal::ComponentMask, Internal::Archetype*> archetypeLookup;
+		Internal::Archetype* rootArchetype = nullptr;
+
+		// Matching archetypes for every component set that has been iterated
+		std::unordered_map<Internal::ComponentMask, Internal::Query> queries;
+
+		// Archetypes with tombstoned rows that need compacting once iteration finishes
+		std::vector<Internal::Archetype*> dirtyArchetypes;
+
+		// How many each() loops are currently running, across all threads
+		std::atomic<size_t> iterationDepth{ 0 };
+
+		// Guards the query cache, which may be used by systems running in parallel
+		std::mutex queryMutex;
+
+		// Incremented whenever an entity joins an archetype
+		uint64_t structuralStamp = 0;
+
+		template<typename T>
+		Internal::ComponentStorage<T>* getStorage()
 		{
-			return bPendingDestroy;
+			const size_t type = Internal::getComponentTypeId<T>();
+			if (storages[type] == nullptr)
+			{
+				static_assert(alignof(T) <= alignof(std::max_align_t), "Components can't be over-aligned");
+				storages[type] = new Internal::ComponentStorage<T>();
+			}
+
+			return static_cast<Internal::ComponentStorage<T>*>(storages[type]);
 		}
 
-	private:
-		std::unordered_map<TypeIndex, Internal::BaseComponentContainer*> components;
-		World* world;
+		Internal::Archetype* getArchetype(const Internal::ComponentMask& mask);
+		Internal::Archetype* getArchetypeWith(Internal::Archetype* from, size_t type);
+		Internal::Archetype* getArchetypeWithout(Internal::Archetype* from, size_t type);
 
-		size_t id;
-		bool bPendingDestroy = false;
-	};
+		// Get the archetypes containing every component in the mask
+		Internal::Query& getQuery(const Internal::ComponentMask& mask);
 
-	/**
-	* The world creates, destroys, and manages entities. The lifetime of entities and _registered_ systems are handled by the world
-	* (don't delete a system without unregistering it from the world first!), while event subscribers have their own lifetimes
-	* (the world doesn't delete them automatically when the world is deleted).
-	*/
-	class World
-	{
-	public:
-		using WorldAllocator = std::allocator_traits<Allocator>::template rebind_alloc<World>;
-		using EntityAllocator = std::allocator_traits<Allocator>::template rebind_alloc<Entity>;
-		using SystemAllocator = std::allocator_traits<Allocator>::template rebind_alloc<EntitySystem>;
-		using EntityPtrAllocator = std::allocator_traits<Allocator>::template rebind_alloc<Entity*>;
-		using SystemPtrAllocator = std::allocator_traits<Allocator>::template rebind_alloc<EntitySystem*>;
-		using SubscriberPtrAllocator = std::allocator_traits<Allocator>::template rebind_alloc<Internal::BaseEventSubscriber*>;
-		using SubscriberPairAllocator = std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const TypeIndex, std::vector<Internal::BaseEventSubscriber*, SubscriberPtrAllocator>>>;
+		// Move an entity into another archetype, carrying over the components both archetypes share
+		void moveEntity(Entity* ent, Internal::Archetype* to);
 
-		/**
-		* Use this function to construct the world with a custom allocator.
-		*/
-		static World* createWorld(Allocator alloc)
+		// Take an entity's row out of its archetype
+		void removeFromArchetype(Entity* ent);
+
+		// Remove rows that were tombstoned during iteration
+		void compactArchetypes();
+
+		// Call a function for each live row in a range of an archetype, a chunk at a time so components are found by
+		// stepping through each column's array
+		template<typename... Types, typename Func, size_t... Indices>
+		static void eachRow(Func& viewFunc, const Internal::Archetype* archetype, size_t begin, size_t end, uint64_t startStamp, bool bIncludePendingDestroy, std::index_sequence<Indices...>);
+
+		// Release all of an entity's components and deallocate it
+		void deleteEntity(Entity* ent);
+
+		// Append an entity to the entity list
+		void addToEntityList(Entity* ent);
+
+		// Swap the last entity in the list into this entity's place
+		void removeFromEntityList(Entity* ent);
+
+		// Group systems into waves that can each run in parallel
+		void buildSchedule();
+
+		// Run every system in the schedule, or only those in one group
+#ifdef ECS_TICK_TYPE_VOID
+		void runSchedule(const unsigned* group);
+#else
+		void runSchedule(const unsigned* group, ECS_TICK_TYPE data);
+#endif
+
+		// Get the worker threads, starting them the first time they are needed. Returns nullptr if there are none.
+		Internal::TaskPool* getTaskPool();
+
+		// Add an entity that was created while structural changes were being deferred
+		void addDeferredEntity(Entity* ent);
+
+		std::vector<std::vector<EntitySystem*>> schedule;
+		std::vector<std::vector<std::vector<EntitySystem*>>> groupSchedules;
+		std::vector<std::function<void()>> systemTasks;
+		std::vector<Internal::CommandBuffer> systemBuffers;
+		Internal::TaskPool* taskPool = nullptr;
+		std::once_flag taskPoolStarted;
+		bool bScheduleDirty = true;
+
+		// Guards allocating entities from several threads at once
+		std::mutex allocMutex;
+
+		std::vector<Entity*, EntityPtrAllocator> entities;
+		std::vector<Entity*> pendingDestroy;
+
+		// Entities being deleted by cleanup(), cleared to null if something destroys one of them immediately first
+		std::vector<Entity*> cleanupQueue;
+		std::vector<EntitySystem*, SystemPtrAllocator> systems;
+        	std::vector<EntitySystem*> disabledSystems;
+
+		// Subscribers and queued events by event type id, and the ids of queues waiting to be flushed
+		std::vector<Internal::SubscriberList> subscribers;
+		std::vector<Internal::BaseEventQueue*> eventQueues;
+		std::vector<size_t> pendingEventQueues;
+
+		// Get the subscribers to an event type, making room for it if needed
+		Internal::SubscriberList& getSubscribers(size_t id)
 		{
-			WorldAllocator worldAlloc(alloc);
-			World* world = std::allocator_traits<WorldAllocator>::allocate(worldAlloc, 1);
-			std::allocator_traits<WorldAllocator>::construct(worldAlloc, world, alloc);
+			if (subscribers.size() <= id)
+			{
+				subscribers.resize(id + 1);
+			}
 
-			return world;
+			return subscribers[id];
 		}
 
-		/**
-		* Use this function to construct the world with the default allocator.
-		*/
-		static World* createWorld()
+		// Get the queue for an event type, marking it to be flushed
+		template<typename T>
+		Internal::EventQueue<T>& getEventQueue(size_t id)
 		{
-			return createWorld(Allocator());
+			if (eventQueues.size() <= id)
+			{
+				eventQueues.resize(id + 1, nullptr);
+			}
+
+			if (eventQueues[id] == nullptr)
+			{
+				eventQueues[id] = new Internal::EventQueue<T>();
+			}
+
+			auto* queue = static_cast<Internal::EventQueue<T>*>(eventQueues[id]);
+			if (queue->batched.empty() && queue->queued.empty())
+			{
+				pendingEventQueues.push_back(id);
+			}
+
+			return *queue;
 		}
 
-		// Use this to destroy the world instead of calling delete.
-		// This will emit OnEntityDestroyed events and call EntitySystem::unconfigure as appropriate.
-		void destroyWorld()
+		// Entities by handle index, and the indices of slots that are free to reuse
+		std::vector<Internal::EntitySlot> slots;
+		std::vector<uint32_t> freeSlots;
+
+		// Give an entity a slot and return its handle
+		EntityHandle allocateSlot(Entity* ent);
+
+		// Free an entity's slot, invalidating any handles to it
+		void releaseSlot(Entity* ent);
+	};
+
+	namespace Internal
+	{
+		class EntityIterator
 		{
-			WorldAllocator alloc(entAlloc);
-			std::allocator_traits<WorldAllocator>::destroy(alloc, this);
-			std::allocator_traits<WorldAllocator>::deallocate(alloc, this, 1);
-		}
+		public:
+			EntityIterator(World* world, size_t index, bool bIsEnd, bool bIncludePendingDestroy);
 
-		World(Allocator alloc)
-			: entAlloc(alloc), systemAlloc(alloc),
-			entities({}, EntityPtrAllocator(alloc)),
-			systems({}, SystemPtrAllocator(alloc)),
-			subscribers({}, 0, std::hash<TypeIndex>(), std::equal_to<TypeIndex>(), SubscriberPtrAllocator(alloc))
+			size_t getIndex() const
+			{
+				return index;
+			}
+
+			bool isEnd() const;
+
+			bool includePendingDestroy() const
+			{
+				return bIncludePendingDestroy;
+			}
+
+			World* getWorld() const
+			{
+				return world;
+			}
+
+			Entity* get() const;
+
+			Entity* operator*() const
+			{
+				return get();
+			}
+
+			bool operator==(const EntityIterator& other) const
+			{
+				if (world != other.world)
+					return false;
+
+				if (isEnd())
+					return other.isEnd();
+
+				return index == other.index;
+			}
+
+			bool operator!=(const EntityIterator& other) const
+			{
+				if (world != other.world)
+					return true;
+
+				if (isEnd())
+					return !other.isEnd();
+
+				return index != other.index;
+			}
+
+			EntityIterator& operator++();
+
+		private:
+			bool bIsEnd = false;
+			size_t index;
+			class ECS::World* world;
+			bool bIncludePendingDestroy;
+		};
+
+		class EntityView
 		{
-		}
+		public:
+			EntityView(const EntityIterator& first, const EntityIterator& last)
+				: firstItr(first), lastItr(last)
+			{
+				if (firstItr.get() == nullptr || (firstItr.get()->isPendingDestroy() && !firstItr.includePendingDestroy()))
+				{
+					++firstItr;
+				}
+			}
 
-		/**
-		* Destroying the world will emit OnEntityDestroyed events and call EntitySystem::unconfigure() as appropriate.
-		*
-		* Use World::destroyWorld to destroy and deallocate the world, do not manually delete the world!
-		*/
-		~World();
+			const EntityIterator& begin() const
+			{
+				return firstItr;
+			}
 
-		/**
-		* Create a new entity. This will emit the OnEntityCreated event.
-		*/
-		Entity* create()
-		{
-			++lastEntityId;
-			Entity* ent = std::allocator_traits<EntityAllocator>::allocate(entAlloc, 1);
-			std::allocator_traits<EntityAllocator>::construct(entAlloc, ent, this, lastEntityId);
-			entities.push_back(ent);
+			const EntityIterator& end() const
+			{
+				return lastItr;
+			}
 
-			emit<Events::OnEntityCreated>({ ent });
+		private:
+			EntityIterator firstItr;
+			EntityIterator lastItr;
+		};
 
-			return ent;
+		template<typename T>
+		void ComponentStorage<T>::release(Entity* ent, void* component)
+		{
+			ent->getWorld()->emit<Events::OnComponentRemoved<T>>({ ent, ComponentHandle<T>(static_cast<T*>(component)) });
 		}
 
-		/**
-		* Destroy an entity. This will emit the OnEntityDestroy event.
-		*
-		* If immediate is false (recommended), then the entity won't be immediately
-		* deleted but instead will be removed at the beginning of the next tick() or
-		* when cleanup() is called. OnEntityDestroyed will still be called immediately.
-		*
-		* This function is safe to call multiple times on a single entity. Note that calling
-		* this once with immediate = false and then calling it with immediate = true will
-		* remove the entity from the pending destroy queue and will immediately destroy it
-		* _without_ emitting a second OnEntityDestroyed event.
-		*
-		* A warning: Do not set immediate to true if you are currently iterating through entities!
-		*/
-		void destroy(Entity* ent, bool immediate = false);
-
-		/**
-		* Delete all entities in the pending destroy queue. Returns true if any entities were cleaned up,
-		* false if there were no entities to clean up.
-		*/
-		bool cleanup();
+		template<typename T>
+		void EventQueue<T>::deliver(World* world)
+		{
+			// Take the events first, so any sent while delivering start a new queue
+			std::vector<T> delivering;
+			delivering.swap(queued);
+			std::vector<T> batch;
+			batch.swap(batched);
 
-		/**
-		* Reset the world, destroying all entities. Entity ids will be reset as well.
-		*/
-		void reset();
+			const size_t id = getEventTypeId<T>();
+			for (const T& event : delivering)
+			{
+				for (size_t i = 0; i < world->subscribers[id].each.size(); ++i)
+				{
+					static_cast<EventSubscriber<T>*>(world->subscribers[id].each[i])->receive(world, event);
+				}
+			}
 
-		/**
-		* Register a system. The world will manage the memory of the system unless you unregister the system.
-		*/
-		EntitySystem* registerSystem(EntitySystem* system)
-		{
-			systems.push_back(system);
-			system->configure(this);
+			if (!batch.empty())
+			{
+				for (size_t i = 0; i < world->subscribers[id].batch.size(); ++i)
+				{
+					static_cast<BatchEventSubscriber<T>*>(world->subscribers[id].batch[i])->receiveBatch(world, batch);
+				}
+			}
 
-            		return system;
+			// Hand the memory back unless new events arrived in the meantime
+			if (queued.empty() && batched.empty())
+			{
+				delivering.clear();
+				queued.swap(delivering);
+				batch.clear();
+				batched.swap(batch);
+			}
 		}
+	}
 
-		/**
-		* Unregister a system.
-		*/
-		void unregisterSystem(EntitySystem* system)
+	inline World::~World()
+	{
+		for (auto* system : systems)
 		{
-			systems.erase(std::remove(systems.begin(), systems.end(), system), systems.end());
 			system->unconfigure(this);
 		}
 
-		void enableSystem(EntitySystem* system)
+		for (auto* ent : entities)
 		{
-			auto it = std::find(disabledSystems.begin(), disabledSystems.end(), system);
-			if (it != disabledSystems.end())
+			if (!ent->isPendingDestroy())
 			{
-				disabledSystems.erase(it);
-				systems.push_back(system);
+				ent->bPendingDestroy = true;
+				emit<Events::OnEntityDestroyed>({ ent });
 			}
+
+			deleteEntity(ent);
 		}
 
-		void disableSystem(EntitySystem* system)
+		for (auto* system : systems)
 		{
-			auto it = std::find(systems.begin(), systems.end(), system);
-			if (it != systems.end())
-			{
-				systems.erase(it);
-				disabledSystems.push_back(system);
-			}
+			std::allocator_traits<SystemAllocator>::destroy(systemAlloc, system);
+			std::allocator_traits<SystemAllocator>::deallocate(systemAlloc, system, 1);
 		}
 
-		/**
-		* Subscribe to an event.
-		*/
-		template<typename T>
-		void subscribe(EventSubscriber<T>* subscriber)
+		delete taskPool;
+
+		// Destroy anything still waiting in a vacated row before the archetypes free their chunks
+		compactArchetypes();
+		for (auto* archetype : archetypes)
 		{
-			auto index = getTypeIndex<T>();
-			auto found = subscribers.find(index);
-			if (found == subscribers.end())
-			{
-				std::vector<Internal::BaseEventSubscriber*, SubscriberPtrAllocator> subList(entAlloc);
-				subList.push_back(subscriber);
+			delete archetype;
+		}
 
-				subscribers.insert({ index, subList });
-			}
-			else
-			{
-				found->second.push_back(subscriber);
-			}
+		for (auto* storage : storages)
+		{
+			delete storage;
 		}
 
-		/**
-		* Unsubscribe from an event.
-		*/
-		template<typename T>
-		void unsubscribe(EventSubscriber<T>* subscriber)
+		for (auto* queue : eventQueues)
 		{
-			auto index = getTypeIndex<T>();
-			auto found = subscribers.find(index);
-			if (found != subscribers.end())
-			{
-				found->second.erase(std::remove(found->second.begin(), found->second.end(), subscriber), found->second.end());
-				if (found->second.size() == 0)
-				{
-					subscribers.erase(found);
-				}
-			}
+			delete queue;
 		}
+	}
 
-		/**
-		* Unsubscribe from all events. Don't be afraid of the void pointer, just pass in your subscriber as normal.
-		*/
-		void unsubscribeAll(void* subscriber)
+	inline void World::destroy(Entity* ent, bool immediate)
+	{
+		if (ent == nullptr)
+			return;
+
+		// Deferred destruction is never immediate, so later commands can still refer to the entity
+		if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
 		{
-			for (auto kv : subscribers)
-			{
-				kv.second.erase(std::remove(kv.second.begin(), kv.second.end(), subscriber), kv.second.end());
-				if (kv.second.size() == 0)
-				{
-					subscribers.erase(kv.first);
-				}
-			}
+			buffer->push([this, ent]() { destroy(ent); });
+			return;
 		}
 
-		/**
-		* Emit an event. This will do nothing if there are no subscribers for the event type.
-		*/
-		template<typename T>
-		void emit(const T& event)
+		if (ent->isPendingDestroy())
 		{
-			auto found = subscribers.find(getTypeIndex<T>());
-			if (found != subscribers.end())
+			if (immediate)
 			{
-				for (auto* base : found->second)
+				// The entity is either still queued, or cleanup() is about to delete it and must skip it instead
+				auto queued = std::find(pendingDestroy.begin(), pendingDestroy.end(), ent);
+				if (queued != pendingDestroy.end())
+				{
+					pendingDestroy.erase(queued);
+				}
+				else
 				{
-					auto* sub = reinterpret_cast<EventSubscriber<T>*>(base);
-					sub->receive(this, event);
+					auto cleaning = std::find(cleanupQueue.begin(), cleanupQueue.end(), ent);
+					if (cleaning == cleanupQueue.end())
+						return;
+					*cleaning = nullptr;
 				}
+				removeFromEntityList(ent);
+				deleteEntity(ent);
 			}
+
+			return;
 		}
 
-		/**
-		* Run a function on each entity with a specific set of components. This is useful for implementing an EntitySystem.
-		*
-		* If you want to include entities that are pending destruction, set includePendingDestroy to true.
-		*/
-		template<typename... Types>
-		void each(typename std::common_type<std::function<void(Entity*, ComponentHandle<Types>...)>>::type viewFunc, bool bIncludePendingDestroy = false);
+		ent->bPendingDestroy = true;
 
-		/**
-		* Run a function on all entities.
-		*/
-		void all(std::function<void(Entity*)> viewFunc, bool bIncludePendingDestroy = false);
+		emit<Events::OnEntityDestroyed>({ ent });
 
-		/**
-		* Get a view for entities with a specific set of components. The list of entities is calculated on the fly, so this method itself
-		* has little overhead. This is mostly useful with a range based for loop.
-		*/
-		template<typename... Types>
-		Internal::EntityComponentView<Types...> each(bool bIncludePendingDestroy = false)
+		if (immediate)
 		{
-			Internal::EntityComponentIterator<Types...> first(this, 0, false, bIncludePendingDestroy);
-			Internal::EntityComponentIterator<Types...> last(this, getCount(), true, bIncludePendingDestroy);
-			return Internal::EntityComponentView<Types...>(first, last);
+			removeFromEntityList(ent);
+			deleteEntity(ent);
+		}
+		else
+		{
+			pendingDestroy.push_back(ent);
 		}
+	}
 
-		Internal::EntityView all(bool bIncludePendingDestroy = false);
+	inline bool World::cleanup()
+	{
+		// Nothing to do, or already cleaning up further up the stack, which will get to anything queued since
+		if (pendingDestroy.empty() || !cleanupQueue.empty())
+			return false;
 
-		size_t getCount() const
+		ECS_PROFILE_SCOPE("World::cleanup");
+
+		// Take the queue first in case a subscriber destroys more entities while these are deleted
+		// Entities destroyed immediately in the meantime are cleared from the queue and skipped
+		cleanupQueue.swap(pendingDestroy);
+		for (size_t i = 0; i < cleanupQueue.size(); ++i)
 		{
-			return entities.size();
+			Entity* ent = cleanupQueue[i];
+			if (ent == nullptr)
+				continue;
+			cleanupQueue[i] = nullptr;
+			removeFromEntityList(ent);
+			deleteEntity(ent);
 		}
 
-		Entity* getByIndex(size_t idx)
+		// Hand the queue's memory back so the next burst doesn't have to grow it again
+		cleanupQueue.clear();
+		if (pendingDestroy.empty())
 		{
-			if (idx >= getCount())
-				return nullptr;
-
-			return entities[idx];
+			pendingDestroy.swap(cleanupQueue);
 		}
 
-		/**
-		* Get an entity by an id. This is a slow process.
-		*/
-		Entity* getById(size_t id) const;
+		return true;
+	}
 
-		/**
-		* Tick the world. See the definition for ECS_TICK_TYPE at the top of this file for more information on
-		* passing data through tick().
-		*/
-#ifdef ECS_TICK_TYPE_VOID
-		void update()
-#else
-		void update(ECS_TICK_TYPE data)
-#endif
+	inline void World::reset()
+	{
+		for (auto* ent : entities)
 		{
-#ifndef ECS_TICK_NO_CLEANUP
-			cleanup();
-#endif
-			for (auto* system : systems)
+			if (!ent->isPendingDestroy())
 			{
-#ifdef ECS_TICK_TYPE_VOID
-				system->update(this);
-#else
-				system->update(this, data);
-#endif
+				ent->bPendingDestroy = true;
+				emit<Events::OnEntityDestroyed>({ ent });
 			}
+			deleteEntity(ent);
+		}
+
+		entities.clear();
+		pendingDestroy.clear();
+		std::fill(cleanupQueue.begin(), cleanupQueue.end(), nullptr);
+	}
+
+	inline void World::all(std::function<void(Entity*)> viewFunc, bool bIncludePendingDestroy)
+	{
+		for (auto* ent : all(bIncludePendingDestroy))
+		{
+			viewFunc(ent);
+		}
+	}
+
+	inline Internal::EntityView World::all(bool bIncludePendingDestroy)
+	{
+		Internal::EntityIterator first(this, 0, false, bIncludePendingDestroy);
+		Internal::EntityIterator last(this, getCount(), true, bIncludePendingDestroy);
+		return Internal::EntityView(first, last);
+	}
+
+	inline Entity* World::getById(size_t id) const
+	{
+		if (id == Entity::InvalidEntityId)
+			return nullptr;
+
+		return get(EntityHandle::fromId(id));
+	}
+
+	inline EntityHandle World::allocateSlot(Entity* ent)
+	{
+		if (!freeSlots.empty())
+		{
+			const uint32_t index = freeSlots.back();
+			freeSlots.pop_back();
+			slots[index].entity = ent;
+			return EntityHandle(index, slots[index].generation);
+		}
+
+		slots.push_back({ ent, 1 });
+		return EntityHandle(static_cast<uint32_t>(slots.size() - 1), 1);
+	}
+
+	inline void World::releaseSlot(Entity* ent)
+	{
+		const EntityHandle handle = ent->getHandle();
+		if (handle.isNull())
+			return;
+
+		Internal::EntitySlot& slot = slots[handle.getIndex()];
+		slot.entity = nullptr;
+
+		// Generation 0 is reserved for null handles
+		if (++slot.generation == 0)
+		{
+			slot.generation = 1;
 		}
 
-		EntityAllocator& getPrimaryAllocator()
+		freeSlots.push_back(handle.getIndex());
+	}
+
+	inline Internal::Archetype* World::getArchetype(const Internal::ComponentMask& mask)
+	{
+		auto found = archetypeLookup.find(mask);
+		if (found != archetypeLookup.end())
+			return found->second;
+
+		Internal::Archetype* archetype = new Internal::Archetype(mask, storages.data(), entAlloc);
+		archetypes.push_back(archetype);
+		archetypeLookup.insert({ mask, archetype });
+		return archetype;
+	}
+
+	inline Internal::Archetype* World::getArchetypeWith(Internal::Archetype* from, size_t type)
+	{
+		if (from->addEdges[type] == nullptr)
 		{
-			return entAlloc;
+			Internal::ComponentMask mask = from->mask;
+			mask.set(type);
+			from->addEdges[type] = getArchetype(mask);
 		}
 
-	private:
-		EntityAllocator entAlloc;
-		SystemAllocator systemAlloc;
+		return from->addEdges[type];
+	}
 
-		std::vector<Entity*, EntityPtrAllocator> entities;
-		std::vector<EntitySystem*, SystemPtrAllocator> systems;
-        	std::vector<EntitySystem*> disabledSystems;
-		std::unordered_map<TypeIndex,
-			std::vector<Internal::BaseEventSubscriber*, SubscriberPtrAllocator>,
-			std::hash<TypeIndex>,
-			std::equal_to<TypeIndex>,
-			SubscriberPairAllocator> subscribers;
+	inline Internal::Archetype* World::getArchetypeWithout(Internal::Archetype* from, size_t type)
+	{
+		if (from->removeEdges[type] == nullptr)
+		{
+			Internal::ComponentMask mask = from->mask;
+			mask.reset(type);
+			from->removeEdges[type] = getArchetype(mask);
+		}
 
-		size_t lastEntityId = 0;
-	};
+		return from->removeEdges[type];
+	}
 
-	namespace Internal
+	// Archetypes are only created by structural changes, which are deferred while systems run in parallel, so a query
+	// never grows while another thread is reading it
+	inline Internal::Query& World::getQuery(const Internal::ComponentMask& mask)
 	{
-		class EntityIterator
+		std::lock_guard<std::mutex> lock(queryMutex);
+		Internal::Query& query = queries[mask];
+		for (; query.archetypesChecked < archetypes.size(); ++query.archetypesChecked)
 		{
-		public:
-			EntityIterator(World* world, size_t index, bool bIsEnd, bool bIncludePendingDestroy);
-
-			size_t getIndex() const
+			Internal::Archetype* archetype = archetypes[query.archetypesChecked];
+			if ((archetype->mask & mask) == mask)
 			{
-				return index;
+				query.archetypes.push_back(archetype);
 			}
+		}
 
-			bool isEnd() const;
+		return query;
+	}
 
-			bool includePendingDestroy() const
-			{
-				return bIncludePendingDestroy;
-			}
+	inline void World::moveEntity(Entity* ent, Internal::Archetype* to)
+	{
+		Internal::Archetype* from = ent->archetype;
+		if (from == to)
+			return;
 
-			World* getWorld() const
+		// Move the components the archetypes share, anything left behind is destroyed with the old row
+		const size_t newRow = to->addRow(ent);
+		if (from != nullptr)
+		{
+			for (size_t i = 0; i < from->types.size(); ++i)
 			{
-				return world;
+				const int column = to->columnIndex[from->types[i]];
+				if (column >= 0)
+				{
+					from->columns[i].storage->moveConstruct(to->columns[column].at(newRow), from->columns[i].at(ent->row));
+				}
 			}
 
-			Entity* get() const;
+			removeFromArchetype(ent);
+		}
 
-			Entity* operator*() const
+		ent->archetype = to;
+		ent->row = newRow;
+		ent->archetypeStamp = ++structuralStamp;
+	}
+
+	inline void World::removeFromArchetype(Entity* ent)
+	{
+		Internal::Archetype* archetype = ent->archetype;
+		const size_t row = ent->row;
+
+		// Rows can't be shuffled while someone is iterating them, so leave a hole to compact later
+		// The components stay alive until then, as the loop may still be using them
+		if (iterationDepth > 0)
+		{
+			archetype->entities[row] = nullptr;
+			if (archetype->tombstones++ == 0)
 			{
-				return get();
+				dirtyArchetypes.push_back(archetype);
 			}
+		}
 
-			bool operator==(const EntityIterator& other) const
+		// Otherwise destroy the row and move the last row into the hole
+		else
+		{
+			const size_t last = archetype->entities.size() - 1;
+			archetype->destroyRow(row);
+			if (row != last)
 			{
-				if (world != other.world)
-					return false;
+				archetype->moveRow(row, last);
+				archetype->entities[row] = archetype->entities[last];
+				archetype->entities[row]->row = row;
+			}
 
-				if (isEnd())
-					return other.isEnd();
+			archetype->entities.pop_back();
+		}
 
-				return index == other.index;
-			}
+		ent->archetype = nullptr;
+	}
 
-			bool operator!=(const EntityIterator& other) const
+	inline void World::compactArchetypes()
+	{
+		for (auto* archetype : dirtyArchetypes)
+		{
+			size_t write = 0;
+			for (size_t read = 0; read < archetype->entities.size(); ++read)
 			{
-				if (world != other.world)
-					return true;
+				Entity* ent = archetype->entities[read];
+				if (ent == nullptr)
+				{
+					archetype->destroyRow(read);
+					continue;
+				}
 
-				if (isEnd())
-					return !other.isEnd();
+				if (write != read)
+				{
+					archetype->moveRow(write, read);
+					archetype->entities[write] = ent;
+					ent->row = write;
+				}
 
-				return index != other.index;
+				++write;
 			}
 
-			EntityIterator& operator++();
+			archetype->entities.resize(write);
+			archetype->tombstones = 0;
+		}
 
-		private:
-			bool bIsEnd = false;
-			size_t index;
-			class ECS::World* world;
-			bool bIncludePendingDestroy;
-		};
+		dirtyArchetypes.clear();
+	}
 
-		class EntityView
-		{
-		public:
-			EntityView(const EntityIterator& first, const EntityIterator& last)
-				: firstItr(first), lastItr(last)
+	inline void World::buildSchedule()
+	{
+		// Each system goes in the wave after the latest system registered before it that it conflicts with
+		// Groups are scheduled the same way, but only against systems in the same group
+		schedule.clear();
+		groupSchedules.clear();
+		std::vector<size_t> systemWave(systems.size(), 0);
+		std::vector<size_t> groupWave(systems.size(), 0);
+		for (size_t i = 0; i < systems.size(); ++i)
+		{
+			const unsigned group = systems[i]->getUpdateGroup();
+			for (size_t j = 0; j < i; ++j)
 			{
-				if (firstItr.get() == nullptr || (firstItr.get()->isPendingDestroy() && !firstItr.includePendingDestroy()))
+				if (systems[i]->conflictsWith(*systems[j]))
 				{
-					++firstItr;
+					systemWave[i] = std::max(systemWave[i], systemWave[j] + 1);
+					if (systems[j]->getUpdateGroup() == group)
+					{
+						groupWave[i] = std::max(groupWave[i], groupWave[j] + 1);
+					}
 				}
 			}
 
-			const EntityIterator& begin() const
+			if (schedule.size() <= systemWave[i])
 			{
-				return firstItr;
+				schedule.resize(systemWave[i] + 1);
 			}
 
-			const EntityIterator& end() const
+			schedule[systemWave[i]].push_back(systems[i]);
+
+			if (groupSchedules.size() <= group)
 			{
-				return lastItr;
+				groupSchedules.resize(group + 1);
 			}
 
-		private:
-			EntityIterator firstItr;
-			EntityIterator lastItr;
+			if (groupSchedules[group].size() <= groupWave[i])
+			{
+				groupSchedules[group].resize(groupWave[i] + 1);
+			}
+
+			groupSchedules[group][groupWave[i]].push_back(systems[i]);
+		}
+
+		bScheduleDirty = false;
+	}
+
+#ifdef ECS_TICK_TYPE_VOID
+	inline void World::runSchedule(const unsigned* group)
+#else
+	inline void World::runSchedule(const unsigned* group, ECS_TICK_TYPE data)
+#endif
+	{
+#ifndef ECS_TICK_NO_CLEANUP
+		cleanup();
+#endif
+#ifdef ECS_TICK_TYPE_VOID
+		auto runSystem = [this](EntitySystem* system) {
+			ECS_PROFILE_SCOPE(system->getName());
+			system->update(this);
+		};
+#else
+		auto runSystem = [this, &data](EntitySystem* system) {
+			ECS_PROFILE_SCOPE(system->getName());
+			system->update(this, data);
 		};
+#endif
+		if (bScheduleDirty)
+		{
+			buildSchedule();
+		}
 
-		template<typename T>
-		struct ComponentContainer : public BaseComponentContainer
+		static const std::vector<std::vector<EntitySystem*>> emptySchedule;
+		const auto& waves = group == nullptr ? schedule
+			: *group < groupSchedules.size() ? groupSchedules[*group] : emptySchedule;
+		for (auto& wave : waves)
 		{
-			ComponentContainer() {}
-			ComponentContainer(const T& data) : data(data) {}
+			// Exclusive systems always have a wave to themselves and change the world directly
+			if (wave.front()->getAffinity() == EntitySystem::Affinity::Exclusive)
+			{
+				runSystem(wave.front());
+				continue;
+			}
+
+			// Everything else records structural changes, one buffer per system, whether or not it ran in parallel
+			if (systemBuffers.size() < wave.size())
+			{
+				systemBuffers.resize(wave.size());
+			}
 
-			T data;
+			auto runBuffered = [&](size_t i) {
+				Internal::CommandBufferScope scope(&systemBuffers[i]);
+				runSystem(wave[i]);
+			};
 
-		protected:
-			virtual void destroy(World* world)
+			Internal::TaskPool* pool = wave.size() > 1 ? getTaskPool() : nullptr;
+			if (pool == nullptr)
+			{
+				for (size_t i = 0; i < wave.size(); ++i)
+				{
+					runBuffered(i);
+				}
+			}
+			else
 			{
-				using ComponentAllocator = std::allocator_traits<World::EntityAllocator>::template rebind_alloc<ComponentContainer<T>>;
+				systemTasks.clear();
+				for (size_t i = 0; i < wave.size(); ++i)
+				{
+					if (wave[i]->getAffinity() == EntitySystem::Affinity::Any)
+					{
+						systemTasks.push_back([&runBuffered, i]() { runBuffered(i); });
+					}
+				}
 
-				ComponentAllocator alloc(world->getPrimaryAllocator());
-				std::allocator_traits<ComponentAllocator>::destroy(alloc, this);
-				std::allocator_traits<ComponentAllocator>::deallocate(alloc, this, 1);
+				pool->run(systemTasks, [&]() {
+					for (size_t i = 0; i < wave.size(); ++i)
+					{
+						if (wave[i]->getAffinity() != EntitySystem::Affinity::Any)
+						{
+							runBuffered(i);
+						}
+					}
+				});
 			}
 
-			virtual void removed(Entity* ent)
+			for (size_t i = 0; i < wave.size(); ++i)
 			{
-				auto handle = ComponentHandle<T>(&data);
-				ent->getWorld()->emit<Events::OnComponentRemoved<T>>({ ent, handle });
+				systemBuffers[i].execute();
 			}
-		};
+		}
+
+		flushEvents();
 	}
 
-	inline World::~World()
+	inline Internal::TaskPool* World::getTaskPool()
 	{
-		for (auto* system : systems)
-		{
-			system->unconfigure(this);
-		}
+#ifndef ECS_NO_WORKER_THREADS
+		std::call_once(taskPoolStarted, [this]() {
+			size_t threadCount = ECS_WORKER_THREADS;
+			if (threadCount == 0)
+			{
+				const size_t hardwareThreads = std::thread::hardware_concurrency();
+				threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+			}
 
-		for (auto* ent : entities)
-		{
-			if (!ent->isPendingDestroy())
+			if (threadCount > 0)
 			{
-				ent->bPendingDestroy = true;
-				emit<Events::OnEntityDestroyed>({ ent });
+				taskPool = new Internal::TaskPool(threadCount);
 			}
+		});
+#endif
 
-			std::allocator_traits<EntityAllocator>::destroy(entAlloc, ent);
-			std::allocator_traits<EntityAllocator>::deallocate(entAlloc, ent, 1);
-		}
+		return taskPool;
+	}
 
-		for (auto* system : systems)
+	inline void World::addDeferredEntity(Entity* ent)
+	{
+		ent->handle = allocateSlot(ent);
+		ent->archetype = nullptr;
+		addToEntityList(ent);
+		moveEntity(ent, rootArchetype);
+
+		emit<Events::OnEntityCreated>({ ent });
+	}
+
+	inline void World::deleteEntity(Entity* ent)
+	{
+		// Release the components in place rather than through removeAll(), which would move the entity to the root archetype first
+		Internal::Archetype* archetype = ent->archetype;
+		for (auto& column : archetype->columns)
 		{
-			std::allocator_traits<SystemAllocator>::destroy(systemAlloc, system);
-			std::allocator_traits<SystemAllocator>::deallocate(systemAlloc, system, 1);
+			column.storage->release(ent, column.at(ent->row));
 		}
+
+		removeFromArchetype(ent);
+		releaseSlot(ent);
+		entityPool.destroy(ent);
 	}
 
-	inline void World::destroy(Entity* ent, bool immediate)
+	inline void World::addToEntityList(Entity* ent)
 	{
-		if (ent == nullptr)
-			return;
+		ent->index = entities.size();
+		entities.push_back(ent);
+	}
 
-		if (ent->isPendingDestroy())
-		{
-			if (immediate)
+	inline void World::removeFromEntityList(Entity* ent)
+	{
+		Entity* last = entities.back();
+		entities[ent->index] = last;
+		last->index = ent->index;
+		entities.pop_back();
+	}
+
+	template<typename... Types, typename Func, size_t... Indices>
+	inline void World::eachRow(Func& viewFunc, const Internal::Archetype* archetype, size_t begin, size_t end, uint64_t startStamp, bool bIncludePendingDestroy, std::index_sequence<Indices...>)
+	{
+		const std::array<int, sizeof...(Types)> columns = { { archetype->columnIndex[Internal::getComponentTypeId<Types>()]... } };
+		while (begin < end)
+		{
+			const size_t chunk = begin / ECS_COMPONENT_CHUNK_SIZE;
+			const size_t chunkStart = chunk * ECS_COMPONENT_CHUNK_SIZE;
+			const size_t chunkEnd = std::min(chunkStart + ECS_COMPONENT_CHUNK_SIZE, end);
+			const std::tuple<Types*...> arrays(reinterpret_cast<Types*>(archetype->columns[columns[Indices]].chunks[chunk])...);
+			for (size_t row = begin; row < chunkEnd; ++row)
 			{
-				entities.erase(std::remove(entities.begin(), entities.end(), ent), entities.end());
-				std::allocator_traits<EntityAllocator>::destroy(entAlloc, ent);
-				std::allocator_traits<EntityAllocator>::deallocate(entAlloc, ent, 1);
+				Entity* ent = archetype->entities[row];
+				if (ent == nullptr || ent->archetypeStamp > startStamp || (ent->isPendingDestroy() && !bIncludePendingDestroy))
+					continue;
+
+				viewFunc(ent, ComponentHandle<Types>(std::get<Indices>(arrays) + (row - chunkStart))...);
 			}
 
-			return;
+			begin = chunkEnd;
 		}
+	}
 
-		ent->bPendingDestroy = true;
+	template<typename... Types, typename Func, typename>
+	void World::each(Func&& viewFunc, bool bIncludePendingDestroy)
+	{
+		const uint64_t startStamp = structuralStamp;
+		Internal::Query& query = getQuery(Internal::getComponentMask<Types...>());
 
-		emit<Events::OnEntityDestroyed>({ ent });
+		// Archetypes created during the loop can only contain entities that joined after it started
+		const size_t archetypeCount = query.archetypes.size();
 
-		if (immediate)
+		++iterationDepth;
+		for (size_t a = 0; a < archetypeCount; ++a)
+		{
+			Internal::Archetype* archetype = query.archetypes[a];
+			eachRow<Types...>(viewFunc, archetype, 0, archetype->entities.size(), startStamp, bIncludePendingDestroy, std::index_sequence_for<Types...>());
+		}
+
+		if (--iterationDepth == 0 && !dirtyArchetypes.empty())
 		{
-			entities.erase(std::remove(entities.begin(), entities.end(), ent), entities.end());
-			std::allocator_traits<EntityAllocator>::destroy(entAlloc, ent);
-			std::allocator_traits<EntityAllocator>::deallocate(entAlloc, ent, 1);
+			compactArchetypes();
 		}
 	}
 
-	inline bool World::cleanup()
+	template<typename... Types, typename Func>
+	void World::parallelEach(Func&& viewFunc, bool bIncludePendingDestroy)
 	{
-		size_t count = 0;
-		entities.erase(std::remove_if(entities.begin(), entities.end(), [&, this](Entity* ent) {
-			if (ent->isPendingDestroy())
-			{
-				std::allocator_traits<EntityAllocator>::destroy(entAlloc, ent);
-				std::allocator_traits<EntityAllocator>::deallocate(entAlloc, ent, 1);
-				++count;
-				return true;
-			}
-
-			return false;
-		}), entities.end());
+		struct Chunk
+		{
+			Internal::Archetype* archetype;
+			size_t begin;
+			size_t end;
+		};
 
-		return count > 0;
-	}
+		const uint64_t startStamp = structuralStamp;
+		Internal::Query& query = getQuery(Internal::getComponentMask<Types...>());
 
-	inline void World::reset()
-	{
-		for (auto* ent : entities)
+		std::vector<Chunk> chunks;
+		for (auto* archetype : query.archetypes)
 		{
-			if (!ent->isPendingDestroy())
+			const size_t rowCount = archetype->entities.size();
+			for (size_t begin = 0; begin < rowCount; begin += ECS_PARALLEL_CHUNK_SIZE)
 			{
-				ent->bPendingDestroy = true;
-				emit<Events::OnEntityDestroyed>({ ent });
+				chunks.push_back({ archetype, begin, std::min(begin + ECS_PARALLEL_CHUNK_SIZE, rowCount) });
 			}
-			std::allocator_traits<EntityAllocator>::destroy(entAlloc, ent);
-			std::allocator_traits<EntityAllocator>::deallocate(entAlloc, ent, 1);
 		}
 
-		entities.clear();
-		lastEntityId = 0;
-	}
+		if (chunks.empty())
+			return;
 
-	inline void World::all(std::function<void(Entity*)> viewFunc, bool bIncludePendingDestroy)
-	{
-		for (auto* ent : all(bIncludePendingDestroy))
+		std::vector<Internal::CommandBuffer> buffers(chunks.size());
+		auto runChunk = [&](size_t c) {
+			Internal::CommandBufferScope scope(&buffers[c]);
+			const Chunk& chunk = chunks[c];
+			eachRow<Types...>(viewFunc, chunk.archetype, chunk.begin, chunk.end, startStamp, bIncludePendingDestroy, std::index_sequence_for<Types...>());
+		};
+
+		++iterationDepth;
+		Internal::TaskPool* pool = chunks.size() > 1 ? getTaskPool() : nullptr;
+		if (pool == nullptr)
 		{
-			viewFunc(ent);
+			for (size_t c = 0; c < chunks.size(); ++c)
+			{
+				runChunk(c);
+			}
 		}
-	}
-
-	inline Internal::EntityView World::all(bool bIncludePendingDestroy)
-	{
-		Internal::EntityIterator first(this, 0, false, bIncludePendingDestroy);
-		Internal::EntityIterator last(this, getCount(), true, bIncludePendingDestroy);
-		return Internal::EntityView(first, last);
-	}
+		else
+		{
+			std::vector<std::function<void()>> tasks;
+			tasks.reserve(chunks.size());
+			for (size_t c = 0; c < chunks.size(); ++c)
+			{
+				tasks.push_back([&runChunk, c]() { runChunk(c); });
+			}
 
-	inline Entity* World::getById(size_t id) const
-	{
-		if (id == Entity::InvalidEntityId || id > lastEntityId)
-			return nullptr;
+			pool->run(tasks);
+		}
 
-		// We should likely store entities in a map of id -> entity so that this is faster.
-		for (auto* ent : entities)
+		if (--iterationDepth == 0 && !dirtyArchetypes.empty())
 		{
-			if (ent->getEntityId() == id)
-				return ent;
+			compactArchetypes();
 		}
 
-		return nullptr;
-	}
-
-	template<typename... Types>
-	void World::each(typename std::common_type<std::function<void(Entity*, ComponentHandle<Types>...)>>::type viewFunc, bool bIncludePendingDestroy)
-	{
-		for (auto* ent : each<Types...>(bIncludePendingDestroy))
+		// Sync point: apply what the chunks recorded, unless changes are already being deferred by the caller
+		Internal::CommandBuffer* outer = Internal::currentCommandBuffer();
+		for (auto& buffer : buffers)
 		{
-			viewFunc(ent, ent->template get<Types>()...);
+			if (outer != nullptr)
+			{
+				outer->append(buffer);
+			}
+			else
+			{
+				buffer.execute();
+			}
 		}
 	}
 
 	template<typename T, typename... Args>
 	ComponentHandle<T> Entity::assign(Args&&... args)
 	{
-		using ComponentAllocator = std::allocator_traits<World::EntityAllocator>::template rebind_alloc<Internal::ComponentContainer<T>>;
+		// While changes are deferred, build the component now and assign it later. The handle is only valid afterwards,
+		// so an empty one is returned.
+		if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
+		{
+			auto data = std::make_shared<T>(std::forward<Args>(args)...);
+			buffer->push([this, data]() { assign<T>(std::move(*data)); });
+			return ComponentHandle<T>();
+		}
 
-		auto found = components.find(getTypeIndex<T>());
-		if (found != components.end())
+		const size_t type = Internal::getComponentTypeId<T>();
+		if (archetype->has(type))
 		{
-			Internal::ComponentContainer<T>* container = reinterpret_cast<Internal::ComponentContainer<T>*>(found->second);
-			container->data = T(args...);
+			T* data = static_cast<T*>(archetype->get(type, row));
+			*data = T(std::forward<Args>(args)...);
 
-			auto handle = ComponentHandle<T>(&container->data);
+			auto handle = ComponentHandle<T>(data);
 			world->emit<Events::OnComponentAssigned<T>>({ this, handle });
 			return handle;
 		}
 		else
 		{
-			ComponentAllocator alloc(world->getPrimaryAllocator());
-
-			Internal::ComponentContainer<T>* container = std::allocator_traits<ComponentAllocator>::allocate(alloc, 1);
-			std::allocator_traits<ComponentAllocator>::construct(alloc, container, T(args...));
-
-			components.insert({ getTypeIndex<T>(), container });
+			// Build the component before the entity moves, so its row is never left half made if the constructor
+			// throws or changes the entity itself
+			T component(std::forward<Args>(args)...);
+			world->getStorage<T>();
+			world->moveEntity(this, world->getArchetypeWith(archetype, type));
+			T* data = new (archetype->get(type, row)) T(std::move(component));
 
-			auto handle = ComponentHandle<T>(&container->data);
+			auto handle = ComponentHandle<T>(data);
 			world->emit<Events::OnComponentAssigned<T>>({ this, handle });
 			return handle;
 		}
 	}
 
 	template<typename T>
-	ComponentHandle<T> Entity::get()
+	bool Entity::remove()
+	{
+		const size_t type = Internal::getComponentTypeId<T>();
+		if (!archetype->has(type))
+			return false;
+
+		if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
+		{
+			buffer->push([this]() { remove<T>(); });
+			return true;
+		}
+
+		world->storages[type]->release(this, archetype->get(type, row));
+		world->moveEntity(this, world->getArchetypeWithout(archetype, type));
+		return true;
+	}
+
+	inline void Entity::removeAll()
 	{
-		auto found = components.find(getTypeIndex<T>());
-		if (found != components.end())
+		if (Internal::CommandBuffer* buffer = Internal::currentCommandBuffer())
+		{
+			buffer->push([this]() { removeAll(); });
+			return;
+		}
+
+		for (auto& column : archetype->columns)
 		{
-			return ComponentHandle<T>(&reinterpret_cast<Internal::ComponentContainer<T>*>(found->second)->data);
+			column.storage->release(this, column.at(row));
 		}
-	
-		return ComponentHandle<T>();
+
+		world->moveEntity(this, world->rootArchetype);
+	}
+
+	template<typename T>
+	ComponentHandle<T> Entity::get()
+	{
+		return ComponentHandle<T>(static_cast<T*>(archetype->get(Internal::getComponentTypeId<T>(), row)));
 	}
 
 	namespace Internal
@@ -25,7 +25,9 @@ class Expire : Component {
       );
 
       // Add the easy expiry function
-      env.set("expireEntity", &Expire::expireEntity);
+      env.set_function("expireEntity", [](const ECS::EntityHandle& e, float time) {
+        expireEntity(Script::Funcs::resolve(e), time);
+      });
     }
 
     // Convenience function for expiring an entity
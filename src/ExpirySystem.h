@@ -28,6 +28,13 @@ class ExpirySystem : public ECS::EntitySystem {
       });
     }
 
+    // Constructor, destruction is deferred to the end of the wave so this can run anywhere
+    ExpirySystem() {
+      setName("ExpirySystem");
+      writes<Expire>();
+      setAffinity(Affinity::Any);
+    }
+
     // Delete any entities that have an expired Expire Component
     virtual void update(ECS::World* world, const sf::Time& dt) override {
       world->each<Expire>([&](ECS::Entity* e, ECS::ComponentHandle<Expire> x) {
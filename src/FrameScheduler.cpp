@@ -0,0 +1,102 @@
+// FrameScheduler.cpp
+// Keeps a loop running at a steady rate and measures how long its frames take
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+// Wake up this early and spin for the rest of the wait
+const std::chrono::microseconds FrameScheduler::SpinTime(1000);
+
+// Constructor, a rate of 0 runs as fast as possible
+FrameScheduler::FrameScheduler(unsigned rate)
+  : period_(Clock::duration::zero())
+  , next_(Clock::now()) {
+  setRate(rate);
+}
+
+// Change how many times per second the loop should run
+void
+FrameScheduler::setRate(unsigned rate) {
+  period_ = rate == 0
+    ? Clock::duration::zero()
+    : std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+  next_ = Clock::now() + period_;
+}
+
+// Get how many times per second the loop should run
+unsigned
+FrameScheduler::getRate() const {
+  if (period_ == Clock::duration::zero()) { return 0; }
+  return (unsigned)(1.0 / std::chrono::duration<double>(period_).count() + 0.5);
+}
+
+// Check whether the next frame is due, without waiting
+bool
+FrameScheduler::isDue() const {
+  return Clock::now() >= next_;
+}
+
+// Wait until the next frame is due, then schedule the one after it
+void
+FrameScheduler::wait() {
+
+  // Unlimited, just give other threads a chance
+  if (period_ == Clock::duration::zero()) {
+    std::this_thread::yield();
+    return;
+  }
+
+  // Sleep for most of the time, then spin for the last part
+  if (Clock::now() + SpinTime < next_) {
+    std::this_thread::sleep_until(next_ - SpinTime);
+  }
+  while (Clock::now() < next_) {
+    std::this_thread::yield();
+  }
+
+  // Keep to the schedule, unless we've fallen more than a frame behind
+  // Trying to catch up would only make the following frames late too
+  next_ += period_;
+  const auto now = Clock::now();
+  if (next_ < now) { next_ = now + period_; }
+}
+
+// Schedule the next frame without waiting, keeping to the schedule like wait() does
+void
+FrameScheduler::skip() {
+  next_ += period_;
+  const auto now = Clock::now();
+  if (next_ < now) { next_ = now + period_; }
+}
+
+// Constructor
+FrameTimes::FrameTimes(std::size_t capacity)
+  : next_(0)
+  , capacity_(capacity) {
+  samples_.reserve(capacity);
+}
+
+// Record how long a frame took, in seconds
+void
+FrameTimes::add(float seconds) {
+  if (samples_.size() < capacity_) {
+    samples_.push_back(seconds);
+  }
+  else {
+    samples_[next_] = seconds;
+  }
+  next_ = (next_ + 1) % capacity_;
+}
+
+// Get the frame time at a percentile (0 to 100) of recent frames, in seconds
+float
+FrameTimes::getPercentile(float percentile) const {
+  if (samples_.empty()) { return 0.f; }
+  std::vector<float> sorted(samples_);
+  const float clamped = std::min(std::max(percentile, 0.f), 100.f);
+  const std::size_t n = (std::size_t)(clamped / 100.f * (sorted.size() - 1) + 0.5f);
+  std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+  return sorted[n];
+}
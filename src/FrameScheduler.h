@@ -0,0 +1,67 @@
+// FrameScheduler.h
+// Keeps a loop running at a steady rate and measures how long its frames take
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <chrono>
+#include <vector>
+
+// Paces a loop to a target rate
+// Sleeps for most of the wait and spins for the last moment, as sleeping alone wakes up too late
+class FrameScheduler {
+  public:
+
+    // Constructor, a rate of 0 runs as fast as possible
+    FrameScheduler(unsigned rate = 0);
+
+    // Change how many times per second the loop should run
+    void setRate(unsigned rate);
+    unsigned getRate() const;
+
+    // Check whether the next frame is due, without waiting
+    bool isDue() const;
+
+    // Wait until the next frame is due, then schedule the one after it
+    void wait();
+
+    // Schedule the next frame one period after the last, without waiting
+    void skip();
+
+  private:
+
+    // Clock used for pacing
+    typedef std::chrono::steady_clock Clock;
+
+    // Wake up this early and spin for the rest of the wait
+    static const std::chrono::microseconds SpinTime;
+
+    // How long each frame should last
+    Clock::duration period_;
+
+    // When the next frame is due
+    Clock::time_point next_;
+};
+
+// Keeps the most recent frame times to report percentiles
+class FrameTimes {
+  public:
+
+    // Constructor
+    FrameTimes(std::size_t capacity = 240);
+
+    // Record how long a frame took, in seconds
+    void add(float seconds);
+
+    // Get the frame time at a percentile (0 to 100) of recent frames, in seconds
+    float getPercentile(float percentile) const;
+
+  private:
+
+    // Recent frame times, oldest overwritten first
+    std::vector<float> samples_;
+    std::size_t next_;
+    std::size_t capacity_;
+};
+
+#endif
@@ -10,7 +10,13 @@
 sf::RenderWindow* Game::window_ = nullptr;
 sf::View Game::view = sf::View();
 bool Game::multiThread_ = false;
+bool Game::headless_ = false;
+Game::HeadlessSettings Game::headlessSettings_;
+std::vector<sf::Event> Game::sentEvents_;
 std::mutex Game::windowMutex_;
+std::mutex Game::frameMutex_;
+std::condition_variable Game::frameReady_;
+unsigned long Game::frameCount_ = 0;
 bool Game::debug_ = false;
 Game::Status Game::status_ = Game::Status::Uninitialised;
 Scene* Game::currentScene_ = nullptr;
@@ -19,7 +25,14 @@ sf::Vector2f Game::mousePosition_ = sf::Vector2f();
 sf::Vector2f Game::displaySize_ = sf::Vector2f();
 Console Game::console_;
 bool Game::showConsole_ = false;
+bool Game::showProfiler_ = false;
 unsigned Game::fps_ = 0;
+FrameScheduler Game::updatePacing_;
+FrameScheduler Game::renderPacing_;
+bool Game::vsync_ = false;
+sf::Time Game::simulationStep_ = sf::seconds(1.f / 60.f);
+unsigned Game::maxSimulationSteps_ = 5;
+FrameTimes Game::frameTimes_;
 bool Game::isImguiReady_ = false;
 std::queue<ImWchar> Game::queuedChars_ = std::queue<ImWchar>();
 
@@ -42,8 +55,8 @@ Game::initialise(const sf::VideoMode& mode, const std::string& title, bool multi
     Build_VERSION_MINOR, 
     Build_VERSION_TWEAK);
 
-  // Flag whether we are in multithreaded mode
-  multiThread_ = multiThread;
+  // Flag whether we are in multithreaded mode, there's nothing to render on another thread when headless
+  multiThread_ = multiThread && !headless_;
 
   // Initialise Lua and ensure it works
   bool success = initialiseLua("GameConfig.lua");
@@ -56,21 +69,32 @@ Game::initialise(const sf::VideoMode& mode, const std::string& title, bool multi
   }
 
   // Print if we are in multithreaded mode or not
-  Console::log("Running in %s mode.", multiThread_ ? "multithreaded" : "standard");
+  Console::log("Running in %s mode.", headless_ ? "headless" : multiThread_ ? "multithreaded" : "standard");
+
+  // Without a window, the view is sized as if there was one
+  if (headless_) {
+    displaySize_ = sf::Vector2f(mode.width, mode.height);
+    view = sf::View(sf::FloatRect(0.f, 0.f, displaySize_.x, displaySize_.y));
+  }
 
   // Create window and prepare view
-  window_ = new sf::RenderWindow(mode, title);
-  view = window_->getDefaultView();
+  else {
+    window_ = new sf::RenderWindow(mode, title);
+    window_->setVerticalSyncEnabled(vsync_);
+    view = window_->getDefaultView();
 
-  // Set up size of the window
-  const auto size = window_->getSize();
-  displaySize_ = sf::Vector2f(size.x, size.y);
+    // Set up size of the window
+    const auto size = window_->getSize();
+    displaySize_ = sf::Vector2f(size.x, size.y);
+  }
 
   // Load assets
   ResourceManager::loadResources("Assets/");
 
   // Enable debugging functionality
-  ImGui::SFML::Init(*window_);
+  if (!headless_) {
+    ImGui::SFML::Init(*window_);
+  }
 
   // Flag that the game is ready to start
   status_ = Game::Status::Ready;
@@ -89,6 +113,12 @@ Game::start() {
   // We are now running the game
   status_ = Game::Status::Running;
 
+  // Without a window, just simulate
+  if (headless_) {
+    runHeadless();
+    return;
+  }
+
   // Create a clock for measuring deltaTime
   sf::Clock clock_;
 
@@ -112,9 +142,11 @@ Game::start() {
 
   // Main game loop while window is open
   while (status_ < Game::Status::ShuttingDown) {
+    Profiler::markFrame();
 
     // Get the time since last tick
     sf::Time elapsed_ = clock_.restart();
+    frameTimes_.add(elapsed_.asSeconds());
 
     // Calculate FPS
     if (fpsClock_.getElapsedTime().asSeconds() >= 1.0f) {
@@ -124,53 +156,54 @@ Game::start() {
     }
     ++fpsFrame_;
 
-    // Prepare to collect input events
-    bool process = true;
+    // Collect input events
+    // The render thread only draws snapshots, so events can be polled while it renders
     std::vector<sf::Event> events;
-
-    // If multithreading, gain access to window quickly
-    if (multiThread_) { process = windowMutex_.try_lock(); }
     sf::Event e;
+    while (window_ != nullptr && window_->pollEvent(e)) {
+      events.push_back(e);
+    }
 
-    // If we're allowed to process data
-    if (process) {
+    // Include events sent from code
+    events.insert(events.end(), sentEvents_.begin(), sentEvents_.end());
+    sentEvents_.clear();
 
-      // Collect events
-      while (window_->pollEvent(e)) {
-        events.push_back(e);
-      }
+    // Process events
+    for (auto ev : events) {
 
-      // Disable the lock, we don't need the window
-      if (multiThread_) { 
-        windowMutex_.unlock(); 
+      // Begin closing the game on quit
+      // Otherwise, pass the event to the scene
+      if (ev.type != sf::Event::Closed) {
+        handleEvent(ev);
       }
-
-      // Resume processing events
-      for (auto ev : events) {
-
-        // Begin closing the game on quit
-        // Otherwise, pass the event to the scene
-        if (ev.type != sf::Event::Closed) {
-          handleEvent(ev);
-        }
-        else {
-          quit();
-        }
+      else {
+        quit();
       }
     }
 
     // Update the game
     update(elapsed_);
 
-    // Render every frame after updating
+    // Render after updating whenever a render is due
     if (!multiThread_) {
-      if (status_ < Game::Status::ShuttingDown) {
+      if (status_ < Game::Status::ShuttingDown && renderPacing_.isDue()) {
         render();
+        renderPacing_.skip();
       }
     }
+
+    // Wake the render thread, the scene has published a new frame
     else {
-      std::this_thread::yield();
+      {
+        std::lock_guard<std::mutex> lock(frameMutex_);
+        ++frameCount_;
+      }
+      frameReady_.notify_one();
     }
+
+    // Wait until the next update is due
+    PROFILE_SCOPE("Game::waitForUpdate");
+    updatePacing_.wait();
   }
 
   // Wait for render thread to finish
@@ -180,6 +213,87 @@ Game::start() {
   }
 }
 
+// Headless loop, updating at a fixed timestep as fast as possible
+void
+Game::runHeadless() {
+
+  // Load the input script if there is one, it should return a function taking the tick number
+  sol::function input;
+  if (!headlessSettings_.inputScript.empty()) {
+    auto attempt = Game::lua.script_file(headlessSettings_.inputScript, &sol::script_pass_on_error);
+    if (!attempt.valid()) {
+      sol::error err = attempt;
+      Console::log("[Error] in %s:\n> %s", headlessSettings_.inputScript.c_str(), err.what());
+    }
+    else if (attempt.get_type() != sol::type::function) {
+      Console::log("[Error] Input script %s should return a function.", headlessSettings_.inputScript.c_str());
+    }
+    else {
+      input = attempt;
+    }
+  }
+
+  // Record the whole run if asked to
+  if (!headlessSettings_.profilePath.empty()) {
+    Profiler::setEnabled(true);
+  }
+
+  // Every tick is the same length, regardless of how long it really takes
+  const sf::Time dt = sf::seconds(headlessSettings_.timestep);
+  const unsigned ticks = headlessSettings_.ticks;
+  Console::log("Simulating %u ticks of %.2fms..", ticks, dt.asSeconds() * 1000.f);
+
+  // Simulate until we're out of ticks or the game quits
+  sf::Clock clock;
+  sf::Clock tickClock;
+  unsigned tick = 0;
+  for (; status_ < Game::Status::ShuttingDown && (ticks == 0 || tick < ticks); ++tick) {
+    Profiler::markFrame();
+
+    // Let the script provide this tick's input
+    if (input.valid()) {
+      if (currentScene_ != nullptr) { currentScene_->syncBackgroundWork(); }
+      auto result = input(tick);
+      if (!result.valid()) {
+        sol::error err = result;
+        Console::log("[Error] in headless input on tick %u:\n> %s", tick, err.what());
+        input = sol::function();
+      }
+    }
+
+    // Handle sent events, nothing comes from a window
+    std::vector<sf::Event> events;
+    events.swap(sentEvents_);
+    for (const auto& ev : events) {
+      if (ev.type != sf::Event::Closed) { handleEvent(ev); }
+      else { quit(); }
+    }
+
+    // Update the game
+    update(dt);
+    frameTimes_.add(tickClock.restart().asSeconds());
+  }
+
+  // Report how fast the simulation ran
+  const float elapsed = clock.getElapsedTime().asSeconds();
+  Console::log("Simulated %u ticks in %.3fs (%.0f ticks/s, p50 %.3fms, p99 %.3fms).",
+    tick,
+    elapsed,
+    elapsed > 0.f ? tick / elapsed : 0.f,
+    getFrameTime(50.f) * 1000.f,
+    getFrameTime(99.f) * 1000.f);
+
+  // Then what the scene's systems were doing
+  if (currentScene_ != nullptr) {
+    currentScene_->reportStats();
+  }
+
+  // Write out the profile
+  if (!headlessSettings_.profilePath.empty()) {
+    Profiler::exportChromeTrace(headlessSettings_.profilePath);
+  }
+}
+
 // Initialise lua
 bool 
 Game::initialiseLua(const std::string& fp) {
@@ -194,6 +308,10 @@ Game::initialiseLua(const std::string& fp) {
     "quit", &Game::quit,
     "terminate", &Game::terminate,
     "openDevConsole", &Game::openDevConsole,
+    "sendEvent", &Game::sendEvent,
+    "frameTime", &Game::getFrameTime,
+    "interpolation", sol::property(&Game::getInterpolation),
+    "simulationStats", sol::property(&Game::getSimulationStats),
     // Variables
     "window", sol::property(&Game::getWindow),
     "displaySize", sol::property(&Game::getDisplaySize),
@@ -202,14 +320,30 @@ Game::initialiseLua(const std::string& fp) {
       &Game::setDebugMode),
     "fps", sol::property(&Game::getFPS),
     "status", sol::property(&Game::getStatus),
+    "headless", sol::property(&Game::isHeadless),
     "mousePosition", sol::property(&Game::getMousePosition)
   );
 
+  // How the scene's simulation is keeping up
+  Game::lua.new_usertype<SimulationStats>("SimulationStats",
+    "step", sol::readonly(&SimulationStats::step),
+    "maxSteps", sol::readonly(&SimulationStats::maxSteps),
+    "steps", sol::readonly(&SimulationStats::steps),
+    "backlog", sol::readonly(&SimulationStats::backlog),
+    "clamped", sol::readonly(&SimulationStats::clamped),
+    "clampedUpdates", sol::readonly(&SimulationStats::clampedUpdates),
+    "dropped", sol::readonly(&SimulationStats::dropped),
+    "quality", sol::readonly(&SimulationStats::quality),
+    "load", sol::readonly(&SimulationStats::load)
+  );
+
   // Console Convenience functions
   Game::lua.set_function("quit", &Game::quit);
   Console::addCommand("quit");
 
   Console::addCommand("[Class] Entity");
+  Console::addCommand("Entity.isValid");
+  Console::addCommand("Entity.id");
   Console::addCommand("Entity:assignTYPE");
   Console::addCommand("Entity:hasTYPE");
   Console::addCommand("Entity:getTYPE");
@@ -219,6 +353,11 @@ Game::initialiseLua(const std::string& fp) {
   Console::addCommand("Game:quit");
   Console::addCommand("Game.debug");
   Console::addCommand("Game.fps");
+  Console::addCommand("Game.headless");
+  Console::addCommand("Game:sendEvent");
+  Console::addCommand("Game.frameTime");
+  Console::addCommand("Game.interpolation");
+  Console::addCommand("Game.simulationStats");
   Console::addCommand("Game.mousePosition");
 
   // Allow use of the console
@@ -253,19 +392,64 @@ Game::initialiseLua(const std::string& fp) {
   bool attemptMultiThread = attempt;
   multiThread_ &= attemptMultiThread;
 
+  // Allow the game config to pace the game
+  configureFramePacing();
+
   return true;
 }
 
+// Read frame pacing settings from lua
+void
+Game::configureFramePacing() {
+
+  // Headless ticks are each a single simulation step, so runs are reproducible
+  if (headless_) {
+    simulationStep_ = sf::seconds(headlessSettings_.timestep);
+  }
+
+  // Nothing to do if the game config doesn't specify anything
+  sol::optional<sol::table> pacing = Game::lua["FramePacing"];
+  if (!pacing) {
+    Console::log("Frame pacing not configured, running unlimited.");
+    return;
+  }
+
+  // Rates are per second, 0 is unlimited
+  const unsigned updateRate = pacing.value().get_or("updateRate", 0u);
+  const unsigned renderRate = pacing.value().get_or("renderRate", 0u);
+  vsync_ = pacing.value().get_or("vsync", false);
+  updatePacing_.setRate(updateRate);
+  renderPacing_.setRate(renderRate);
+
+  // The simulation always steps at a fixed rate, whatever the update rate
+  const unsigned simulationRate = pacing.value().get_or("simulationRate", 60u);
+  maxSimulationSteps_ = pacing.value().get_or("maxSimulationSteps", 5u);
+  if (maxSimulationSteps_ == 0) { maxSimulationSteps_ = 1; }
+  if (!headless_ && simulationRate > 0) {
+    simulationStep_ = sf::seconds(1.f / simulationRate);
+  }
+
+  Console::log("Frame pacing: %u updates/s, %u renders/s, %.0f simulation steps/s, vsync %s.",
+    updateRate, 
+    renderRate, 
+    1.f / simulationStep_.asSeconds(),
+    vsync_ ? "enabled" : "disabled");
+}
+
 // Called every frame, returns true when game should end
 void
 Game::update(const sf::Time& dt) {
+  PROFILE_SCOPE("Game::update");
 
   // Easy out
-  if (window_ == nullptr) return;
+  if (window_ == nullptr && !headless_) return;
 
   // Update mouse position every frame
-  sf::Vector2i mousePixelCoords = sf::Mouse::getPosition(*window_);
-  mousePosition_ = window_->mapPixelToCoords(mousePixelCoords);
+  sf::Vector2i mousePixelCoords;
+  if (window_ != nullptr) {
+    mousePixelCoords = sf::Mouse::getPosition(*window_);
+    mousePosition_ = window_->mapPixelToCoords(mousePixelCoords);
+  }
 
   // Update the screen if the pointer is set
   if (currentScene_ != nullptr) {
@@ -273,7 +457,7 @@ Game::update(const sf::Time& dt) {
   }
 
   // Update IMGUI debug interfaces
-  if (debug_ && !isImguiReady_) {
+  if (debug_ && !isImguiReady_ && !headless_) {
 
     // Pass queued characters to ImGui
     auto& io = ImGui::GetIO();
@@ -300,18 +484,36 @@ Game::handleRenderThread() {
   // Easy out
   if (Game::getStatus() < Game::Status::Running) return;
 
-  // Continually render the game while
+  // Render each frame once it has been published
+  unsigned long rendered = 0;
   while (Game::getStatus() < Game::Status::ShuttingDown) {
-    windowMutex_.lock();
-    Game::render();
-    windowMutex_.unlock();
-    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+
+    // Sleep until the update thread publishes something new
+    // Time out occasionally so that shutting down is noticed
+    {
+      std::unique_lock<std::mutex> lock(frameMutex_);
+      frameReady_.wait_for(lock, std::chrono::milliseconds(100), [&rendered]() {
+        return frameCount_ != rendered;
+      });
+      rendered = frameCount_;
+    }
+
+    // The window can't be closed while it's being drawn to
+    {
+      std::lock_guard<std::mutex> lock(windowMutex_);
+      Game::render();
+    }
+
+    // Wait until the next render is due
+    PROFILE_SCOPE("Game::waitForRender");
+    renderPacing_.wait();
   }
 }
 
 // Render the game every frame, after update
 void
 Game::render() {
+  PROFILE_SCOPE("Game::render");
 
   // Easy out
   if (window_ == nullptr) return;
@@ -320,8 +522,8 @@ Game::render() {
   window_->clear();
 
   // Render the game if pointer is set
+  // The scene sets the view it rendered with
   if (currentScene_ != nullptr) {
-    window_->setView(view);
     currentScene_->render(*window_);
   }
 
@@ -348,8 +550,8 @@ Game::handleEvent(const sf::Event& event) {
 
   // Pass events to IMGUI debug interface
   bool passToGame = true;
-  bool passToImgui = debug_;
-  if (debug_) {
+  bool passToImgui = debug_ && !headless_;
+  if (passToImgui) {
 
     // Get reference to IO
     auto& io = ImGui::GetIO();
@@ -402,6 +604,8 @@ Game::terminate() {
   status_ = Game::Status::ShuttingDown;
 
   // Close the window, exiting the game loop
+  // Wait for the render thread to finish with it first
+  std::lock_guard<std::mutex> lock(windowMutex_);
   if (window_ != nullptr) {
     window_->close();
     delete window_;
@@ -409,7 +613,9 @@ Game::terminate() {
   }
 
   // Shut down IMGUI debug interface
-  ImGui::SFML::Shutdown();
+  if (!headless_) {
+    ImGui::SFML::Shutdown();
+  }
 }
 
 // Free resources before program closes
@@ -458,6 +664,11 @@ Game::switchScene(Scene* scene) {
 void
 Game::handleImgui() {
 
+  // Debug windows and the console can reach into the scene
+  if (currentScene_ != nullptr) {
+    currentScene_->syncBackgroundWork();
+  }
+
   // Set up IMGUI flags
   ImGuiWindowFlags flags = 0;
   flags |= ImGuiWindowFlags_MenuBar;
@@ -470,6 +681,7 @@ Game::handleImgui() {
     if (ImGui::BeginMenu("View")) {
       ImGui::MenuItem("Demo imgui", NULL, &showImguiDemo);
       ImGui::MenuItem("Console", NULL, &showConsole_);
+      ImGui::MenuItem("Profiler", NULL, &showProfiler_);
 
       // Allow the scene to make entries to the view tab
       if (currentScene_ != nullptr) {
@@ -486,10 +698,19 @@ Game::handleImgui() {
   // Show console
   if (showConsole_) { console_.create("Console", &showConsole_); }
 
+  // Show profiler
+  if (showProfiler_) { Profiler::showDebugWindow(&showProfiler_); }
+
   // Info
   ImGui::Spacing();
   ImGui::Text(std::string(
     "FPS: " + std::to_string(fps_)).c_str());
+  ImGui::Text("Frame Time: %.2fms (p50), %.2fms (p99)",
+    getFrameTime(50.f) * 1000.f,
+    getFrameTime(99.f) * 1000.f);
+  ImGui::Text("Simulation: %.0f steps/s, interpolation %.2f",
+    1.f / simulationStep_.asSeconds(),
+    getInterpolation());
   ImGui::Text(std::string(
     "Window Size: " + 
     std::to_string((int)displaySize_.x) + "x" + 
@@ -527,6 +748,29 @@ Game::openDevConsole() {
   }
 }
 
+// Run without a window, rendering or IMGUI
+void
+Game::setHeadless(const HeadlessSettings& settings) {
+  if (status_ != Game::Status::Uninitialised) {
+    Console::log("[Error] Cannot switch to headless mode after initialising.");
+    return;
+  }
+  headless_ = true;
+  headlessSettings_ = settings;
+}
+
+// Get whether we're running without a window
+bool
+Game::isHeadless() {
+  return headless_;
+}
+
+// Queue an event to be handled before the next update
+void
+Game::sendEvent(const sf::Event& event) {
+  sentEvents_.push_back(event);
+}
+
 // Get a pointer to the game's window
 const sf::RenderWindow*
 Game::getWindow() {
@@ -539,6 +783,37 @@ Game::getFPS() {
   return fps_;
 }
 
+// Get frame time at a percentile of recent frames
+float
+Game::getFrameTime(float percentile) {
+  return frameTimes_.getPercentile(percentile);
+}
+
+// Get how long each simulation step lasts
+sf::Time
+Game::getSimulationStep() {
+  return simulationStep_;
+}
+
+// Get how many simulation steps can be taken in a single frame
+unsigned
+Game::getMaxSimulationSteps() {
+  return maxSimulationSteps_;
+}
+
+// Get how far rendering is between the last two simulation steps
+float
+Game::getInterpolation() {
+  return currentScene_ != nullptr ? currentScene_->getInterpolation() : 1.f;
+}
+
+// Get how the current scene's simulation is keeping up
+const SimulationStats&
+Game::getSimulationStats() {
+  static const SimulationStats noStats;
+  return currentScene_ != nullptr ? currentScene_->getSimulationStats() : noStats;
+}
+
 // Get status of application
 Game::Status
 Game::getStatus() {
@@ -6,12 +6,15 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <functional>
 #include <queue>
+#include <vector>
 
 #include <SFML/Graphics.hpp>
 
+#include "FrameScheduler.h"
 #include "ResourceManager.h"
 #include "Console.h"
 #include "Common.h"
@@ -26,12 +29,39 @@ class Game {
     // What the game is currently doing
     enum Status { Uninitialised, Ready, Running, Quitting, ShuttingDown };
 
+    // How to run the game without a window
+    struct HeadlessSettings {
+
+      // Constructor
+      HeadlessSettings()
+        : ticks(0)
+        , timestep(1.f / 60.f) {
+      }
+
+      // How many updates to run, 0 runs until the game quits
+      unsigned ticks;
+
+      // Time passed to each update, in seconds
+      float timestep;
+
+      // Optional lua script returning a function(tick) that sends input with Game.sendEvent
+      std::string inputScript;
+
+      // Optional file to write a Chrome trace of the run to
+      std::string profilePath;
+    };
+
     // The lua state
     static sol::state lua;
 
     // View to use for rendering
     static sf::View view;
 
+    // Run without a window, rendering or IMGUI
+    // @NOTE: Call before initialise, the video mode then only sets the size of the view
+    static void setHeadless(const HeadlessSettings& settings);
+    static bool isHeadless();
+
     // Initialise the game window
     static void initialise(const sf::VideoMode& m, const std::string& title, bool multiThread = false);
 
@@ -47,12 +77,28 @@ class Game {
     // Get the FPS of the application
     static unsigned getFPS();
 
+    // Get the frame time at a percentile (0 to 100) of recent frames, in seconds
+    static float getFrameTime(float percentile);
+
+    // Get how long each simulation step lasts, and how many can be taken in a single frame
+    static sf::Time getSimulationStep();
+    static unsigned getMaxSimulationSteps();
+
+    // Get how far rendering is between the last two simulation steps, from 0 to 1
+    static float getInterpolation();
+
+    // Get how the current scene's simulation is keeping up
+    static const SimulationStats& getSimulationStats();
+
     // Get the status of the game
     static Status getStatus();
 
     // Open the dev console
     static void openDevConsole();
 
+    // Queue an event to be handled before the next update, as if it came from the window
+    static void sendEvent(const sf::Event& event);
+
     // Tell the application to quit
     static void quit();
 
@@ -84,6 +130,13 @@ class Game {
     // Whether we are multithreaded
     static bool multiThread_;
 
+    // Whether we are running without a window, and how
+    static bool headless_;
+    static HeadlessSettings headlessSettings_;
+
+    // Events sent from code rather than the window
+    static std::vector<sf::Event> sentEvents_;
+
     // Enable debugging functionality
     static bool debug_;
 
@@ -93,6 +146,11 @@ class Game {
     // Mutex to protect the window for rendering
     static std::mutex windowMutex_;
 
+    // Lets the render thread sleep until a new frame has been published
+    static std::mutex frameMutex_;
+    static std::condition_variable frameReady_;
+    static unsigned long frameCount_;
+
     // Scene management
     static Scene* currentScene_;
 
@@ -106,9 +164,24 @@ class Game {
     static Console console_;
     static bool showConsole_;
 
+    // Whether to show the profiler
+    static bool showProfiler_;
+
     // FPS
     static unsigned fps_;
 
+    // Pacing of updates and renders, configured by GameConfig.lua
+    static FrameScheduler updatePacing_;
+    static FrameScheduler renderPacing_;
+    static bool vsync_;
+
+    // Length of a simulation step and how many can be taken per frame before time is dropped
+    static sf::Time simulationStep_;
+    static unsigned maxSimulationSteps_;
+
+    // Recent frame times
+    static FrameTimes frameTimes_;
+
     // Whether IMGUI is ready
     static bool isImguiReady_;
 
@@ -118,12 +191,18 @@ class Game {
     // Initialise lua
     static bool initialiseLua(const std::string& fp);
 
+    // Read frame pacing settings from lua
+    static void configureFramePacing();
+
     // Main game loop 
     static void update(const sf::Time& dt);
 
     // Multithread's render loop
     static void handleRenderThread();
 
+    // Headless loop, updating at a fixed timestep as fast as possible
+    static void runHeadless();
+
     // Render the game
     static void render();
 
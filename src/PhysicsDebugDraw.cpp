@@ -28,19 +28,14 @@ void PhysicsDebugDraw::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, co
   // Easy out
   if (!PhysicsSystem::showRigidBodies_) { return; }
 
-	sf::ConvexShape polygon(vertexCount);
-	sf::Vector2f center;
+	sf::Vector2f points[b2_maxPolygonVertices];
 	for(int i = 0; i < vertexCount; i++) {
-		//polygon.setPoint(i, SFMLDraw::B2VecToSFVec(vertices[i]));
 		sf::Vector2f transformedVec = PhysicsDebugDraw::B2VecToSFVec(vertices[i]);
     // flooring the coords to fix distorted lines on flat surfaces
-		polygon.setPoint(i, sf::Vector2f(std::floor(transformedVec.x), std::floor(transformedVec.y))); 
-	}																								   // they still show up though.. but less frequently
-	polygon.setOutlineThickness(-1.f);
-	polygon.setFillColor(sf::Color::Transparent);
-	polygon.setOutlineColor(PhysicsDebugDraw::GLColorToSFML(color));
+		points[i] = sf::Vector2f(std::floor(transformedVec.x), std::floor(transformedVec.y));
+	}
 
-	window->draw(polygon);
+	addPolygon(points, vertexCount, PhysicsDebugDraw::GLColorToSFML(color), sf::Color::Transparent);
 }
 
 void PhysicsDebugDraw::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) {
@@ -48,18 +43,14 @@ void PhysicsDebugDraw::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCoun
   // Easy out
   if (!PhysicsSystem::showRigidBodies_) { return; }
 
-	sf::ConvexShape polygon(vertexCount);
+	sf::Vector2f points[b2_maxPolygonVertices];
 	for(int i = 0; i < vertexCount; i++) {
-		//polygon.setPoint(i, SFMLDraw::B2VecToSFVec(vertices[i]));
 		sf::Vector2f transformedVec = PhysicsDebugDraw::B2VecToSFVec(vertices[i]);
     // flooring the coords to fix distorted lines on flat surfaces
-		polygon.setPoint(i, sf::Vector2f(std::floor(transformedVec.x), std::floor(transformedVec.y))); 
-	}																								   // they still show up though.. but less frequently
-	polygon.setOutlineThickness(-1.0f);
-	polygon.setFillColor(PhysicsDebugDraw::GLColorToSFML(color, 60));
-	polygon.setOutlineColor(PhysicsDebugDraw::GLColorToSFML(color));
+		points[i] = sf::Vector2f(std::floor(transformedVec.x), std::floor(transformedVec.y));
+	}
 
-	window->draw(polygon);
+	addPolygon(points, vertexCount, PhysicsDebugDraw::GLColorToSFML(color), PhysicsDebugDraw::GLColorToSFML(color, 60));
 }
 
 void PhysicsDebugDraw::DrawCircle(const b2Vec2& center, float32 radius, const b2Color& color) {
@@ -67,14 +58,7 @@ void PhysicsDebugDraw::DrawCircle(const b2Vec2& center, float32 radius, const b2
   // Easy out
   if (!PhysicsSystem::showRigidBodies_) { return; }
 
-	sf::CircleShape circle(radius * PhysicsSystem::scale);
-	circle.setOrigin(radius * PhysicsSystem::scale, radius * PhysicsSystem::scale);
-	circle.setPosition(PhysicsDebugDraw::B2VecToSFVec(center));
-	circle.setFillColor(sf::Color::Transparent);
-	circle.setOutlineThickness(-1.f);
-	circle.setOutlineColor(PhysicsDebugDraw::GLColorToSFML(color));
-
-	window->draw(circle);
+	addCircle(center, radius, PhysicsDebugDraw::GLColorToSFML(color), sf::Color::Transparent);
 }
 
 void PhysicsDebugDraw::DrawSolidCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color) {
@@ -82,21 +66,10 @@ void PhysicsDebugDraw::DrawSolidCircle(const b2Vec2& center, float32 radius, con
   // Easy out
   if (!PhysicsSystem::showRigidBodies_) { return; }
 
-	sf::CircleShape circle(radius * PhysicsSystem::scale);
-	circle.setOrigin(radius * PhysicsSystem::scale, radius * PhysicsSystem::scale);
-	circle.setPosition(PhysicsDebugDraw::B2VecToSFVec(center));
-	circle.setFillColor(PhysicsDebugDraw::GLColorToSFML(color, 60));
-	circle.setOutlineThickness(1.f);
-	circle.setOutlineColor(PhysicsDebugDraw::GLColorToSFML(color));
+	addCircle(center, radius, PhysicsDebugDraw::GLColorToSFML(color), PhysicsDebugDraw::GLColorToSFML(color, 60));
 
 	b2Vec2 endPoint = center + radius * axis;
-	sf::Vertex line[2] = {
-		sf::Vertex(PhysicsDebugDraw::B2VecToSFVec(center), PhysicsDebugDraw::GLColorToSFML(color)),
-		sf::Vertex(PhysicsDebugDraw::B2VecToSFVec(endPoint), PhysicsDebugDraw::GLColorToSFML(color)),
-	};
-
-	window->draw(circle);
-	window->draw(line, 2, sf::Lines);
+	addLine(PhysicsDebugDraw::B2VecToSFVec(center), PhysicsDebugDraw::B2VecToSFVec(endPoint), PhysicsDebugDraw::GLColorToSFML(color));
 }
 
 void PhysicsDebugDraw::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color) {
@@ -104,12 +77,7 @@ void PhysicsDebugDraw::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2C
   // Easy out
   if (!PhysicsSystem::showRigidBodies_) { return; }
 
-	sf::Vertex line[] = {
-		sf::Vertex(PhysicsDebugDraw::B2VecToSFVec(p1), PhysicsDebugDraw::GLColorToSFML(color)),
-		sf::Vertex(PhysicsDebugDraw::B2VecToSFVec(p2), PhysicsDebugDraw::GLColorToSFML(color))
-	};
-
-	window->draw(line, 2, sf::Lines);
+	addLine(PhysicsDebugDraw::B2VecToSFVec(p1), PhysicsDebugDraw::B2VecToSFVec(p2), PhysicsDebugDraw::GLColorToSFML(color));
 }
 
 void PhysicsDebugDraw::DrawTransform(const b2Transform& xf) {
@@ -135,8 +103,8 @@ void PhysicsDebugDraw::DrawTransform(const b2Transform& xf) {
 		sf::Vertex(PhysicsDebugDraw::B2VecToSFVec(yAxis), sf::Color::Green)
 	};
 
-	window->draw(redLine, 2, sf::Lines);
-	window->draw(greenLine, 2, sf::Lines);
+	addLine(redLine[0].position, redLine[1].position, sf::Color::Red);
+	addLine(greenLine[0].position, greenLine[1].position, sf::Color::Green);
 }
 
 void PhysicsDebugDraw::DrawPoint(const b2Vec2 & p, float32 size, const b2Color & color) {
@@ -146,3 +114,40 @@ void PhysicsDebugDraw::DrawPoint(const b2Vec2 & p, float32 size, const b2Color &
 
   // Draw point (not implemented yet)
 }
+
+// Record a line
+void PhysicsDebugDraw::addLine(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Color& color) {
+  lines->append(sf::Vertex(a, color));
+  lines->append(sf::Vertex(b, color));
+}
+
+// Record a polygon's outline, and fill it if a fill colour is given
+void PhysicsDebugDraw::addPolygon(const sf::Vector2f* points, int count, const sf::Color& outline, const sf::Color& fill) {
+
+  // Fill as a fan of triangles around the first point
+  if (fill != sf::Color::Transparent) {
+    for (int i = 1; i + 1 < count; ++i) {
+      triangles->append(sf::Vertex(points[0], fill));
+      triangles->append(sf::Vertex(points[i], fill));
+      triangles->append(sf::Vertex(points[i + 1], fill));
+    }
+  }
+
+  // Outline every edge
+  for (int i = 0; i < count; ++i) {
+    addLine(points[i], points[(i + 1) % count], outline);
+  }
+}
+
+// Record a circle as a polygon
+void PhysicsDebugDraw::addCircle(const b2Vec2& center, float32 radius, const sf::Color& outline, const sf::Color& fill) {
+  const int segments = 16;
+  const sf::Vector2f middle = PhysicsDebugDraw::B2VecToSFVec(center);
+  const float r = radius * PhysicsSystem::scale;
+  sf::Vector2f points[segments];
+  for (int i = 0; i < segments; ++i) {
+    const float angle = 2.f * b2_pi * i / segments;
+    points[i] = middle + sf::Vector2f(std::cos(angle) * r, std::sin(angle) * r);
+  }
+  addPolygon(points, segments, outline, fill);
+}
@@ -9,9 +9,10 @@
 
 #include "Game.h"
 
-// Debug Event
+// Debug Event, shapes are recorded into the vertex arrays to be drawn later
 struct DebugRenderPhysicsEvent {
-  sf::RenderWindow& window;
+  sf::VertexArray& lines;
+  sf::VertexArray& triangles;
 };
 
 class PhysicsDebugDraw : public b2Draw {
@@ -19,8 +20,9 @@ class PhysicsDebugDraw : public b2Draw {
 		PhysicsDebugDraw()
 			: b2Draw() {}
 
-    // Window to draw from
-    sf::RenderWindow* window;
+    // Where to record outlines and filled shapes
+    sf::VertexArray* lines;
+    sf::VertexArray* triangles;
 
     // Scale
     static float scale;
@@ -37,6 +39,17 @@ class PhysicsDebugDraw : public b2Draw {
     void DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color) override;
     void DrawTransform(const b2Transform& xf) override;
 		void DrawPoint(const b2Vec2& p, float32 size, const b2Color& color);
+
+  private:
+
+    // Record a line
+    void addLine(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Color& color);
+
+    // Record a polygon's outline, and fill it if a fill colour is given
+    void addPolygon(const sf::Vector2f* points, int count, const sf::Color& outline, const sf::Color& fill);
+
+    // Record a circle as a polygon
+    void addCircle(const b2Vec2& center, float32 radius, const sf::Color& outline, const sf::Color& fill);
 };
 
 #endif
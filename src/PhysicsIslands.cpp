@@ -0,0 +1,133 @@
+// PhysicsIslands.cpp
+// Finds groups of bodies that the physics solver has to solve together
+
+#include "PhysicsIslands.h"
+
+#include <algorithm>
+
+// Island index used for bodies that haven't been placed yet
+static const uint32_t NoIsland = (uint32_t)-1;
+
+// Constructor
+PhysicsIslands::PhysicsIslands() {
+}
+
+// Find every island in a world, replacing the last ones found
+void
+PhysicsIslands::build(b2World& world) {
+  bodies_.clear();
+  starts_.clear();
+  parents_.clear();
+  candidates_.clear();
+  indices_.clear();
+
+  // Every body the solver could move starts in an island of its own
+  for (b2Body* body = world.GetBodyList(); body != nullptr; body = body->GetNext()) {
+    if (body->GetType() == b2_staticBody || !body->IsActive()) { continue; }
+    const uint32_t index = candidates_.size();
+    indices_[body] = index;
+    candidates_.push_back(body);
+    parents_.push_back(index);
+  }
+
+  // Join bodies that are touching, sensors don't push anything so they're ignored
+  for (b2Contact* contact = world.GetContactList(); contact != nullptr; contact = contact->GetNext()) {
+    if (!contact->IsEnabled() || !contact->IsTouching()) { continue; }
+    const b2Fixture* a = contact->GetFixtureA();
+    const b2Fixture* b = contact->GetFixtureB();
+    if (a->IsSensor() || b->IsSensor()) { continue; }
+    join(a->GetBody(), b->GetBody());
+  }
+
+  // Join bodies held together
+  for (b2Joint* joint = world.GetJointList(); joint != nullptr; joint = joint->GetNext()) {
+    join(joint->GetBodyA(), joint->GetBodyB());
+  }
+
+  // Count the bodies in each island, islands that are completely asleep aren't solved
+  const std::size_t count = candidates_.size();
+  std::vector<uint32_t> sizes(count, 0);
+  std::vector<bool> awake(count, false);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t root = findRoot(i);
+    ++sizes[root];
+    if (candidates_[i]->IsAwake()) { awake[root] = true; }
+  }
+
+  // List the islands in the order their first body appears, then biggest first
+  // Every body points straight at its root after counting
+  std::vector<uint32_t> roots;
+  std::vector<uint32_t> islandOf(count, NoIsland);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t root = parents_[i];
+    if (awake[root] && islandOf[root] == NoIsland) {
+      islandOf[root] = roots.size();
+      roots.push_back(root);
+    }
+  }
+  std::stable_sort(roots.begin(), roots.end(), [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+
+  // Work out where each island starts
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < roots.size(); ++i) {
+    islandOf[roots[i]] = i;
+    starts_.push_back(total);
+    total += sizes[roots[i]];
+  }
+  starts_.push_back(total);
+
+  // Place each body in its island, keeping the order Box2D lists them in
+  bodies_.resize(total);
+  std::vector<std::size_t> next(starts_.begin(), starts_.end() - 1);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t root = parents_[i];
+    if (!awake[root]) { continue; }
+    bodies_[next[islandOf[root]]++] = candidates_[i];
+  }
+}
+
+// Get how many islands there are
+std::size_t
+PhysicsIslands::getCount() const {
+  return starts_.empty() ? 0 : starts_.size() - 1;
+}
+
+// Get how many bodies are in the biggest island
+std::size_t
+PhysicsIslands::getLargest() const {
+  return starts_.size() < 2 ? 0 : starts_[1] - starts_[0];
+}
+
+// Get how many bodies are in islands
+std::size_t
+PhysicsIslands::getBodyCount() const {
+  return bodies_.size();
+}
+
+// Find which body represents an island, flattening the path as we go
+uint32_t
+PhysicsIslands::findRoot(uint32_t index) {
+  uint32_t root = index;
+  while (parents_[root] != root) { root = parents_[root]; }
+  while (parents_[index] != root) {
+    const uint32_t parent = parents_[index];
+    parents_[index] = root;
+    index = parent;
+  }
+  return root;
+}
+
+// Put two bodies in the same island
+// Static bodies aren't in the list, so nothing is joined through them
+void
+PhysicsIslands::join(const b2Body* a, const b2Body* b) {
+  const auto itA = indices_.find(a);
+  const auto itB = indices_.find(b);
+  if (itA == indices_.end() || itB == indices_.end()) { return; }
+
+  // Always keep the earliest body as the root, so the same world always gives the same islands
+  const uint32_t rootA = findRoot(itA->second);
+  const uint32_t rootB = findRoot(itB->second);
+  if (rootA < rootB) { parents_[rootB] = rootA; }
+  else if (rootB < rootA) { parents_[rootA] = rootB; }
+}
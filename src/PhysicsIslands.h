@@ -0,0 +1,54 @@
+// PhysicsIslands.h
+// Finds groups of bodies that the physics solver has to solve together
+
+#ifndef PHYSICSISLANDS_H
+#define PHYSICSISLANDS_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <Box2D/Box2D.h>
+
+// Splits the awake bodies of a world into islands, the same way Box2D does when it steps
+// Bodies are joined by touching contacts and joints, but never through static bodies
+// The number and size of the islands show how much work each step's solve is
+class PhysicsIslands {
+  public:
+
+    // Constructor
+    PhysicsIslands();
+
+    // Find every island in a world, replacing the last ones found
+    void build(b2World& world);
+
+    // Get how many islands there are
+    std::size_t getCount() const;
+
+    // Get how many bodies are in the biggest island
+    std::size_t getLargest() const;
+
+    // Get how many bodies are in islands
+    std::size_t getBodyCount() const;
+
+  private:
+
+    // Every body in an island, grouped by island
+    std::vector<b2Body*> bodies_;
+
+    // Where each island starts in bodies_, with the end of the last one at the back
+    std::vector<std::size_t> starts_;
+
+    // Scratch space for joining bodies together
+    std::vector<uint32_t> parents_;
+    std::vector<b2Body*> candidates_;
+    std::unordered_map<const b2Body*, uint32_t> indices_;
+
+    // Find which body represents an island, flattening the path as we go
+    uint32_t findRoot(uint32_t index);
+
+    // Put two bodies in the same island
+    void join(const b2Body* a, const b2Body* b);
+};
+
+#endif
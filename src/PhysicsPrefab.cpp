@@ -0,0 +1,143 @@
+// PhysicsPrefab.cpp
+// Resource describing a physics body and its fixtures, ready to be spawned
+
+#include "PhysicsPrefab.h"
+
+// Avoid cyclic dependancies
+#include "ResourceManager.h"
+
+// Allow the PhysicsPrefab type to be made in Lua
+// BodyDef, FixtureDef and the shape functions are registered by RigidBody
+void
+PhysicsPrefab::registerPhysicsPrefabType() {
+  Game::lua.new_usertype<PhysicsPrefab>("PhysicsPrefab",
+    sol::constructors<PhysicsPrefab()>(),
+    "setBody", &PhysicsPrefab::setBody,
+    "addFixture", &PhysicsPrefab::addFixture,
+    "makeGroundSensor", &PhysicsPrefab::makeGroundSensor,
+    "hasGroundSensor", sol::property(&PhysicsPrefab::hasGroundSensor)
+  );
+}
+
+// Get a prefab from the resource manager
+const PhysicsPrefab*
+PhysicsPrefab::getFromResources(const std::string& name) {
+
+  // Attempts to get the resource
+  Resource& resource = ResourceManager::getResource(name);
+  if (resource.getType() != Resource::Type::PHYSICS) {
+    Console::log("[Error] Could not get physics prefab: %s\nNonexistant or incorrect resource type.", name.c_str());
+    return nullptr;
+  }
+
+  // Get prefab from resource
+  const PhysicsPrefab* prefab = (PhysicsPrefab*)resource.get();
+  if (prefab == nullptr) {
+    Console::log("[Error] Could not get physics prefab: %s\nResource is NULL..", name.c_str());
+  }
+  return prefab;
+}
+
+// Constructor
+PhysicsPrefab::PhysicsPrefab()
+  : groundSensor_(false) {}
+
+// Set how the body is made
+void
+PhysicsPrefab::setBody(const b2BodyDef& def) {
+  body_ = def;
+}
+
+// Add a fixture, copying the shape
+void
+PhysicsPrefab::addFixture(const b2FixtureDef& def) {
+
+  // Copy the shape, which the definition only points to
+  std::shared_ptr<b2Shape> shape;
+  if (def.shape != nullptr) {
+    switch (def.shape->GetType()) {
+      case b2Shape::e_circle:
+        shape = std::make_shared<b2CircleShape>(*static_cast<const b2CircleShape*>(def.shape)); break;
+      case b2Shape::e_edge:
+        shape = std::make_shared<b2EdgeShape>(*static_cast<const b2EdgeShape*>(def.shape)); break;
+      case b2Shape::e_polygon:
+        shape = std::make_shared<b2PolygonShape>(*static_cast<const b2PolygonShape*>(def.shape)); break;
+      default:
+        break;
+    }
+  }
+  if (shape == nullptr) {
+    Console::log("[Error] Could not add fixture to physics prefab: it needs a box, circle or line shape.");
+    return;
+  }
+
+  // Keep the definition pointing at our copy
+  fixtures_.push_back(def);
+  fixtures_.back().shape = shape.get();
+  shapes_.push_back(shape);
+}
+
+// Give spawned bodies a sensor for detecting the ground
+void
+PhysicsPrefab::makeGroundSensor() {
+  groundSensor_ = true;
+}
+
+// Check if spawned bodies get a ground sensor
+bool
+PhysicsPrefab::hasGroundSensor() const {
+  return groundSensor_;
+}
+
+// Create a body with every fixture
+// The ground sensor is left to the RigidBody, as it marks the fixture as its own
+b2Body*
+PhysicsPrefab::createBody(b2World& world, float scale) const {
+  b2Body* body = world.CreateBody(&body_);
+  for (const auto& def : fixtures_) {
+
+    // Use the shape as it is if it's not being scaled
+    if (scale == 1.f) {
+      body->CreateFixture(&def);
+      continue;
+    }
+
+    // Otherwise scale a copy, Box2D copies it again when making the fixture
+    b2FixtureDef scaled = def;
+    switch (def.shape->GetType()) {
+      case b2Shape::e_circle: {
+        b2CircleShape circle = *static_cast<const b2CircleShape*>(def.shape);
+        circle.m_p *= scale;
+        circle.m_radius *= scale;
+        scaled.shape = &circle;
+        body->CreateFixture(&scaled);
+        break;
+      }
+      case b2Shape::e_edge: {
+        b2EdgeShape edge = *static_cast<const b2EdgeShape*>(def.shape);
+        edge.m_vertex0 *= scale;
+        edge.m_vertex1 *= scale;
+        edge.m_vertex2 *= scale;
+        edge.m_vertex3 *= scale;
+        scaled.shape = &edge;
+        body->CreateFixture(&scaled);
+        break;
+      }
+      case b2Shape::e_polygon: {
+        const b2PolygonShape& original = *static_cast<const b2PolygonShape*>(def.shape);
+        b2Vec2 vertices[b2_maxPolygonVertices];
+        for (int32 i = 0; i < original.m_count; ++i) {
+          vertices[i] = scale * original.m_vertices[i];
+        }
+        b2PolygonShape polygon;
+        polygon.Set(vertices, original.m_count);
+        scaled.shape = &polygon;
+        body->CreateFixture(&scaled);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return body;
+}
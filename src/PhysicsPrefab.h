@@ -0,0 +1,56 @@
+// PhysicsPrefab.h
+// Resource describing a physics body and its fixtures, ready to be spawned
+
+#ifndef PHYSICSPREFAB_H
+#define PHYSICSPREFAB_H
+
+#include <memory>
+#include <vector>
+
+#include <Box2D/Box2D.h>
+
+#include "Game.h"
+#include "Scripting.h"
+
+// A body definition with all of its fixtures, built once when loaded
+// Spawning from a prefab creates the b2Body with everything attached in one go
+class PhysicsPrefab {
+  public:
+
+    // Allow the PhysicsPrefab type to be made in Lua
+    static void registerPhysicsPrefabType();
+
+    // Get a prefab from the resource manager, or nullptr if there isn't one
+    static const PhysicsPrefab* getFromResources(const std::string& name);
+
+    // Constructor
+    PhysicsPrefab();
+
+    // Set how the body is made
+    void setBody(const b2BodyDef& def);
+
+    // Add a fixture, the shape is copied so the definition can be thrown away
+    void addFixture(const b2FixtureDef& def);
+
+    // Give spawned bodies a sensor for detecting the ground
+    void makeGroundSensor();
+    bool hasGroundSensor() const;
+
+    // Create a body with every fixture, with shapes scaled around the body's origin
+    b2Body* createBody(b2World& world, float scale = 1.f) const;
+
+  private:
+
+    // How the body is made
+    b2BodyDef body_;
+
+    // Every fixture, with the shapes they point to
+    // Shapes are shared as prefabs are copied when loaded, and never changed afterwards
+    std::vector<b2FixtureDef> fixtures_;
+    std::vector<std::shared_ptr<b2Shape>> shapes_;
+
+    // Whether spawned bodies get a ground sensor
+    bool groundSensor_;
+};
+
+#endif
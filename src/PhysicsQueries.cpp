@@ -0,0 +1,217 @@
+// PhysicsQueries.cpp
+// Answers spatial questions about a physics world, such as what a ray hits
+
+#include "PhysicsQueries.h"
+
+#include <algorithm>
+
+// Avoid cyclic dependancies
+#include "PhysicsSystem.h"
+
+// Get the RigidBody a fixture belongs to, if it should be reported at all
+static const RigidBody*
+getReportable(const b2Fixture* fixture) {
+  if (fixture->IsSensor()) { return nullptr; }
+  return static_cast<const RigidBody*>(fixture->GetBody()->GetUserData());
+}
+
+// Keeps the closest fixture a ray hits
+class ClosestRaycast : public b2RayCastCallback {
+  public:
+
+    // The closest reportable fixture so far
+    const RigidBody* rigidBody = nullptr;
+    b2Vec2 point;
+    b2Vec2 normal;
+    float fraction = 1.f;
+
+    // Called by Box2D for each fixture the ray hits, in any order
+    // Returning the fraction clips the ray so only closer fixtures are reported, -1 ignores the fixture
+    float32 ReportFixture(b2Fixture* fixture, const b2Vec2& p, const b2Vec2& n, float32 f) override {
+      const RigidBody* r = getReportable(fixture);
+      if (r == nullptr) { return -1.f; }
+      rigidBody = r;
+      point = p;
+      normal = n;
+      fraction = f;
+      return f;
+    }
+};
+
+// Collects every fixture near an area
+class FixtureCollector : public b2QueryCallback {
+  public:
+
+    // Constructor
+    FixtureCollector(std::vector<b2Fixture*>& fixtures)
+      : fixtures_(fixtures) {}
+
+    // Called by Box2D for each fixture whose bounds overlap the area, keep looking afterwards
+    bool ReportFixture(b2Fixture* fixture) override {
+      if (getReportable(fixture) != nullptr) { fixtures_.push_back(fixture); }
+      return true;
+    }
+
+  private:
+
+    // Where to collect fixtures
+    std::vector<b2Fixture*>& fixtures_;
+};
+
+// Constructor
+PhysicsQueries::PhysicsQueries(const b2World& world)
+  : world_(world) {
+}
+
+// Find the closest thing a ray hits
+bool
+PhysicsQueries::raycast(const sf::Vector2f& from, const sf::Vector2f& to, RaycastHit& hit) const {
+  hit.hit = false;
+
+  // Box2D can't cast a ray of no length
+  const b2Vec2 start = PhysicsSystem::convertToB2(from);
+  const b2Vec2 end = PhysicsSystem::convertToB2(to);
+  if ((end - start).LengthSquared() <= 0.f) { return false; }
+
+  ClosestRaycast callback;
+  world_.RayCast(&callback, start, end);
+  if (callback.rigidBody == nullptr) { return false; }
+
+  hit.hit = true;
+  hit.entity = callback.rigidBody->getEntity();
+  hit.point = PhysicsSystem::convertToSF(callback.point);
+  hit.normal = sf::Vector2f(callback.normal.x, callback.normal.y);
+  hit.fraction = callback.fraction;
+  return true;
+}
+
+// Cast many rays at once, given as start and end points one after another
+std::vector<RaycastHit>&
+PhysicsQueries::raycastBatch(const std::vector<sf::Vector2f>& rays) {
+  hits_.resize(rays.size() / 2);
+  for (std::size_t i = 0; i < hits_.size(); ++i) {
+    raycast(rays[i * 2], rays[i * 2 + 1], hits_[i]);
+  }
+  return hits_;
+}
+
+// Find every entity with a body overlapping an area
+std::vector<ECS::EntityHandle>&
+PhysicsQueries::queryArea(const sf::FloatRect& area) {
+  entities_.clear();
+  b2AABB bounds;
+  bounds.lowerBound = PhysicsSystem::convertToB2(sf::Vector2f(area.left, area.top));
+  bounds.upperBound = PhysicsSystem::convertToB2(sf::Vector2f(area.left + area.width, area.top + area.height));
+  findFixtures(bounds);
+
+  // Box2D reports fixtures whose padded bounds overlap, so check their actual bounds
+  for (const b2Fixture* fixture : fixtures_) {
+    const int32 children = fixture->GetShape()->GetChildCount();
+    for (int32 child = 0; child < children; ++child) {
+      if (b2TestOverlap(fixture->GetAABB(child), bounds)) {
+        entities_.push_back(getReportable(fixture)->getEntity());
+        break;
+      }
+    }
+  }
+
+  // Bodies may have several fixtures in the area, so list each entity once
+  // Sorting by handle keeps the order the same between runs
+  std::sort(entities_.begin(), entities_.end(), [](const ECS::EntityHandle& a, const ECS::EntityHandle& b) {
+    return a.getId() < b.getId();
+  });
+  entities_.erase(std::unique(entities_.begin(), entities_.end()), entities_.end());
+  return entities_;
+}
+
+// Find the first thing a shape hits when moved from one place to another
+bool
+PhysicsQueries::shapeCast(const b2Shape& shape, const sf::Vector2f& from, const sf::Vector2f& to, RaycastHit& hit) {
+  hit.hit = false;
+  const b2Vec2 start = PhysicsSystem::convertToB2(from);
+  const b2Vec2 end = PhysicsSystem::convertToB2(to);
+
+  // Find everything near the path of the shape
+  b2Transform startTransform(start, b2Rot(0.f));
+  b2Transform endTransform(end, b2Rot(0.f));
+  b2AABB startBounds;
+  b2AABB endBounds;
+  shape.ComputeAABB(&startBounds, startTransform, 0);
+  shape.ComputeAABB(&endBounds, endTransform, 0);
+  b2AABB path;
+  path.Combine(startBounds, endBounds);
+  findFixtures(path);
+
+  // The shape moves along the path without rotating
+  b2Sweep sweep;
+  sweep.localCenter.SetZero();
+  sweep.c0 = start;
+  sweep.c = end;
+  sweep.a0 = 0.f;
+  sweep.a = 0.f;
+  sweep.alpha0 = 0.f;
+
+  // Find how far the shape gets before touching each fixture, keeping the closest
+  const b2Fixture* closest = nullptr;
+  int32 closestChild = 0;
+  float closestTime = 1.f;
+  b2TOIInput input;
+  input.proxyA.Set(&shape, 0);
+  input.sweepA = sweep;
+  input.tMax = 1.f;
+  for (const b2Fixture* fixture : fixtures_) {
+    const b2Body* body = fixture->GetBody();
+    input.sweepB.localCenter.SetZero();
+    input.sweepB.c0 = input.sweepB.c = body->GetPosition();
+    input.sweepB.a0 = input.sweepB.a = body->GetAngle();
+    input.sweepB.alpha0 = 0.f;
+
+    const int32 children = fixture->GetShape()->GetChildCount();
+    for (int32 child = 0; child < children; ++child) {
+      input.proxyB.Set(fixture->GetShape(), child);
+      b2TOIOutput output;
+      b2TimeOfImpact(&output, &input);
+      const bool touched = output.state == b2TOIOutput::e_touching || output.state == b2TOIOutput::e_overlapped;
+      if (touched && (closest == nullptr || output.t < closestTime)) {
+        closest = fixture;
+        closestChild = child;
+        closestTime = output.state == b2TOIOutput::e_overlapped ? 0.f : output.t;
+      }
+    }
+  }
+  if (closest == nullptr) { return false; }
+
+  // Find the closest points between the shape where it stopped and what it hit
+  b2DistanceInput distanceInput;
+  distanceInput.proxyA.Set(&shape, 0);
+  distanceInput.proxyB.Set(closest->GetShape(), closestChild);
+  sweep.GetTransform(&distanceInput.transformA, closestTime);
+  distanceInput.transformB = closest->GetBody()->GetTransform();
+  distanceInput.useRadii = true;
+  b2SimplexCache cache;
+  cache.count = 0;
+  b2DistanceOutput distanceOutput;
+  b2Distance(&distanceOutput, &cache, &distanceInput);
+
+  // The normal points from what was hit towards the shape, or back along the path if they already overlap
+  b2Vec2 normal = distanceOutput.pointA - distanceOutput.pointB;
+  if (normal.Normalize() < b2_epsilon) {
+    normal = start - end;
+    normal.Normalize();
+  }
+
+  hit.hit = true;
+  hit.entity = static_cast<const RigidBody*>(closest->GetBody()->GetUserData())->getEntity();
+  hit.point = PhysicsSystem::convertToSF(distanceOutput.pointB);
+  hit.normal = sf::Vector2f(normal.x, normal.y);
+  hit.fraction = closestTime;
+  return true;
+}
+
+// Collect every fixture whose bounds overlap an area
+void
+PhysicsQueries::findFixtures(const b2AABB& area) {
+  fixtures_.clear();
+  FixtureCollector collector(fixtures_);
+  world_.QueryAABB(&collector, area);
+}
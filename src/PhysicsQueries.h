@@ -0,0 +1,73 @@
+// PhysicsQueries.h
+// Answers spatial questions about a physics world, such as what a ray hits
+
+#ifndef PHYSICSQUERIES_H
+#define PHYSICSQUERIES_H
+
+#include <vector>
+
+#include <Box2D/Box2D.h>
+#include <SFML/Graphics/Rect.hpp>
+
+#include "Profiler.h"
+#include "ECS.h"
+
+// Where a ray or shape cast hit something
+struct RaycastHit {
+
+  // Whether anything was hit, the rest is only set if it was
+  bool hit;
+
+  // The entity that was hit
+  ECS::EntityHandle entity;
+
+  // Where it was hit, and the direction of the surface there
+  sf::Vector2f point;
+  sf::Vector2f normal;
+
+  // How far along the cast the hit was, from 0 to 1
+  float fraction;
+};
+
+// Asks a physics world what's where, with everything in pixels
+// Sensors are ignored and only bodies belonging to entities are reported
+// Lists returned are reused, so they're only valid until the same kind of query is asked again
+class PhysicsQueries {
+  public:
+
+    // Constructor
+    PhysicsQueries(const b2World& world);
+
+    // Find the closest thing a ray hits
+    bool raycast(const sf::Vector2f& from, const sf::Vector2f& to, RaycastHit& hit) const;
+
+    // Cast many rays at once, given as start and end points one after another
+    // There's one result per ray, in the same order
+    std::vector<RaycastHit>& raycastBatch(const std::vector<sf::Vector2f>& rays);
+
+    // Find every entity with a body overlapping an area, each entity is listed once
+    std::vector<ECS::EntityHandle>& queryArea(const sf::FloatRect& area);
+
+    // Find the first thing a shape hits when moved from one place to another without rotating
+    // Bodies are treated as still, so this is for asking where something would stop rather than simulating it
+    bool shapeCast(const b2Shape& shape, const sf::Vector2f& from, const sf::Vector2f& to, RaycastHit& hit);
+
+  private:
+
+    // The world being asked
+    const b2World& world_;
+
+    // Results of the last batch of rays
+    std::vector<RaycastHit> hits_;
+
+    // Results of the last area query
+    std::vector<ECS::EntityHandle> entities_;
+
+    // Fixtures near the last shape cast
+    std::vector<b2Fixture*> fixtures_;
+
+    // Collect every fixture whose bounds overlap an area, in Box2D units
+    void findFixtures(const b2AABB& area);
+};
+
+#endif
@@ -2,6 +2,10 @@
 // System to simulate physics in game
 
 #include "PhysicsSystem.h"
+#include "Combat.h"
+
+#include <algorithm>
+#include <cmath>
 
 // Define statics
 const float PhysicsSystem::scale = 100.f;
@@ -22,9 +26,6 @@ PhysicsSystem::registerPhysicsSystem(sol::environment& env, ECS::World* world) {
     auto* newPS = new PhysicsSystem();
     world->registerSystem(newPS);
 
-    // Get the new physics world
-    b2World* physicsWorld = newPS->getWorld();
-
     // Allow the system's manipulation through lua
     env.set("Physics", newPS);
     env.new_usertype<PhysicsSystem>("PhysicsSystem",
@@ -34,9 +35,79 @@ PhysicsSystem::registerPhysicsSystem(sol::environment& env, ECS::World* world) {
       "setGravityMult", &PhysicsSystem::setGravityMult,
       "bodyCount", sol::property(
         [](const PhysicsSystem& self) { return self.world_.GetBodyCount(); }),
+      "async", sol::property(
+        &PhysicsSystem::isAsync,
+        &PhysicsSystem::setAsync),
+      "islandCount", sol::property(
+        [](PhysicsSystem& self) { return self.getIslands().getCount(); }),
+      "largestIsland", sol::property(
+        [](PhysicsSystem& self) { return self.getIslands().getLargest(); }),
       "showHitboxes", sol::property(
         [](const PhysicsSystem& self) { return self.showRigidBodies_; },
-        [](bool enable) { PhysicsSystem::showRigidBodies_ = enable; })
+        [](bool enable) { PhysicsSystem::showRigidBodies_ = enable; }),
+      "onContact", &PhysicsSystem::onContact_,
+      "stats", sol::property(&PhysicsSystem::getStats),
+      "resetStats", &PhysicsSystem::resetStats,
+      "velocityIterations", sol::property(
+        &PhysicsSystem::getVelocityIterations,
+        &PhysicsSystem::setVelocityIterations),
+      "positionIterations", sol::property(
+        &PhysicsSystem::getPositionIterations,
+        &PhysicsSystem::setPositionIterations),
+      "raycast", [](PhysicsSystem& self, const sf::Vector2f& from, const sf::Vector2f& to) {
+        RaycastHit hit;
+        return self.getQueries().raycast(from, to, hit) ? sol::optional<RaycastHit>(hit) : sol::nullopt; },
+      "raycastBatch", [](PhysicsSystem& self, const sol::table& rays) {
+        self.scriptRays_.clear();
+        for (std::size_t i = 1; i <= rays.size(); ++i) { self.scriptRays_.push_back(rays.get<sf::Vector2f>(i)); }
+        return &self.getQueries().raycastBatch(self.scriptRays_); },
+      "queryArea", [](PhysicsSystem& self, const sf::FloatRect& area) {
+        return &self.getQueries().queryArea(area); },
+      "shapeCast", sol::overload(
+        [](PhysicsSystem& self, const b2PolygonShape& shape, const sf::Vector2f& from, const sf::Vector2f& to) {
+          RaycastHit hit;
+          return self.getQueries().shapeCast(shape, from, to, hit) ? sol::optional<RaycastHit>(hit) : sol::nullopt; },
+        [](PhysicsSystem& self, const b2CircleShape& shape, const sf::Vector2f& from, const sf::Vector2f& to) {
+          RaycastHit hit;
+          return self.getQueries().shapeCast(shape, from, to, hit) ? sol::optional<RaycastHit>(hit) : sol::nullopt; })
+    );
+
+    // What's in the world and how long steps take, times are in milliseconds
+    env.new_usertype<PhysicsStats>("PhysicsStats",
+      "steps", sol::readonly(&PhysicsStats::steps),
+      "bodies", sol::readonly(&PhysicsStats::bodies),
+      "awakeBodies", sol::readonly(&PhysicsStats::awakeBodies),
+      "contacts", sol::readonly(&PhysicsStats::contacts),
+      "proxies", sol::readonly(&PhysicsStats::proxies),
+      "islands", sol::readonly(&PhysicsStats::islands),
+      "largestIsland", sol::readonly(&PhysicsStats::largestIsland),
+      "stepTime", sol::readonly(&PhysicsStats::stepTime),
+      "collideTime", sol::readonly(&PhysicsStats::collideTime),
+      "broadphaseTime", sol::readonly(&PhysicsStats::broadphaseTime),
+      "solveTime", sol::readonly(&PhysicsStats::solveTime),
+      "solveTOITime", sol::readonly(&PhysicsStats::solveTOITime),
+      "averageStepTime", sol::readonly(&PhysicsStats::averageStepTime),
+      "slowestStepTime", sol::readonly(&PhysicsStats::slowestStepTime)
+    );
+
+    // Results of raycasts and shape casts
+    // Lists from raycastBatch and queryArea are reused by the next query, so copy anything to keep
+    env.new_usertype<RaycastHit>("RaycastHit",
+      "hit", &RaycastHit::hit,
+      "entity", &RaycastHit::entity,
+      "point", &RaycastHit::point,
+      "normal", &RaycastHit::normal,
+      "fraction", &RaycastHit::fraction
+    );
+
+    // Contacts are handed to Physics.onContact together after each step
+    env.new_usertype<ContactEvent>("ContactEvent",
+      "began", &ContactEvent::began,
+      "entityA", &ContactEvent::entityA,
+      "entityB", &ContactEvent::entityB,
+      "fixtureA", &ContactEvent::fixtureA,
+      "fixtureB", &ContactEvent::fixtureB,
+      "impact", &ContactEvent::impact
     );
 
     // Add global commands to auto complete
@@ -44,10 +115,22 @@ PhysicsSystem::registerPhysicsSystem(sol::environment& env, ECS::World* world) {
     Console::addCommand("Physics.gravity");
     Console::addCommand("Physics:setGravityMult");
     Console::addCommand("Physics.bodyCount");
+    Console::addCommand("Physics.async");
+    Console::addCommand("Physics.islandCount");
+    Console::addCommand("Physics.largestIsland");
     Console::addCommand("Physics.showHitboxes");
+    Console::addCommand("Physics.onContact");
+    Console::addCommand("Physics.stats");
+    Console::addCommand("Physics:resetStats");
+    Console::addCommand("Physics.velocityIterations");
+    Console::addCommand("Physics.positionIterations");
+    Console::addCommand("Physics:raycast");
+    Console::addCommand("Physics:raycastBatch");
+    Console::addCommand("Physics:queryArea");
+    Console::addCommand("Physics:shapeCast");
 
     // Allow the use of RigidBodies
-    RigidBody::registerRigidBodyType(env, physicsWorld);
+    RigidBody::registerRigidBodyType(env, newPS);
   });
 }
 
@@ -55,7 +138,22 @@ PhysicsSystem::registerPhysicsSystem(sol::environment& env, ECS::World* world) {
 PhysicsSystem::PhysicsSystem() 
   : defaultGravity_(sf::Vector2f(0.f, 1000.f))
   , world_(convertToB2(defaultGravity_))
-  , timeStepAccumilator_(0.0f) {
+  , queries_(world_)
+  , islandsDirty_(true)
+  , async_(false)
+  , pendingStep_(0.f)
+  , hasStepResults_(false)
+  , backgroundStep_(0.f)
+  , stopStepThread_(false)
+  , quality_(1.f)
+  , lastProfile_()
+  , profiledSteps_(0)
+  , totalStepTime_(0.f)
+  , slowestStepTime_(0.f) {
+
+  // Declare component access, contacts can create entities so this runs exclusively
+  setName("PhysicsSystem");
+  writes<Transform, RigidBody, Combat>();
 
   // Set up our contact listener
   world_.SetContactListener(&contactListener_);
@@ -67,128 +165,430 @@ PhysicsSystem::PhysicsSystem()
 
 // Clean up the world
 PhysicsSystem::~PhysicsSystem() {
-  //@TODO: Figure out if we need to do something here?
+
+  // Stop stepping in the background before the world goes
+  if (stepThread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(stepMutex_);
+      stopStepThread_ = true;
+    }
+    stepChanged_.notify_all();
+    stepThread_.join();
+  }
 }
 
-// Handle the physics independant to game FPS
+// Handle the physics, the scene calls this at a fixed rate
 void 
 PhysicsSystem::update(ECS::World* world, const sf::Time& dt) {
 
-  // Accumilate time and calculate steps
-  timeStepAccumilator_ += dt.asSeconds();
-  const auto steps = static_cast<int>(
-    std::floor(timeStepAccumilator_ / fixedTimeStep_));
+  // Finish the last step if it was run in the background
+  // If it never got started, such as when several steps are taken in one frame, run it now
+  finishBackgroundStep();
+  if (pendingStep_ > 0.f) {
+    singleStep(pendingStep_);
+    pendingStep_ = 0.f;
+  }
+
+  // Catch up on the last step's movement
+  if (hasStepResults_) {
+    syncTransforms(world);
+    hasStepResults_ = false;
+  }
+
+  // Handle contacts from the last step, and from any bodies destroyed since
+  dispatchContacts(world);
+
+  // Move, destroy and wake bodies as asked since the last step
+  prepareBodies(world);
+
+  // Leave the step until the rest of the frame has updated, so it can run in the background
+  if (async_) {
+    pendingStep_ = dt.asSeconds();
+    hasStepResults_ = true;
+  }
+
+  // Or simulate now
+  else {
+    singleStep(dt.asSeconds());
+    syncTransforms(world);
+    dispatchContacts(world);
+  }
+}
+
+// Single-step the physics
+void
+PhysicsSystem::singleStep(float timeStep) {
+  PROFILE_SCOPE("b2World::Step");
+  const int32 velocityIterations = std::max(1, (int32)std::ceil(velocityIterations_ * quality_));
+  const int32 positionIterations = std::max(1, (int32)std::ceil(positionIterations_ * quality_));
+  world_.Step(timeStep, velocityIterations, positionIterations);
+  world_.ClearForces();
+  islandsDirty_ = true;
+
+  // Keep the step's timings, this may be on the background thread but nothing reads them until it's finished
+  lastProfile_ = world_.GetProfile();
+  ++profiledSteps_;
+  totalStepTime_ += lastProfile_.step;
+  slowestStepTime_ = std::max(slowestStepTime_, lastProfile_.step);
+}
 
-  // Calculate if we should simulate
-  if (steps > 0) {
-    timeStepAccumilator_ -= steps * fixedTimeStep_;
+// Move transforms to where their bodies are
+// Only active bodies are visited, so the cost grows with what's moving rather than with everything in the world
+void
+PhysicsSystem::syncTransforms(ECS::World* world) {
+
+  // Precalculate conversion to degrees
+  constexpr float convertToDegrees = 180.f / M_PI;
+
+  // The step wakes anything an active body touched or is joined to, so follow them to find what it woke
+  // Contacts that stopped touching during the step are still listed while their bodies are close, so they're followed too
+  for (std::size_t i = 0; i < activeBodies_.size(); ++i) {
+    ECS::Entity* const e = world->get(activeBodies_[i]);
+    if (e == nullptr || !e->has<RigidBody>()) { continue; }
+    const b2Body* const body = e->get<RigidBody>()->body_;
+    if (body == nullptr) { continue; }
+    auto follow = [&](b2Body* other) {
+      RigidBody* const r = static_cast<RigidBody*>(other->GetUserData());
+      if (r != nullptr && !r->isActive_ && other->IsAwake()) { activate(r->getEntity(), *r); }
+    };
+    for (const b2ContactEdge* edge = body->GetContactList(); edge != nullptr; edge = edge->next) { follow(edge->other); }
+    for (const b2JointEdge* edge = body->GetJointList(); edge != nullptr; edge = edge->next) { follow(edge->other); }
   }
-  fixedTimeStepRatio_ = timeStepAccumilator_ / fixedTimeStep_;
-  const int stepsClamped = std::min(steps, maxSteps_);
 
-  // Give rigidbodies access to their entities
-  // Also check if any b2Body's are out of sync
-  world->each<Transform, RigidBody>([&](ECS::Entity* e, ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<RigidBody> r) {
+  // Move each active transform, dropping bodies once they've fallen asleep or gone
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < activeBodies_.size(); ++i) {
+    const ECS::EntityHandle handle = activeBodies_[i];
+    ECS::Entity* const e = world->get(handle);
+    if (e == nullptr || !e->has<RigidBody>()) { continue; }
+
+    // Skip entries left behind by a RigidBody that was replaced
+    auto r = e->get<RigidBody>();
+    if (!r->isActive_) { continue; }
+    b2Body* const body = r->body_;
+    if (body == nullptr || body->GetType() == b2_staticBody) {
+      r->isActive_ = false;
+      continue;
+    }
+
+    // Move the transform
+    if (e->has<Transform>()) {
+      auto t = e->get<Transform>();
+      t->position = convertToSF(body->GetPosition());
+      t->rotation = convertToDegrees * body->GetAngle();
+    }
 
-    // Precalculate conversion to radians
-    constexpr float convertToRadians = M_PI / 180.f;
+    // Keep bodies that are still awake, sleeping bodies have been moved for the last time
+    if (body->IsAwake()) { activeBodies_[kept++] = handle; }
+    else { r->isActive_ = false; }
+  }
+  activeBodies_.resize(kept);
+}
 
-    // Check for out of sync
+// Prepare bodies for the next step, moving, destroying and waking them as asked since the last one
+void
+PhysicsSystem::prepareBodies(ECS::World* world) {
+
+  // Precalculate conversion to radians
+  constexpr float convertToRadians = M_PI / 180.f;
+
+  // Move bodies to their transforms
+  // Entities without a transform yet keep the body where it is, and stay queued until they have one
+  std::size_t waiting = 0;
+  for (std::size_t i = 0; i < outOfSyncBodies_.size(); ++i) {
+    const ECS::EntityHandle handle = outOfSyncBodies_[i];
+    ECS::Entity* const e = world->get(handle);
+    if (e == nullptr || !e->has<RigidBody>()) { continue; }
+    auto r = e->get<RigidBody>();
+    if (!r->isOutOfSync_) { continue; }
+    if (!e->has<Transform>()) {
+      outOfSyncBodies_[waiting++] = handle;
+      continue;
+    }
+    auto t = e->get<Transform>();
     b2Body* const body = r->body_;
-    if (r->isOutOfSync_ && body != nullptr) {
-      const b2Vec2 newPos = convertToB2(t->position);
-      const float newRot = convertToRadians * t->rotation;
-      body->SetTransform(newPos, newRot);
+    r->isOutOfSync_ = false;
+    if (body != nullptr) {
+      body->SetTransform(convertToB2(t->position), convertToRadians * t->rotation);
       body->SetAwake(true);
-      r->previousPosition_ = newPos;
-      r->previousAngle_ = newRot;
-      r->isOutOfSync_ = false;
+      activate(handle, *r);
     }
-  });
+  }
+  outOfSyncBodies_.resize(waiting);
+
+  // Destroy any old bodies, which may wake what they were touching
+  for (b2Body* body : disposedBodies_) {
+    destroyBody(body);
+  }
+  disposedBodies_.clear();
+
+  // Activate bodies that may have been woken or moved, even if they're asleep they're synced once more
+  for (const auto& handle : wokenBodies_) {
+    ECS::Entity* const e = world->get(handle);
+    if (e != nullptr && e->has<RigidBody>()) { activate(handle, *e->get<RigidBody>()); }
+  }
+  wokenBodies_.clear();
+}
+
+// Start moving an entity's transform with its body after each step
+void
+PhysicsSystem::activate(const ECS::EntityHandle& handle, RigidBody& rigidBody) {
+  const b2Body* const body = rigidBody.body_;
+  if (rigidBody.isActive_ || body == nullptr || body->GetType() == b2_staticBody) { return; }
+  rigidBody.isActive_ = true;
+  activeBodies_.push_back(handle);
+}
 
-  // Simulate only when we should
-  for (int i = 0; i < stepsClamped; ++i) {
+// Ask for an entity's body to be moved to its transform before the next step
+void
+PhysicsSystem::syncBody(const ECS::EntityHandle& handle) {
+  outOfSyncBodies_.push_back(handle);
+}
 
-    // Reset smoothing states of all entities
-    world->each<Transform, RigidBody>([&](ECS::Entity* e, ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<RigidBody> r) {
-      resetSmoothStates(r);
-    });
+// Ask for a body to be checked before the next step
+void
+PhysicsSystem::wakeBody(const ECS::EntityHandle& handle) {
+  wokenBodies_.push_back(handle);
+}
+void
+PhysicsSystem::wakeBody(b2Body* body) {
+  const RigidBody* const r = body != nullptr ? static_cast<const RigidBody*>(body->GetUserData()) : nullptr;
+  if (r != nullptr) { wokenBodies_.push_back(r->getEntity()); }
+}
 
-    // Simulate
-    singleStep(fixedTimeStep_);
+// Wake anything touching a body that's about to be destroyed
+void
+PhysicsSystem::wakeNeighbours(b2Body* body) {
+  for (const b2ContactEdge* edge = body->GetContactList(); edge != nullptr; edge = edge->next) {
+    if (edge->contact->IsTouching()) { wakeBody(edge->other); }
   }
+  for (const b2JointEdge* edge = body->GetJointList(); edge != nullptr; edge = edge->next) {
+    wakeBody(edge->other);
+  }
+}
 
-  // Reset applied forces
-  world_.ClearForces();
+// Destroy a body before the next step
+// It no longer belongs to a RigidBody, so contacts it ends aren't given an entity
+void
+PhysicsSystem::disposeBody(b2Body* body) {
+  body->SetUserData(nullptr);
+  disposedBodies_.push_back(body);
+}
+
+// Destroy a body straight away
+void
+PhysicsSystem::destroyBody(b2Body* body) {
+  wakeNeighbours(body);
+  world_.DestroyBody(body);
+}
 
-  // Tween in between physics steps and destroy any old bodies
-  world->each<Transform, RigidBody>([&](ECS::Entity* e, ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<RigidBody> r) {
-    smoothState(t, r);
+// Hand every recorded contact to ground sensors, combatants, other systems and then scripts
+void
+PhysicsSystem::dispatchContacts(ECS::World* world) {
+
+  // Take the contacts, anything destroyed while handling them is recorded for next time
+  contactListener_.takeContacts(dispatchedContacts_);
+  if (dispatchedContacts_.empty()) { return; }
+  PROFILE_SCOPE("PhysicsSystem::dispatchContacts");
+
+  // Count what each ground sensor is touching, anything else that hit something takes impact damage
+  auto handleContact = [world](const ECS::EntityHandle& handle, FixtureType fixture, bool began, double impact) {
+    ECS::Entity* const e = world->get(handle);
+    if (e == nullptr) { return; }
+    if (fixture == FixtureType::GroundSensor) {
+      if (e->has<RigidBody>()) { e->get<RigidBody>()->underfootContacts_ += began ? 1 : -1; }
+    }
+    else if (began && e->has<Combat>()) {
+      e->get<Combat>()->dealImpactDamage(impact);
+    }
+  };
+  for (const auto& c : dispatchedContacts_) {
+    handleContact(c.entityA, c.fixtureA, c.began, c.impact);
+    handleContact(c.entityB, c.fixtureB, c.began, c.impact);
+  }
+
+  // Let other systems handle them all at once
+  world->emit<PhysicsContactsEvent>({ dispatchedContacts_ });
 
-    // Dispose of any old bodies and clear the disposal list
-    for (auto* d : r->disposeList_) {
-      world_.DestroyBody(d);
+  // Then scripts
+  if (onContact_.valid()) {
+    auto attempt = onContact_(&dispatchedContacts_);
+    if (!attempt.valid()) {
+      sol::error err = attempt;
+      Console::log("[Error] in Physics.onContact():\n> %s", err.what());
     }
-    r->disposeList_.clear();
-  });
+  }
+
+  dispatchedContacts_.clear();
 }
 
-// Single-step the physics
+// Start the pending step in the background
 void
-PhysicsSystem::singleStep(float timeStep) {
-  world_.Step(timeStep, velocityIterations_, positionIterations_);
+PhysicsSystem::startBackgroundStep() {
+  if (pendingStep_ <= 0.f) { return; }
+
+  // Start the thread the first time it's needed
+  if (!stepThread_.joinable()) {
+    stepThread_ = std::thread(&PhysicsSystem::handleBackgroundSteps, this);
+  }
+
+  // Hand the step over
+  {
+    std::lock_guard<std::mutex> lock(stepMutex_);
+    backgroundStep_ = pendingStep_;
+  }
+  pendingStep_ = 0.f;
+  stepChanged_.notify_all();
 }
 
-// Interpolation between frames
+// Wait for the background step to finish
 void
-PhysicsSystem::smoothState(ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<RigidBody> rb) {
+PhysicsSystem::finishBackgroundStep() {
+  if (!stepThread_.joinable()) { return; }
+  PROFILE_SCOPE("PhysicsSystem::waitForStep");
+  std::unique_lock<std::mutex> lock(stepMutex_);
+  stepChanged_.wait(lock, [this]() { return backgroundStep_ <= 0.f; });
+}
 
-  // Ensure there's a body to work with
-  b2Body* const body = rb->body_;
-  if (body != nullptr) {
+// Run steps as they're started, on the background thread
+void
+PhysicsSystem::handleBackgroundSteps() {
+  std::unique_lock<std::mutex> lock(stepMutex_);
+  while (true) {
+
+    // Sleep until there's a step to run or we're told to stop
+    stepChanged_.wait(lock, [this]() { return backgroundStep_ > 0.f || stopStepThread_; });
+    if (stopStepThread_) { return; }
+
+    // Nothing else touches the physics world until the step is finished
+    const float step = backgroundStep_;
+    lock.unlock();
+    singleStep(step);
+    lock.lock();
+    backgroundStep_ = 0.f;
+    stepChanged_.notify_all();
+  }
+}
 
-    // Set up variables
-    const float oneMinusRatio = 1.0f - fixedTimeStepRatio_;
+// Run steps in the background
+void
+PhysicsSystem::setAsync(bool enable) {
+  async_ = enable;
+}
 
-    // Interpolate based on previous position
-    if (body->GetType() != b2_staticBody) {
+// Get whether steps run in the background
+bool
+PhysicsSystem::isAsync() const {
+  return async_;
+}
 
-      // Tween position
-      t->position = convertToSF(
-        fixedTimeStepRatio_ * body->GetPosition() +
-        oneMinusRatio * rb->previousPosition_);
+// Start stepping in the background once the frame has updated
+void
+PhysicsSystem::receive(ECS::World* w, const BackgroundWorkStartEvent& e) {
+  startBackgroundStep();
+}
 
-      // Precalculate conversion to degrees
-      constexpr float convertToDegrees = 180.f / M_PI;
+// Finish stepping before anything else touches the physics world
+void
+PhysicsSystem::receive(ECS::World* w, const BackgroundWorkSyncEvent& e) {
+  finishBackgroundStep();
+}
 
-      // Tween rotation
-      t->rotation = convertToDegrees * body->GetAngle();
-      // @TODO: This code sets t->rotation to infinity and breaks the game
-      // it must be fixed in order to tween rotation
-      //t->rotation = convertToDegrees * (body->GetAngle() +
-        //oneMinusRatio * rb->previousAngle_);
-    }
+// Get what's in the world and how long steps are taking
+PhysicsStats
+PhysicsSystem::getStats() {
+  const PhysicsIslands& islands = getIslands();
+  PhysicsStats stats;
+  stats.steps = profiledSteps_;
+  stats.bodies = world_.GetBodyCount();
+  stats.awakeBodies = 0;
+  for (const b2Body* body = world_.GetBodyList(); body != nullptr; body = body->GetNext()) {
+    if (body->IsAwake()) { ++stats.awakeBodies; }
   }
+  stats.contacts = world_.GetContactCount();
+  stats.proxies = world_.GetProxyCount();
+  stats.islands = islands.getCount();
+  stats.largestIsland = islands.getLargest();
+  stats.stepTime = lastProfile_.step;
+  stats.collideTime = lastProfile_.collide;
+  stats.broadphaseTime = lastProfile_.broadphase;
+  stats.solveTime = lastProfile_.solve;
+  stats.solveTOITime = lastProfile_.solveTOI;
+  stats.averageStepTime = profiledSteps_ > 0 ? totalStepTime_ / profiledSteps_ : 0.f;
+  stats.slowestStepTime = slowestStepTime_;
+  return stats;
+}
+
+// Start timing steps again
+void
+PhysicsSystem::resetStats() {
+  finishBackgroundStep();
+  profiledSteps_ = 0;
+  totalStepTime_ = 0.f;
+  slowestStepTime_ = 0.f;
+}
+
+// Change how many velocity iterations the solver takes each step
+void
+PhysicsSystem::setVelocityIterations(int iterations) {
+  finishBackgroundStep();
+  velocityIterations_ = std::max(iterations, 1);
+}
+
+// Get how many velocity iterations the solver takes at full quality
+int
+PhysicsSystem::getVelocityIterations() const {
+  return velocityIterations_;
 }
 
-// When the step occurs, reset any smoothing
+// Change how many position iterations the solver takes each step
 void
-PhysicsSystem::resetSmoothStates(ECS::ComponentHandle<RigidBody> r) {
+PhysicsSystem::setPositionIterations(int iterations) {
+  finishBackgroundStep();
+  positionIterations_ = std::max(iterations, 1);
+}
+
+// Get how many position iterations the solver takes at full quality
+int
+PhysicsSystem::getPositionIterations() const {
+  return positionIterations_;
+}
+
+// Take fewer iterations when the simulation's quality is lowered
+void
+PhysicsSystem::receive(ECS::World* w, const SimulationQualityEvent& e) {
+  finishBackgroundStep();
+  quality_ = std::min(std::max(e.quality, 0.f), 1.f);
+}
 
-  // Set up variables
-  b2Body* const body = r->body_;
+// Log statistics, such as at the end of a headless run
+void
+PhysicsSystem::receive(ECS::World* w, const ReportStatsEvent& e) {
+  const PhysicsStats stats = getStats();
+  Console::log("Physics: %u steps, average %.3fms, slowest %.3fms.",
+    stats.steps, stats.averageStepTime, stats.slowestStepTime);
+  Console::log("Physics: %d bodies (%d awake), %d contacts, %d proxies, %lu islands (largest %lu).",
+    stats.bodies, stats.awakeBodies, stats.contacts, stats.proxies, stats.islands, stats.largestIsland);
+}
 
-  // Reset any smoothing
-  if (body != nullptr && body->GetType() != b2_staticBody) {
-    r->previousPosition_ = body->GetPosition();
-    r->previousAngle_ = body->GetAngle();
+// Get the islands the last step was solved in
+const PhysicsIslands&
+PhysicsSystem::getIslands() {
+  finishBackgroundStep();
+  if (islandsDirty_) {
+    PROFILE_SCOPE("PhysicsIslands::build");
+    islands_.build(world_);
+    islandsDirty_ = false;
   }
+  return islands_;
 }
 
-// Get this system's physics world
-b2World*
-PhysicsSystem::getWorld() {
-  return &world_;
+// Ask what's where in the physics world
+// A step running in the background is finished first, as the world can't be read while it's stepped
+PhysicsQueries&
+PhysicsSystem::getQueries() {
+  finishBackgroundStep();
+  return queries_;
 }
 
 // Get gravity
@@ -230,8 +630,12 @@ PhysicsSystem::convertToB2(const sf::Vector2f& vec) {
 void
 PhysicsSystem::receive(ECS::World* w, const DebugRenderPhysicsEvent& e) {
 
-  // Save the pointer to the window
-  physicsDebugDraw_.window = &e.window;
+  // The world can't be drawn while it's stepping
+  finishBackgroundStep();
+
+  // Record into the arrays we were given
+  physicsDebugDraw_.lines = &e.lines;
+  physicsDebugDraw_.triangles = &e.triangles;
 
   // Render the physics system
   world_.DrawDebugData();
@@ -247,7 +651,8 @@ PhysicsSystem::receive(ECS::World* w, const addDebugMenuEntryEvent& e) {
 void
 PhysicsSystem::receive(ECS::World* w, const addDebugInfoEvent& e) {
 
-  // Add to default window
+  // Add to default window, after any background step has finished
+  finishBackgroundStep();
   ImGui::Begin("Debug");
   ImGui::Text("Physics bodies: %d", world_.GetBodyCount());
   ImGui::End();
@@ -258,6 +663,44 @@ PhysicsSystem::receive(ECS::World* w, const addDebugInfoEvent& e) {
     float gravity = gravityVec.y / 10.f;
     ImGui::Begin("Physics System", &showPhysicsWindow_);
     ImGui::DragFloat("Gravity", &gravity, 2.f);
+
+    // Show whether the simulation is keeping up, dropped time means the step limit was hit
+    const SimulationStats& simulation = Game::getSimulationStats();
+    const PhysicsStats stats = getStats();
+    ImGui::Separator();
+    ImGui::Text("Steps last update: %u of %u%s",
+      simulation.steps, simulation.maxSteps, simulation.clamped ? " (clamped)" : "");
+    ImGui::Text("Step: %.2fms, quality: %.0f%%, load: %.0f%%",
+      simulation.step.asSeconds() * 1000.f, simulation.quality * 100.f, simulation.load * 100.f);
+    ImGui::Text("Backlog: %.2fms", simulation.backlog.asSeconds() * 1000.f);
+    ImGui::Text("Clamped updates: %u, dropping %.2fms",
+      simulation.clampedUpdates, simulation.dropped.asSeconds() * 1000.f);
+
+    // Show what's in the world
+    ImGui::Separator();
+    ImGui::Text("Bodies: %d (%d awake)", stats.bodies, stats.awakeBodies);
+    ImGui::Text("Contacts: %d, proxies: %d", stats.contacts, stats.proxies);
+    int velocityIterations = velocityIterations_;
+    int positionIterations = positionIterations_;
+    if (ImGui::DragInt("Velocity iterations", &velocityIterations, 0.1f, 1, 50)) {
+      setVelocityIterations(velocityIterations);
+    }
+    if (ImGui::DragInt("Position iterations", &positionIterations, 0.1f, 1, 50)) {
+      setPositionIterations(positionIterations);
+    }
+
+    // Show how the awake bodies are grouped when they're solved
+    const PhysicsIslands& islands = getIslands();
+    ImGui::Text("Islands: %lu (largest %lu of %lu awake bodies)",
+      islands.getCount(), islands.getLargest(), islands.getBodyCount());
+
+    // Show where the time goes in each step
+    ImGui::Separator();
+    ImGui::Text("Step: %.3fms (average %.3fms, slowest %.3fms)",
+      stats.stepTime, stats.averageStepTime, stats.slowestStepTime);
+    ImGui::Text("Collide: %.3fms, broadphase: %.3fms", stats.collideTime, stats.broadphaseTime);
+    ImGui::Text("Solve: %.3fms, TOI: %.3fms", stats.solveTime, stats.solveTOITime);
+    if (ImGui::Button("Reset timings")) { resetStats(); }
     ImGui::End();
     if (gravity * 10.f != gravityVec.y) {
       setGravity(gravityVec.x, gravity * 10.f);
@@ -6,6 +6,9 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <Box2D/Box2D.h>
 
@@ -14,16 +17,54 @@
 #include "RigidBody.h"
 
 #include "PhysicsDebugDraw.h"
+#include "PhysicsIslands.h"
+#include "PhysicsQueries.h"
+
+// What's in the physics world and how long its steps take
+// Times are in milliseconds, and the world's Box2D profile splits them by stage of the step
+struct PhysicsStats {
+
+  // Steps taken since the statistics were reset
+  unsigned steps;
+
+  // Bodies in the world, and how many are awake
+  int bodies;
+  int awakeBodies;
+
+  // Contacts between fixtures that are close, and broadphase proxies, one per fixture child
+  int contacts;
+  int proxies;
+
+  // Islands the last step was solved in, and how many bodies were in the biggest
+  std::size_t islands;
+  std::size_t largestIsland;
+
+  // Time spent in the last step: updating contacts, finding new ones, solving, then continuous collision
+  float stepTime;
+  float collideTime;
+  float broadphaseTime;
+  float solveTime;
+  float solveTOITime;
+
+  // Average and slowest times for a step since the statistics were reset
+  float averageStepTime;
+  float slowestStepTime;
+};
 
 class PhysicsSystem 
 : public ECS::EntitySystem
 , public ECS::EventSubscriber<DebugRenderPhysicsEvent>
+, public ECS::EventSubscriber<BackgroundWorkStartEvent>
+, public ECS::EventSubscriber<BackgroundWorkSyncEvent>
+, public ECS::EventSubscriber<ReportStatsEvent>
+, public ECS::EventSubscriber<SimulationQualityEvent>
 , public ECS::EventSubscriber<addDebugInfoEvent>
 , public ECS::EventSubscriber<addDebugMenuEntryEvent> {
   public:
 
     // Friend class
     friend class PhysicsDebugDraw;
+    friend class RigidBody;
 
     // Register a Physics System in this world
     static void registerPhysicsSystem(sol::environment& env, ECS::World* world);
@@ -39,12 +80,16 @@ class PhysicsSystem
     PhysicsSystem();
     ~PhysicsSystem();
 
-    // Simulate Physics every update
+    // Simulate a single step of physics every simulation update
     virtual void update(ECS::World* world, const sf::Time& dt) override;
 
     // Subscribe to the DebugDraw method
     virtual void configure(ECS::World* world) override { 
       world->subscribe<DebugRenderPhysicsEvent>(this); 
+      world->subscribe<BackgroundWorkStartEvent>(this); 
+      world->subscribe<BackgroundWorkSyncEvent>(this); 
+      world->subscribe<ReportStatsEvent>(this); 
+      world->subscribe<SimulationQualityEvent>(this); 
       world->subscribe<addDebugMenuEntryEvent>(this); 
       world->subscribe<addDebugInfoEvent>(this); 
     }
@@ -59,11 +104,41 @@ class PhysicsSystem
     void setGravity(float gx, float gy);
     void setGravityVec(const sf::Vector2f& g);
 
+    // Get the islands the last step was solved in, found when first asked for after each step
+    const PhysicsIslands& getIslands();
+
+    // Ask what's where in the physics world, such as what a ray hits
+    PhysicsQueries& getQueries();
+
+    // Get what's in the world and how long steps are taking
+    PhysicsStats getStats();
+
+    // Start timing steps again
+    void resetStats();
+
+    // Change how many iterations the solver takes each step, more is more accurate but slower
+    // Adaptive simulation may use fewer when the scene can't keep up
+    void setVelocityIterations(int iterations);
+    int getVelocityIterations() const;
+    void setPositionIterations(int iterations);
+    int getPositionIterations() const;
+
+    // Run each step in the background while the frame is presented and rendered
+    // Contacts are handled and transforms moved at the start of the next step, so everything is a step behind
+    void setAsync(bool enable);
+    bool isAsync() const;
+
   private:
 
     // ContactListener
     ContactListener contactListener_;
 
+    // Contacts being handled, kept to reuse the memory
+    std::vector<ContactEvent> dispatchedContacts_;
+
+    // Script called with each step's contacts
+    sol::protected_function onContact_;
+
     // Default gravity setting
     const sf::Vector2f defaultGravity_;
 
@@ -73,22 +148,54 @@ class PhysicsSystem
     // Debug rendering system
     PhysicsDebugDraw physicsDebugDraw_;
 
-    // Maximum steps to queue before forcing action
-    // A large amount of steps will create more strain,
-    // reducing the framerate and creating more steps
-    const int maxSteps_ = 5;
+    // Entities whose bodies are being moved by the simulation, their transforms are moved after every step
+    // Bodies join when they're woken and leave once they fall asleep, so settled bodies cost nothing to sync
+    std::vector<ECS::EntityHandle> activeBodies_;
+
+    // Entities whose bodies may have been woken or moved since the last step
+    std::vector<ECS::EntityHandle> wokenBodies_;
+
+    // Entities whose bodies need moving to their transforms, including any still waiting for a transform
+    std::vector<ECS::EntityHandle> outOfSyncBodies_;
+
+    // Old bodies to destroy before the next step
+    std::vector<b2Body*> disposedBodies_;
+
+    // Spatial queries of the world, and the rays of the last batch asked for by scripts
+    PhysicsQueries queries_;
+    std::vector<sf::Vector2f> scriptRays_;
+
+    // Islands of bodies that could be solved independently, and whether they need finding again
+    PhysicsIslands islands_;
+    bool islandsDirty_;
+
+    // Whether steps run in the background
+    bool async_;
 
-    // How long to wait per step
-    const float fixedTimeStep_ = 1.0f / 60.0f;
+    // A step waiting for the frame to finish updating before it runs in the background, in seconds
+    float pendingStep_;
 
-    // A more accurate 'step' for interpolation
-    float fixedTimeStepRatio_;
+    // Whether a step has run since contacts were handled and transforms were moved
+    bool hasStepResults_;
 
-    // An accumilator to make the physics frame independant
-    float timeStepAccumilator_;
+    // Thread running steps in the background, started the first time it's needed
+    // The step being run is set while it runs, and cleared once it's finished
+    std::thread stepThread_;
+    std::mutex stepMutex_;
+    std::condition_variable stepChanged_;
+    float backgroundStep_;
+    bool stopStepThread_;
 
+    // Iterations the solver takes each step, scaled by the simulation's quality
     int32 velocityIterations_ = 8;
     int32 positionIterations_ = 3;
+    float quality_;
+
+    // The profile of the last step, and totals since the statistics were reset
+    b2Profile lastProfile_;
+    unsigned profiledSteps_;
+    float totalStepTime_;
+    float slowestStepTime_;
 
     // Imgui flags
     static bool showPhysicsWindow_;
@@ -97,11 +204,54 @@ class PhysicsSystem
     // Step through physics once
     void singleStep(float timeStep);
 
-    // Interpolate between physics steps
-    void smoothState(ECS::ComponentHandle<Transform> t, ECS::ComponentHandle<RigidBody> r);
+    // Move transforms to where their bodies are
+    void syncTransforms(ECS::World* world);
+
+    // Prepare bodies for the next step, moving, destroying and waking them as asked since the last one
+    void prepareBodies(ECS::World* world);
+
+    // Start moving an entity's transform with its body after each step
+    void activate(const ECS::EntityHandle& handle, RigidBody& rigidBody);
+
+    // Ask for an entity's body to be moved to its transform before the next step
+    void syncBody(const ECS::EntityHandle& handle);
+
+    // Ask for a body to be checked before the next step, as it may have been woken up or moved
+    void wakeBody(const ECS::EntityHandle& handle);
+    void wakeBody(b2Body* body);
+
+    // Wake anything touching a body that's about to be destroyed, as Box2D will wake it without telling us
+    void wakeNeighbours(b2Body* body);
+
+    // Destroy a body before the next step
+    void disposeBody(b2Body* body);
+
+    // Destroy a body straight away
+    void destroyBody(b2Body* body);
+
+    // Hand every recorded contact to ground sensors, other systems and then scripts
+    void dispatchContacts(ECS::World* world);
+
+    // Start the pending step in the background
+    void startBackgroundStep();
+
+    // Wait for the background step to finish, the physics world can't be touched until then
+    void finishBackgroundStep();
+
+    // Run steps as they're started, on the background thread
+    void handleBackgroundSteps();
+
+    // Start stepping in the background once the frame has updated
+    virtual void receive(ECS::World* ecsWorld, const BackgroundWorkStartEvent& ev) override;
+
+    // Finish stepping before anything else touches the physics world
+    virtual void receive(ECS::World* ecsWorld, const BackgroundWorkSyncEvent& ev) override;
+
+    // Log statistics, such as at the end of a headless run
+    virtual void receive(ECS::World* ecsWorld, const ReportStatsEvent& ev) override;
 
-    // Reset interpolation to the actual physics locations
-    void resetSmoothStates(ECS::ComponentHandle<RigidBody> r);
+    // Take fewer iterations when the simulation's quality is lowered
+    virtual void receive(ECS::World* ecsWorld, const SimulationQualityEvent& ev) override;
 
     // Render the physics when debug mode is enabled
     virtual void receive(ECS::World* ecsWorld, const DebugRenderPhysicsEvent& ev) override;
@@ -0,0 +1,282 @@
+// Profiler.cpp
+// Records how long each part of a frame takes, on every thread
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+#include "Console.h"
+
+// Initialise static members
+std::atomic<bool> Profiler::enabled_(false);
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::buffers_;
+std::mutex Profiler::buffersMutex_;
+uint32_t Profiler::mainThread_ = 0;
+int64_t Profiler::frameStart_ = -1;
+int64_t Profiler::previousFrameStart_ = -1;
+std::vector<Profiler::Zone> Profiler::shownZones_;
+int64_t Profiler::shownStart_ = 0;
+int64_t Profiler::shownEnd_ = 0;
+bool Profiler::paused_ = false;
+
+// Enable or disable recording
+void
+Profiler::setEnabled(bool enable) {
+
+  // Frames recorded before disabling shouldn't be joined to the next one
+  if (!enable) {
+    frameStart_ = -1;
+    previousFrameStart_ = -1;
+  }
+  enabled_.store(enable, std::memory_order_relaxed);
+}
+
+// Get whether zones are being recorded
+bool
+Profiler::isEnabled() {
+  return enabled_.load(std::memory_order_relaxed);
+}
+
+// Mark the start of a new frame, call from the main thread
+void
+Profiler::markFrame() {
+  if (!isEnabled()) { return; }
+  mainThread_ = getThreadBuffer().thread;
+  previousFrameStart_ = frameStart_;
+  frameStart_ = now();
+}
+
+// Get the current time, in nanoseconds since the profiler started
+int64_t
+Profiler::now() {
+  static const auto epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Get the start and end of the last complete frame
+bool
+Profiler::getLastFrame(int64_t& start, int64_t& end) {
+  if (previousFrameStart_ < 0) { return false; }
+  start = previousFrameStart_;
+  end = frameStart_;
+  return true;
+}
+
+// Copy every recorded zone that overlaps a period of time
+std::vector<Profiler::Zone>
+Profiler::getZones(int64_t from, int64_t to) {
+  std::vector<Zone> zones;
+  std::lock_guard<std::mutex> lock(buffersMutex_);
+  for (const auto& buffer : buffers_) {
+
+    // Copy everything the thread has published that is still in its buffer
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t first = head > Capacity ? head - Capacity : 0;
+    std::vector<Zone> recent;
+    recent.reserve(head - first);
+    for (uint64_t i = first; i < head; ++i) {
+      const Slot& slot = buffer->slots[i % Capacity];
+      recent.push_back({ slot.name.load(std::memory_order_relaxed),
+        slot.start.load(std::memory_order_relaxed),
+        slot.end.load(std::memory_order_relaxed),
+        slot.depth.load(std::memory_order_relaxed),
+        buffer->thread });
+    }
+
+    // The thread kept recording while we copied, so skip anything it may have overwritten
+    const uint64_t newHead = buffer->head.load(std::memory_order_acquire);
+    const uint64_t safe = newHead > Capacity ? newHead - Capacity : 0;
+    for (uint64_t i = std::max(first, safe); i < head; ++i) {
+      const Zone& zone = recent[i - first];
+      if (zone.end >= from && zone.start <= to) { zones.push_back(zone); }
+    }
+  }
+  return zones;
+}
+
+// Write every recorded zone to a file that chrome://tracing or Perfetto can open
+bool
+Profiler::exportChromeTrace(const std::string& fp) {
+
+  // Open the file
+  std::ofstream file(fp);
+  if (!file.is_open()) {
+    Console::log("[Error] Could not open %s to export profile.", fp.c_str());
+    return false;
+  }
+
+  // Escape anything that would break a JSON string
+  auto writeString = [&file](const char* str) {
+    file << '"';
+    for (const char* c = str; *c != '\0'; ++c) {
+      if (*c == '"' || *c == '\\') { file << '\\'; }
+      if ((unsigned char)*c >= 0x20) { file << *c; }
+    }
+    file << '"';
+  };
+
+  // Name every thread
+  std::vector<Zone> zones = getZones(0, now());
+  std::vector<uint32_t> threads;
+  {
+    std::lock_guard<std::mutex> lock(buffersMutex_);
+    for (const auto& buffer : buffers_) { threads.push_back(buffer->thread); }
+  }
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (uint32_t thread : threads) {
+    const std::string name = thread == mainThread_ ? "Main Thread" : "Thread " + std::to_string(thread);
+    file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+      << ",\"args\":{\"name\":";
+    writeString(name.c_str());
+    file << "}}";
+    first = false;
+  }
+
+  // Write each zone as a complete event, timed in microseconds
+  for (const Zone& zone : zones) {
+    file << (first ? "" : ",\n") << "{\"name\":";
+    writeString(zone.name);
+    file << ",\"cat\":\"engine\",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.thread
+      << ",\"ts\":" << zone.start / 1000.0
+      << ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+    first = false;
+  }
+  file << "\n]}\n";
+
+  Console::log("Exported %u profiled zones to %s.", (unsigned)zones.size(), fp.c_str());
+  return true;
+}
+
+// Show the profiler window in IMGUI
+void
+Profiler::showDebugWindow(bool* open) {
+  if (!ImGui::Begin("Profiler", open)) {
+    ImGui::End();
+    return;
+  }
+
+  // Controls
+  bool enabled = isEnabled();
+  if (ImGui::Checkbox("Record", &enabled)) { setEnabled(enabled); }
+  ImGui::SameLine();
+  ImGui::Checkbox("Pause", &paused_);
+  ImGui::SameLine();
+  if (ImGui::Button("Export Chrome Trace")) { exportChromeTrace("profile.json"); }
+
+  // Take the latest frame unless paused
+  int64_t start, end;
+  if (!paused_ && getLastFrame(start, end)) {
+    shownZones_ = getZones(start, end);
+    shownStart_ = start;
+    shownEnd_ = end;
+  }
+  if (shownEnd_ <= shownStart_) {
+    ImGui::Text("Enable recording to see where frame time goes.");
+    ImGui::End();
+    return;
+  }
+  const double frameLength = (double)(shownEnd_ - shownStart_);
+  ImGui::Text("Frame: %.3fms", frameLength / 1000000.0);
+
+  // Draw a row of bars per thread, nested zones below their parents
+  std::map<uint32_t, uint32_t> rowDepths;
+  for (const Zone& zone : shownZones_) {
+    rowDepths[zone.thread] = std::max(rowDepths[zone.thread], zone.depth + 1);
+  }
+  const float barHeight = ImGui::GetTextLineHeight() + 4.f;
+  const float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+  const double scale = width / frameLength;
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  for (const auto& row : rowDepths) {
+    if (row.first == mainThread_) { ImGui::Text("Main Thread"); }
+    else { ImGui::Text("Thread %u", row.first); }
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    for (const Zone& zone : shownZones_) {
+      if (zone.thread != row.first) { continue; }
+
+      // Clip to the frame
+      const float x0 = origin.x + (float)(std::max<int64_t>(zone.start - shownStart_, 0) * scale);
+      const float x1 = origin.x + (float)(std::min<int64_t>(zone.end - shownStart_, shownEnd_ - shownStart_) * scale);
+      const float y0 = origin.y + zone.depth * barHeight;
+      const ImVec2 min(x0, y0);
+      const ImVec2 max(std::max(x1, x0 + 1.f), y0 + barHeight - 1.f);
+
+      // Colour by name so the same zone looks the same every frame
+      const std::size_t hash = std::hash<std::string>()(zone.name);
+      const ImU32 colour = ImColor::HSV((hash % 360) / 360.f, 0.5f, 0.8f);
+      drawList->AddRectFilled(min, max, colour);
+      if (max.x - min.x > ImGui::CalcTextSize(zone.name).x + 4.f) {
+        drawList->AddText(ImVec2(min.x + 2.f, min.y + 2.f), IM_COL32_BLACK, zone.name);
+      }
+      if (ImGui::IsMouseHoveringRect(min, max)) {
+        ImGui::SetTooltip("%s: %.3fms", zone.name, (zone.end - zone.start) / 1000000.0);
+      }
+    }
+    ImGui::Dummy(ImVec2(width, row.second * barHeight));
+  }
+
+  // Total time spent in each zone this frame, most expensive first
+  std::map<std::string, std::pair<int64_t, unsigned>> totals;
+  for (const Zone& zone : shownZones_) {
+    auto& total = totals[zone.name];
+    total.first += std::min(zone.end, shownEnd_) - std::max(zone.start, shownStart_);
+    ++total.second;
+  }
+  std::vector<std::pair<std::string, std::pair<int64_t, unsigned>>> sorted(totals.begin(), totals.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+  ImGui::Separator();
+  ImGui::Columns(3, "ProfilerTotals");
+  ImGui::Text("Zone"); ImGui::NextColumn();
+  ImGui::Text("Total"); ImGui::NextColumn();
+  ImGui::Text("Calls"); ImGui::NextColumn();
+  for (const auto& entry : sorted) {
+    ImGui::Text("%s", entry.first.c_str()); ImGui::NextColumn();
+    ImGui::Text("%.3fms", entry.second.first / 1000000.0); ImGui::NextColumn();
+    ImGui::Text("%u", entry.second.second); ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+  ImGui::End();
+}
+
+// Get this thread's buffer, creating it on first use
+Profiler::ThreadBuffer&
+Profiler::getThreadBuffer() {
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+    created->depth = 0;
+    created->head.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(buffersMutex_);
+    created->thread = (uint32_t)buffers_.size();
+    buffer = created.get();
+    buffers_.push_back(std::move(created));
+  }
+  return *buffer;
+}
+
+// Start a zone on this thread
+int64_t
+Profiler::begin() {
+  ++getThreadBuffer().depth;
+  return now();
+}
+
+// Finish a zone on this thread, publishing it to readers
+void
+Profiler::end(const char* name, int64_t start) {
+  const int64_t finish = now();
+  ThreadBuffer& buffer = getThreadBuffer();
+  const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  Slot& slot = buffer.slots[head % Capacity];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.end.store(finish, std::memory_order_relaxed);
+  slot.depth.store(--buffer.depth, std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,137 @@
+// Profiler.h
+// Records how long each part of a frame takes, on every thread
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Time the rest of the enclosing block, the name must last as long as the program (a literal is fine)
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+// Let the ECS time its systems and event dispatch, ECS.h includes this header itself
+#ifdef ECS_PROFILE_SCOPE
+#undef ECS_PROFILE_SCOPE
+#endif
+#define ECS_PROFILE_SCOPE(name) PROFILE_SCOPE(name)
+
+// Static class collecting timed zones from every thread
+// Each thread records into its own ring buffer without locking, older zones are overwritten
+// Recording costs a single check while the profiler is disabled
+class Profiler {
+  public:
+
+    // A timed part of a frame, times are in nanoseconds since the profiler started
+    struct Zone {
+      const char* name;
+      int64_t start;
+      int64_t end;
+      uint32_t depth;
+      uint32_t thread;
+    };
+
+    // Times from construction until destruction
+    class Scope {
+      public:
+
+        // Start timing if the profiler is enabled
+        explicit Scope(const char* name)
+          : name_(Profiler::isEnabled() ? name : nullptr)
+          , start_(0) {
+          if (name_ != nullptr) { start_ = Profiler::begin(); }
+        }
+
+        // Record the zone
+        ~Scope() {
+          if (name_ != nullptr) { Profiler::end(name_, start_); }
+        }
+
+      private:
+
+        // What is being timed, null when not recording
+        const char* name_;
+
+        // When timing started
+        int64_t start_;
+    };
+
+    // Enable or disable recording
+    static void setEnabled(bool enable);
+    static bool isEnabled();
+
+    // Mark the start of a new frame, call from the main thread
+    static void markFrame();
+
+    // Get the current time, in nanoseconds since the profiler started
+    static int64_t now();
+
+    // Get the start and end of the last complete frame, returns false if there hasn't been one
+    static bool getLastFrame(int64_t& start, int64_t& end);
+
+    // Copy every recorded zone that overlaps a period of time
+    static std::vector<Zone> getZones(int64_t from, int64_t to);
+
+    // Write every recorded zone to a file that chrome://tracing or Perfetto can open
+    static bool exportChromeTrace(const std::string& fp);
+
+    // Show the profiler window in IMGUI
+    static void showDebugWindow(bool* open);
+
+  private:
+
+    // How many zones each thread keeps
+    static const std::size_t Capacity = 16384;
+
+    // A zone being written by one thread while another may be reading it
+    struct Slot {
+      std::atomic<const char*> name;
+      std::atomic<int64_t> start;
+      std::atomic<int64_t> end;
+      std::atomic<uint32_t> depth;
+    };
+
+    // Zones recorded by a single thread
+    // Only the owning thread writes, head is published after each zone is complete
+    struct ThreadBuffer {
+      uint32_t thread;
+      uint32_t depth;
+      std::atomic<uint64_t> head;
+      Slot slots[Capacity];
+    };
+
+    // Whether zones are being recorded
+    static std::atomic<bool> enabled_;
+
+    // Every thread's buffer, the mutex is only taken when a thread first records and when reading
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    static std::mutex buffersMutex_;
+
+    // The thread that marks frames
+    static uint32_t mainThread_;
+
+    // Start times of the last two frames
+    static int64_t frameStart_;
+    static int64_t previousFrameStart_;
+
+    // What the window is showing, kept while paused
+    static std::vector<Zone> shownZones_;
+    static int64_t shownStart_;
+    static int64_t shownEnd_;
+    static bool paused_;
+
+    // Get this thread's buffer, creating it on first use
+    static ThreadBuffer& getThreadBuffer();
+
+    // Start and finish a zone on this thread
+    static int64_t begin();
+    static void end(const char* name, int64_t start);
+};
+
+#endif
@@ -0,0 +1,32 @@
+// RenderSnapshot.h
+// Everything needed to draw a frame, copied out of the world
+
+#ifndef RENDERSNAPSHOT_H
+#define RENDERSNAPSHOT_H
+
+#include <SFML/Graphics.hpp>
+
+#include "SpriteBatch.h"
+
+// Filled in by the update thread after the world updates, and drawn by the render thread
+// Nothing in here points back into the world, so drawing it never touches entities or components
+struct RenderSnapshot {
+
+  // Constructor
+  RenderSnapshot()
+    : debugLines(sf::Lines)
+    , debugTriangles(sf::Triangles) {
+  }
+
+  // The view at the time of the update
+  sf::View view;
+
+  // Sprites and text, sorted and batched
+  SpriteBatch batch;
+
+  // Physics shapes to draw in debug mode
+  sf::VertexArray debugLines;
+  sf::VertexArray debugTriangles;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #define RENDERSYSTEM_H
 
 #include <math.h>
+#include <mutex>
+#include <vector>
 
 #include "Game.h"
 #include "Scripting.h"
@@ -12,9 +14,24 @@
 #include "Sprite.h"
 #include "Text.h"
 #include "Transform.h"
+#include "UIWidget.h"
+#include "SpriteBatch.h"
+#include "SpatialGrid.h"
+
+// Sent by the scene to collect everything that should be drawn within an area
+struct GatherRenderablesEvent {
+  sf::FloatRect area;
+  SpriteBatch& batch;
+};
 
 // Every frame, move sprites to their transform's locations
-class RenderSystem : public ECS::EntitySystem {
+// Also keeps track of where everything is, so only what's on screen gets drawn
+class RenderSystem 
+: public ECS::EntitySystem
+, public ECS::EventSubscriber<GatherRenderablesEvent>
+, public ECS::EventSubscriber<ECS::Events::OnComponentRemoved<Sprite>>
+, public ECS::EventSubscriber<ECS::Events::OnComponentRemoved<Text>>
+, public ECS::EventSubscriber<addDebugInfoEvent> {
   public:
 
     // Register this system in the world
@@ -32,31 +49,114 @@ class RenderSystem : public ECS::EntitySystem {
       });
     }
 
+    // Constructor, UI placement reads the view so this stays on the main thread
+    // Runs once per frame, between simulation steps
+    RenderSystem() {
+      setName("RenderSystem");
+      setUpdateGroup((unsigned)UpdateGroup::Presentation);
+      reads<Transform, UIWidget>();
+      writes<Sprite, Text>();
+      setAffinity(Affinity::MainThread);
+    }
+
     // Manipulate the sprite's transform every frame
     virtual void update(ECS::World* world, const sf::Time& dt) override {
 
-      // Get every entity with a sprite and transform
-      world->each<Sprite, Transform>( 
+      // How far we are between the last two simulation steps
+      const float alpha = Game::getInterpolation();
+
+      // Nothing is drawn when headless, so there's nothing to cull
+      const bool culling = !Game::isHeadless();
+
+      // Get every entity with a sprite and transform, spreading them across threads
+      // Each entity is independent and the view is only read while doing so
+      world->parallelEach<Sprite, Transform>( 
         [&](ECS::Entity* e, ECS::ComponentHandle<Sprite> s, ECS::ComponentHandle<Transform> t) {
 
         // Move sprite and then update the animation
-        repositionTransformable(e, t.get(), (sf::Transformable*)&s.get());
+        const bool moved = repositionTransformable(e, t.get(), (sf::Transformable*)&s.get(), alpha);
         s->updateAnimation(dt);
 
+        // Check whether it's left its cell, if it could have
+        const bool resized = s->takeResized();
+        if (culling) { findGridChange(spriteGrid_, spriteChanges_, e, moved || resized, s.get()); }
       });
 
-      // Get every entity with a sprite and transform
-      world->each<Text, Transform>( 
+      // Get every entity with text and transform
+      world->parallelEach<Text, Transform>( 
         [&](ECS::Entity* e, ECS::ComponentHandle<Text> txt, ECS::ComponentHandle<Transform> t) {
 
         // Move text
-        repositionTransformable(e, t.get(), (sf::Transformable*)&txt.get());
+        const bool moved = repositionTransformable(e, t.get(), (sf::Transformable*)&txt.get(), alpha);
+        const bool resized = txt->takeResized();
+        if (culling) { findGridChange(textGrid_, textChanges_, e, moved || resized, txt.get()); }
+      });
+
+      // Only entities that moved to another cell, appeared or joined the UI change the grids
+      applyGridChanges(spriteGrid_, spriteChanges_);
+      applyGridChanges(textGrid_, textChanges_);
+    }
+
+    // Subscribe to rendering and removal events
+    virtual void configure(ECS::World* world) override {
+      world->subscribe<GatherRenderablesEvent>(this);
+      world->subscribe<ECS::Events::OnComponentRemoved<Sprite>>(this);
+      world->subscribe<ECS::Events::OnComponentRemoved<Text>>(this);
+      world->subscribe<addDebugInfoEvent>(this);
+    }
+    virtual void unconfigure(ECS::World* world) override {
+      world->unsubscribe<GatherRenderablesEvent>(this);
+      world->unsubscribe<ECS::Events::OnComponentRemoved<Sprite>>(this);
+      world->unsubscribe<ECS::Events::OnComponentRemoved<Text>>(this);
+      world->unsubscribe<addDebugInfoEvent>(this);
+    }
+
+    // Add everything that overlaps the area to the batch
+    virtual void receive(ECS::World* world, const GatherRenderablesEvent& e) override {
+
+      // Only look at what the grids say could be on screen
+      spriteGrid_.query(e.area, [&](const ECS::EntityHandle& handle) {
+        ECS::Entity* ent = world->get(handle);
+        if (ent == nullptr || ent->isPendingDestroy()) { return; }
+        auto s = ent->get<Sprite>();
+        if (s.isValid() && s->getGlobalBounds().intersects(e.area)) { e.batch.add(s.get(), s->layer); }
+      });
+      textGrid_.query(e.area, [&](const ECS::EntityHandle& handle) {
+        ECS::Entity* ent = world->get(handle);
+        if (ent == nullptr || ent->isPendingDestroy()) { return; }
+        auto txt = ent->get<Text>();
+        if (txt.isValid() && txt->getGlobalBounds().intersects(e.area)) { e.batch.add(static_cast<const sf::Text&>(txt.get()), txt->layer); }
+      });
 
+      // UI is always on screen, and drawn over the world by widget layer
+      world->each<UIWidget, Sprite>([&](ECS::Entity* ent, ECS::ComponentHandle<UIWidget> w, ECS::ComponentHandle<Sprite> s) {
+        e.batch.add(s.get(), w->layer, true);
       });
+      world->each<UIWidget, Text>([&](ECS::Entity* ent, ECS::ComponentHandle<UIWidget> w, ECS::ComponentHandle<Text> txt) {
+        e.batch.add(static_cast<const sf::Text&>(txt.get()), w->layer, true);
+      });
+    }
+
+    // Stop tracking sprites and text when they're removed
+    virtual void receive(ECS::World* world, const ECS::Events::OnComponentRemoved<Sprite>& e) override {
+      spriteGrid_.remove(e.entity->getHandle());
+    }
+    virtual void receive(ECS::World* world, const ECS::Events::OnComponentRemoved<Text>& e) override {
+      textGrid_.remove(e.entity->getHandle());
+    }
+
+    // Show how much the grids are holding
+    virtual void receive(ECS::World* world, const addDebugInfoEvent& e) override {
+      ImGui::Begin("Debug");
+      ImGui::Text("Culling: %lu sprites in %lu cells, %lu text in %lu cells", 
+        spriteGrid_.getCount(), spriteGrid_.getCellCount(), textGrid_.getCount(), textGrid_.getCellCount());
+      ImGui::End();
     }
 
     // Convenience function for moving renderable objects
-    static void repositionTransformable(ECS::Entity* e, Transform& t, sf::Transformable* c) {
+    // Alpha is how far between the transform's previous and current state to place it
+    // Returns whether the renderable moved
+    static bool repositionTransformable(ECS::Entity* e, Transform& t, sf::Transformable* c, float alpha = 1.f) {
 
       // If the renderable is part of the UI, the transform acts as an offset
       sf::Vector2f offset = sf::Vector2f();
@@ -68,10 +168,59 @@ class RenderSystem : public ECS::EntitySystem {
         offset.y = center.y + (anchor.y * size.y * 0.5f);
       }
 
-      // Finally, move the renderable
-      c->setPosition(t.position + offset);
-      c->setRotation(t.rotation);
+      // Finally, move the renderable, noting whether that changed anything
+      const sf::Vector2f oldPosition = c->getPosition();
+      const float oldRotation = c->getRotation();
+      c->setPosition(t.getInterpolatedPosition(alpha) + offset);
+      c->setRotation(t.getInterpolatedRotation(alpha));
+      return c->getPosition() != oldPosition || c->getRotation() != oldRotation;
     }
+
+  private:
+
+    // A change to make to a culling grid once renderables have been moved
+    struct GridChange {
+      ECS::EntityHandle handle;
+      sf::FloatRect bounds;
+      bool remove;
+    };
+
+    // Queue a grid change if a renderable has left its cell, which is only checked if it moved or changed size
+    // UI follows the view so it's always drawn rather than tracked
+    // The grid is only read here, so this can be called while moving renderables on several threads
+    template<typename T>
+    void findGridChange(const SpatialGrid& grid, std::vector<GridChange>& changes, ECS::Entity* e, bool changed, const T& renderable) {
+      const ECS::EntityHandle handle = e->getHandle();
+      if (e->has<UIWidget>()) {
+        if (!grid.contains(handle)) { return; }
+        std::lock_guard<std::mutex> lock(changesMutex_);
+        changes.push_back({ handle, sf::FloatRect(), true });
+        return;
+      }
+      if (!changed && grid.contains(handle)) { return; }
+      const sf::FloatRect bounds = renderable.getGlobalBounds();
+      if (grid.isPlaced(handle, bounds)) { return; }
+      std::lock_guard<std::mutex> lock(changesMutex_);
+      changes.push_back({ handle, bounds, false });
+    }
+
+    // Make the changes found while moving renderables
+    static void applyGridChanges(SpatialGrid& grid, std::vector<GridChange>& changes) {
+      for (const auto& change : changes) {
+        if (change.remove) { grid.remove(change.handle); }
+        else { grid.update(change.handle, change.bounds); }
+      }
+      changes.clear();
+    }
+
+    // Where every sprite and text outside of the UI is, for culling
+    SpatialGrid spriteGrid_;
+    SpatialGrid textGrid_;
+
+    // Grid changes found this frame, kept to reuse their capacity
+    std::vector<GridChange> spriteChanges_;
+    std::vector<GridChange> textChanges_;
+    std::mutex changesMutex_;
 };
 
 #endif
@@ -12,6 +12,7 @@
 #include "Font.h"
 #include "Animation.h"
 #include "Spell.h"
+#include "PhysicsPrefab.h"
 
 // Get resource type from descriptor
 Resource::Resource(const std::string& fp)
@@ -68,6 +69,8 @@ Resource::get() {
       resource_ = new Animation(data.as<Animation>()); break;
     case Type::SPELL:
       resource_ = new Spell(data.as<Spell>()); break;
+    case Type::PHYSICS:
+      resource_ = new PhysicsPrefab(data.as<PhysicsPrefab>()); break;
     default:
       break;
   }
@@ -111,6 +114,8 @@ Resource::deleteResource() {
       delete static_cast<Animation*>(resource_); break;
     case Type::SPELL:
       delete static_cast<Spell*>(resource_); break;
+    case Type::PHYSICS:
+      delete static_cast<PhysicsPrefab*>(resource_); break;
     default:
       break;
   }
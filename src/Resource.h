@@ -17,7 +17,8 @@ class Resource {
       TEXTURE,
       FONT,
       ANIMATION,
-      SPELL
+      SPELL,
+      PHYSICS
     };
 
     // Constructors
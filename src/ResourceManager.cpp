@@ -20,6 +20,7 @@ ResourceManager::registerResourceTypes() {
   Game::lua.set("Resource_FONT", Resource::Type::FONT);
   Game::lua.set("Resource_ANIMATION", Resource::Type::ANIMATION);
   Game::lua.set("Resource_SPELL", Resource::Type::SPELL);
+  Game::lua.set("Resource_PHYSICS", Resource::Type::PHYSICS);
 }
 
 // Import all files from a folder
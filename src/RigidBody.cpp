@@ -5,10 +5,9 @@
 
 // Avoid cyclic dependancies
 #include "PhysicsSystem.h"
-#include "Combat.h"
 
 // Define statics
-b2World* RigidBody::worldToSpawnIn_ = nullptr;
+PhysicsSystem* RigidBody::systemToSpawnIn_ = nullptr;
 b2BodyDef RigidBody::defaultBodyDefinition_ = b2BodyDef();
 
 // Make a box shape
@@ -42,28 +41,36 @@ RigidBody::LineShape(float x1, float y1, float x2, float y2) {
 
 // Enable use of this component when physics system is enabled
 void 
-RigidBody::registerRigidBodyType(sol::environment& env, b2World* world) {
+RigidBody::registerRigidBodyType(sol::environment& env, PhysicsSystem* system) {
 
   // Debug message
   Console::log("Enabling usage of RigidBody components..");
 
-  // Set all future rigidbodies to use this world
+  // Set all future rigidbodies to use this system's world
   // This takes away the responsibility of the programmer to
   // pass the world around
-  worldToSpawnIn_ = world;
+  systemToSpawnIn_ = system;
+  b2World* world = system != nullptr ? system->getWorld() : nullptr;
 
   // Register the RigidBody only if there's a 'world'
-  if (worldToSpawnIn_ != nullptr) {
+  if (systemToSpawnIn_ != nullptr) {
 
     // Make this component scriptable
     Script::registerComponentToEntity<RigidBody>(env, "RigidBody");
 
+    // Bodies can also be assigned from a physics prefab, optionally scaled
+    sol::usertype<ECS::EntityHandle> entityType = Game::lua["Entity"];
+    entityType.set("assignRigidBody", sol::overload(
+      &Script::Funcs::assign<RigidBody>,
+      [](const ECS::EntityHandle& h, const std::string& name) -> RigidBody& { return assignFromPrefab(h, name, 1.f); },
+      &RigidBody::assignFromPrefab));
+
     // Create the RigidBody type
     env.new_usertype<RigidBody>("RigidBody",
       // Properties
       "type", sol::property(
         [](const RigidBody& self) {return self.body_->GetType();},
-        [](RigidBody& self, const b2BodyType& type) { self.body_->SetType(type);}),
+        [](RigidBody& self, const b2BodyType& type) { self.body_->SetType(type); self.wake();}),
       "gravity", sol::property(
         [](const RigidBody& self) {return self.body_->GetGravityScale();},
         [](RigidBody& self, float g) {self.body_->SetGravityScale(g);}),
@@ -94,9 +101,13 @@ RigidBody::registerRigidBodyType(sol::environment& env, b2World* world) {
 
   // Define mouse joint creation
   env.set_function("createMouseJoint", 
-      [world](const b2MouseJointDef& def){return (b2MouseJoint*) world->CreateJoint(&def);});
+      [system, world](const b2MouseJointDef& def){
+        system->wakeBody(def.bodyB);
+        return (b2MouseJoint*) world->CreateJoint(&def);});
   env.new_usertype<b2MouseJoint>("MouseJoint",
-   "destroy", [world](b2MouseJoint& self){world->DestroyJoint(&self);},
+   "destroy", [system, world](b2MouseJoint& self){
+     system->wakeBody(self.GetBodyB());
+     world->DestroyJoint(&self);},
    "getAnchorA", &b2MouseJoint::GetAnchorA,
    "getAnchorB", &b2MouseJoint::GetAnchorB,
    "frequency", sol::property(&b2MouseJoint::GetFrequency, &b2MouseJoint::SetFrequency),
@@ -104,13 +115,15 @@ RigidBody::registerRigidBodyType(sol::environment& env, b2World* world) {
    "dampingRatio", sol::property(&b2MouseJoint::GetDampingRatio, &b2MouseJoint::SetDampingRatio),
    "target", sol::property(
      [](const b2MouseJoint& self) {return PhysicsSystem::convertToSF(self.GetTarget());},
-     [](b2MouseJoint& self, const sf::Vector2f& target) {self.SetTarget(PhysicsSystem::convertToB2(target));})
+     [system](b2MouseJoint& self, const sf::Vector2f& target) {
+       self.SetTarget(PhysicsSystem::convertToB2(target));
+       system->wakeBody(self.GetBodyB());})
   );
 }
 
 // Register functions that don't need a physics world
 void
-RigidBody::registerNonDependantTypes(sol::environment& env) {
+RigidBody::registerNonDependantTypes() {
 
   // Create the BodyDef type
   Game::lua.new_usertype<b2BodyDef>("BodyDef",
@@ -171,39 +184,89 @@ RigidBody::registerNonDependantTypes(sol::environment& env) {
 // Constructor
 RigidBody::RigidBody(ECS::Entity* e)
   : Component(e)
-  , physics_(worldToSpawnIn_)
+  , system_(systemToSpawnIn_)
+  , physics_(system_->getWorld())
   , body_(physics_->CreateBody(&defaultBodyDefinition_))
-  , previousPosition_(b2Vec2(0.0f, 0.0f))
-  , previousAngle_(0.0f) 
-  , isOutOfSync_(true) 
+  , isOutOfSync_(false) 
+  , isActive_(false)
   , underfootContacts_(0) {
   
   // Ensure this body contains the RigidBody
   body_->SetUserData(this);
+
+  // Move the body to the transform before it's first simulated
+  markOutOfSync();
 }
 
-// Ensure that every RigidBody has its own b2Body during copy
-RigidBody::RigidBody(const RigidBody& other)
+// Create the b2Body from a prefab, with every fixture already attached
+RigidBody::RigidBody(ECS::Entity* e, const PhysicsPrefab& prefab, float scale)
+  : Component(e)
+  , system_(systemToSpawnIn_)
+  , physics_(system_->getWorld())
+  , body_(prefab.createBody(*physics_, scale))
+  , isOutOfSync_(false)
+  , isActive_(false)
+  , underfootContacts_(0) {
+
+  // Ensure this body contains the RigidBody
+  body_->SetUserData(this);
+  if (prefab.hasGroundSensor()) {
+    makeGroundSensor();
+  }
+
+  // Move the body to the transform before it's first simulated
+  markOutOfSync();
+}
+
+// Take the b2Body of a RigidBody that's being moved to another row of its archetype
+// Components built while changes are deferred are moved in once they're assigned, so their bodies are only made once
+RigidBody::RigidBody(RigidBody&& other)
   : Component(other)
-  , physics_(other.worldToSpawnIn_)
-  , body_(physics_->CreateBody(&defaultBodyDefinition_))
-  , previousPosition_(other.previousPosition_)
-  , previousAngle_(other.previousAngle_)
+  , system_(other.system_)
+  , physics_(other.physics_)
+  , body_(other.body_)
   , isOutOfSync_(other.isOutOfSync_)
+  , isActive_(other.isActive_)
   , underfootContacts_(other.underfootContacts_) {
 
   // Ensure this body contains the RigidBody
-  body_->SetUserData(this);
+  other.body_ = nullptr;
+  if (body_ != nullptr) {
+    body_->SetUserData(this);
+  }
+
+  // The physics system queues entities rather than RigidBodies, so this one takes over wherever the other was queued
+  // Components move whenever their entity changes archetype, so moving mustn't wake or teleport the body
+  other.isOutOfSync_ = false;
+  other.isActive_ = false;
+}
+
+// Replace this RigidBody's b2Body with one that's going away
+RigidBody&
+RigidBody::operator= (RigidBody&& other) {
+  if (this == &other) { return *this; }
+
+  // Have the physics system destroy the old body before the next step
+  if (body_ != nullptr) {
+    system_->disposeBody(body_);
+  }
+
+  // Take the other body
+  body_ = other.body_;
+  other.body_ = nullptr;
+  if (body_ != nullptr) {
+    body_->SetUserData(this);
+  }
+  underfootContacts_ = other.underfootContacts_;
+  markOutOfSync();
+  return *this;
 }
 
 // Delete this RigidBody's b2Body
 RigidBody::~RigidBody() {
   if (body_ != nullptr) {
     body_->SetUserData(nullptr);
-    b2World* world = body_->GetWorld();
-    if (world != nullptr) {
-      world->DestroyBody(body_);
-    }
+    system_->destroyBody(body_);
     body_ = nullptr;
   }
 }
@@ -212,10 +275,12 @@ RigidBody::~RigidBody() {
 void
 RigidBody::instantiateBody(const b2BodyDef& def) {
 
-  // If the body already exists, destroy it
+  // If the body already exists, have the physics system destroy it before the next step
+  // It has no contacts with the new body, so the ground sensor count starts again
   if (body_ != nullptr) {
-   disposeList_.push_back(body_);
-   body_ = nullptr;
+    system_->disposeBody(body_);
+    body_ = nullptr;
+    underfootContacts_ = 0;
   }
 
   // Create a new body out of the new definitions
@@ -223,7 +288,7 @@ RigidBody::instantiateBody(const b2BodyDef& def) {
   body_->SetUserData(this);
 
   // Mark this RididBody as out of sync with it's transform
-  isOutOfSync_ = true;
+  markOutOfSync();
 }
 
 // Add a fixture to this RigidBody
@@ -244,6 +309,12 @@ RigidBody::getMass() const {
   return body_->GetMass();
 }
 
+// Get the entity this body belongs to
+ECS::EntityHandle
+RigidBody::getEntity() const {
+  return owner_->getHandle();
+}
+
 // Warp somewhere instantaneously
 void 
 RigidBody::warpTo(float x, float y) {
@@ -253,6 +324,7 @@ void
 RigidBody::warpToVec(const sf::Vector2f& dest) {
   body_->SetTransform(PhysicsSystem::convertToB2(dest), body_->GetAngle());
   body_->SetLinearVelocity(b2Vec2(0,0));
+  wake();
 }
 
 // Set linear velocity to RigidBody
@@ -263,6 +335,7 @@ RigidBody::setLinearVelocity(float i, float j) {
 void
 RigidBody::setLinearVelocityVec(const sf::Vector2f& vel) {
   body_->SetLinearVelocity(PhysicsSystem::convertToB2(vel));
+  wake();
 }
 
 // Get linear velocity
@@ -279,6 +352,7 @@ RigidBody::applyForceToCentre(float i, float j) {
 void 
 RigidBody::applyForceToCentreVec(const sf::Vector2f& force) {
   body_->ApplyForceToCenter(PhysicsSystem::convertToB2(force), true);
+  wake();
 }
 
 // Apply a force relative to the body's centre
@@ -289,6 +363,7 @@ RigidBody::applyForceRel(float i, float j, float x, float y) {
 void 
 RigidBody::applyForceRelVec(const sf::Vector2f& force, const sf::Vector2f& relPos) {
   body_->ApplyForce(PhysicsSystem::convertToB2(force), body_->GetWorldPoint(PhysicsSystem::convertToB2(relPos)), true);
+  wake();
 }
 
 // Apply a force to this body from somewhere
@@ -299,6 +374,7 @@ RigidBody::applyForce(float i, float j, float x, float y) {
 void 
 RigidBody::applyForceVec(const sf::Vector2f& force, const sf::Vector2f& location) {
   body_->ApplyForce(PhysicsSystem::convertToB2(force), PhysicsSystem::convertToB2(location), true);
+  wake();
 }
 
 // Apply an impulse to the RigidBody
@@ -309,6 +385,7 @@ RigidBody::applyImpulseToCentre(float i, float j) {
 void 
 RigidBody::applyImpulseToCentreVec(const sf::Vector2f& impulse) {
   body_->ApplyLinearImpulse(PhysicsSystem::convertToB2(impulse), body_->GetWorldCenter(), true);
+  wake();
 }
 
 // Apply an impulse relative to the body's centre
@@ -319,6 +396,7 @@ RigidBody::applyImpulseRel(float i, float j, float x, float y) {
 void
 RigidBody::applyImpulseRelVec(const sf::Vector2f& impulse, const sf::Vector2f& relPos) {
   body_->ApplyLinearImpulse(PhysicsSystem::convertToB2(impulse), body_->GetWorldPoint(PhysicsSystem::convertToB2(relPos)), true);
+  wake();
 }
 
 // Apply an impulse to this body from somewhere
@@ -329,33 +407,7 @@ RigidBody::applyImpulse(float i, float j, float x, float y) {
 void
 RigidBody::applyImpulseVec(const sf::Vector2f& impulse, const sf::Vector2f& location) {
   body_->ApplyLinearImpulse(PhysicsSystem::convertToB2(impulse), PhysicsSystem::convertToB2(location), true);
-}
-
-// When contact starts
-void
-RigidBody::startContact(const FixtureType& type, RigidBody* other, double impact) {
-
-  // Check type of fixture that was triggered 
-  if (type == FixtureType::GroundSensor) {
-    ++underfootContacts_;
-    return;
-  }
-
-  // If entity has a combat component, deal impact damage
-  if (owner_->has<Combat>()) {
-    auto cb = owner_->get<Combat>();
-    cb->dealImpactDamage(impact);
-  }
-}
-// When contact ends
-void
-RigidBody::endContact(const FixtureType& type, RigidBody* other) {
-
-  // Check type of fixture that was triggered 
-  if (type == FixtureType::GroundSensor) {
-    --underfootContacts_;
-    return;
-  }
+  wake();
 }
 
 // Create default sensor
@@ -372,3 +424,31 @@ RigidBody::makeGroundSensor() {
   // Ensure the sensor knows about this rigidbody
   groundSensor->SetUserData((void*)FixtureType::GroundSensor);
 }
+
+// Assign a RigidBody to an entity from a prefab resource, or an empty one if there's no such prefab
+RigidBody&
+RigidBody::assignFromPrefab(const ECS::EntityHandle& handle, const std::string& name, float scale) {
+  ECS::Entity* e = Script::Funcs::resolve(handle);
+  const PhysicsPrefab* prefab = PhysicsPrefab::getFromResources(name);
+  if (prefab == nullptr) {
+    return e->assign<RigidBody>(e).get();
+  }
+  return e->assign<RigidBody>(e, *prefab, scale).get();
+}
+
+// Ask the physics system to move the b2Body to the transform before the next step
+void
+RigidBody::markOutOfSync() {
+  if (!isOutOfSync_) {
+    isOutOfSync_ = true;
+    system_->syncBody(owner_->getHandle());
+  }
+}
+
+// Ask the physics system to check this body before the next step
+void
+RigidBody::wake() {
+  if (!isActive_) {
+    system_->wakeBody(owner_->getHandle());
+  }
+}
@@ -7,6 +7,7 @@
 #include "Game.h"
 #include "Scripting.h"
 #include "ContactListener.h"
+#include "PhysicsPrefab.h"
 #include <Box2D/Box2D.h>
 #include <vector>
 
@@ -23,14 +24,20 @@ class RigidBody : Component{
     static b2EdgeShape LineShape(float x1, float y1, float x2, float y2);
 
     // Make this component scriptable
-    static void registerRigidBodyType(sol::environment& env, b2World* world);
-    static void registerNonDependantTypes(sol::environment& env);
+    static void registerRigidBodyType(sol::environment& env, PhysicsSystem* system);
+    static void registerNonDependantTypes();
 
     // Constructor
     RigidBody(ECS::Entity* e);
 
-    // Ensure that every RigidBody has its own b2Body during copy
-    RigidBody(const RigidBody& other);
+    // Create the b2Body from a prefab, with every fixture already attached
+    RigidBody(ECS::Entity* e, const PhysicsPrefab& prefab, float scale = 1.f);
+
+    // Copying can't duplicate the b2Body and its fixtures, so RigidBodies can only be moved
+    RigidBody(const RigidBody& other) = delete;
+
+    // Take the b2Body of a RigidBody that's going away, such as one built before being assigned
+    RigidBody(RigidBody&& other);
 
     // Delete this RigidBody's b2Body
     ~RigidBody();
@@ -47,6 +54,9 @@ class RigidBody : Component{
     // Get the mass of this body
     float getMass() const;
 
+    // Get the entity this body belongs to
+    ECS::EntityHandle getEntity() const;
+
     // Warp this entity to a location instantaneously
     void warpTo(float x, float y);
     void warpToVec(const sf::Vector2f& dest);
@@ -82,18 +92,10 @@ class RigidBody : Component{
     void applyImpulse(float i, float j, float x, float y);
     void applyImpulseVec(const sf::Vector2f& impulse, const sf::Vector2f& location);
 
-    // On collide 
-    void startContact(const FixtureType& type, RigidBody* other, double impact);
-    void endContact(const FixtureType& type, RigidBody* other);
-
-    // We have static operators so this operator must be defined
-    void operator= (const RigidBody& other) { 
-       body_ = other.body_;
-       previousPosition_ = other.previousPosition_;
-       previousAngle_ = other.previousAngle_;
-       isOutOfSync_ = other.isOutOfSync_;
-       underfootContacts_ = other.underfootContacts_;
-    }
+    RigidBody& operator= (const RigidBody& other) = delete;
+
+    // Replace this RigidBody's b2Body with one that's going away, such as when a component is assigned again
+    RigidBody& operator= (RigidBody&& other);
 
     // Shows the debug information to ImGui
     void showDebugInformation() {
@@ -111,28 +113,34 @@ class RigidBody : Component{
     // Default body definition to use
     static b2BodyDef defaultBodyDefinition_;
 
-    // The world of this object, not to be confused with the ECS world
-    static b2World* worldToSpawnIn_;
+    // The physics system and world of this object, not to be confused with the ECS world
+    static PhysicsSystem* systemToSpawnIn_;
+    PhysicsSystem* const system_;
     b2World* const physics_;
 
     // The encapsulated body of this object
     b2Body* body_;
 
-    // Manipulated by physics system
-    b2Vec2 previousPosition_;
-    float previousAngle_;
-
-    // List of b2Bodys to destroy
-    std::vector<b2Body*> disposeList_;
-
     // Marks whether this b2Body's position is out of sync with transform
     bool isOutOfSync_;
 
+    // Whether the physics system is moving this entity's transform after each step
+    bool isActive_;
+
     // How many sensors are underfoot
     int underfootContacts_;
 
     // Make a sensor for detecting the ground
     void makeGroundSensor();
+
+    // Assign a RigidBody to an entity from a prefab resource, or an empty one if there's no such prefab
+    static RigidBody& assignFromPrefab(const ECS::EntityHandle& handle, const std::string& name, float scale);
+
+    // Ask the physics system to move the b2Body to the transform before the next step
+    void markOutOfSync();
+
+    // Ask the physics system to check this body before the next step, as it may have been woken up or moved
+    void wake();
 };
 
 #endif
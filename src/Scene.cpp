@@ -3,8 +3,11 @@
 
 #include "Scene.h"
 
+#include <algorithm>
+
 // Avoid cyclic dependencies
 #include "ControlSystem.h"
+#include "RenderSystem.h"
 #include "Transform.h"
 #include "Sprite.h"
 #include "Text.h"
@@ -18,6 +21,21 @@
 #include "Abilities.h"
 #include "Combat.h"
 
+// Levels of adaptive simulation, from full quality down
+// Systems scale their work by the quality, such as the physics solver's iterations, and steps are made longer
+// Cost is roughly how much simulating takes compared to full quality, to guess whether raising quality would fit
+struct SimulationLevel {
+  float quality;
+  float stepScale;
+  float cost;
+};
+static const SimulationLevel simulationLevels[] = {
+  { 1.f, 1.f, 1.f },
+  { 0.5f, 1.f, 0.6f },
+  { 0.5f, 2.f, 0.3f }
+};
+static const unsigned simulationLevelCount = sizeof(simulationLevels) / sizeof(SimulationLevel);
+
 // Register scene functionality to Lua
 void
 Scene::registerSceneType() {
@@ -27,15 +45,32 @@ Scene::registerSceneType() {
     "onShow", &Scene::onShow_,
     "onHide", &Scene::onHide_,
     "onUpdate", &Scene::onUpdate_,
+    "onFixedUpdate", &Scene::onFixedUpdate_,
     "onWindowEvent", &Scene::onWindowEvent_,
-    "onQuit", &Scene::onQuit_
+    "onQuit", &Scene::onQuit_,
+    "simulationRate", sol::property(
+      [](const Scene& self) { return self.simulationRate_; },
+      &Scene::setSimulationRate),
+    "maxSimulationSteps", sol::property(
+      [](const Scene& self) { return self.maxSimulationSteps_; },
+      &Scene::setMaxSimulationSteps),
+    "adaptiveSimulation", sol::property(
+      &Scene::isAdaptiveSimulation,
+      &Scene::setAdaptiveSimulation)
   );
 }
 
 // Constructor
 Scene::Scene ()
   : hasBegun_(false)
-  , world_(ECS::World::createWorld()) {
+  , world_(ECS::World::createWorld())
+  , interpolation_(1.f)
+  , simulationRate_(0.f)
+  , maxSimulationSteps_(0)
+  , adaptiveSimulation_(false)
+  , simulationLevel_(0)
+  , snapshotSprites_(0)
+  , snapshotDrawCalls_(0) {
 }
 
 // Copy constructor
@@ -46,12 +81,21 @@ Scene::Scene(const Scene& other)
   , onShow_(other.onShow_)
   , onHide_(other.onHide_)
   , onUpdate_(other.onUpdate_)
+  , onFixedUpdate_(other.onFixedUpdate_)
   , onWindowEvent_(other.onWindowEvent_)
-  , onQuit_(other.onQuit_) {
+  , onQuit_(other.onQuit_)
+  , interpolation_(1.f)
+  , simulationRate_(other.simulationRate_)
+  , maxSimulationSteps_(other.maxSimulationSteps_)
+  , adaptiveSimulation_(other.adaptiveSimulation_)
+  , simulationLevel_(0)
+  , snapshotSprites_(0)
+  , snapshotDrawCalls_(0) {
 }
 
 // Destructor
 Scene::~Scene() {
+  syncBackgroundWork();
   world_->destroyWorld();
 }
 
@@ -80,12 +124,20 @@ Scene::registerFunctions() {
   lua_ = sol::environment(Game::lua, sol::create, Game::lua.globals());
   Script::registerSceneFunctions(lua_, world_);
 
+  // Let scripts tune the simulation while the scene runs
+  lua_.set_function("setSimulationRate", [this](float rate) { setSimulationRate(rate); });
+  lua_.set_function("setMaxSimulationSteps", [this](unsigned steps) { setMaxSimulationSteps(steps); });
+  lua_.set_function("setAdaptiveSimulation", [this](bool enable) { setAdaptiveSimulation(enable); });
+
   // Expose the world in the scene
   Game::lua["World"] = lua_;
 
   // Add to autocomplete
   Console::addCommand("[Class] World");
   Console::addCommand("World.createEntity");
+  Console::addCommand("World.setSimulationRate");
+  Console::addCommand("World.setMaxSimulationSteps");
+  Console::addCommand("World.setAdaptiveSimulation");
 }
 
 // When the screen is shown
@@ -110,6 +162,7 @@ Scene::showScene() {
 // When the screen is hidden
 void
 Scene::hideScene() {
+  syncBackgroundWork();
   if (onHide_.valid()) {
     auto attempt = onHide_();
     if (!attempt.valid()) {
@@ -122,9 +175,14 @@ Scene::hideScene() {
 // Update the game every frame
 void
 Scene::update(const sf::Time& dt) {
+  PROFILE_SCOPE("Scene::update");
+
+  // Anything left running in the background last frame has to finish before scripts run
+  syncBackgroundWork();
 
   // Call scene's update script
   if (onUpdate_.valid()) {
+    PROFILE_SCOPE("Scene::onUpdate");
     auto attempt = onUpdate_(dt);
     if (!attempt.valid()) {
       sol::error err = attempt;
@@ -132,43 +190,129 @@ Scene::update(const sf::Time& dt) {
     }
   }
 
-  // Update the ECS
-  world_->update(dt);
+  // Simulate in fixed steps, however long the frame took
+  // If we fall too far behind, drop the extra time rather than taking ever more steps to catch up
+  const sf::Time step = getSimulationStep();
+  const unsigned maxSteps = getMaxSimulationSteps();
+  sf::Clock simulationClock;
+  simulationAccumulator_ += dt;
+  unsigned steps = 0;
+  while (simulationAccumulator_ >= step && steps < maxSteps) {
+    fixedUpdate(step);
+    simulationAccumulator_ -= step;
+    ++steps;
+  }
+  const sf::Time spent = simulationClock.getElapsedTime();
+  simulationStats_.step = step;
+  simulationStats_.maxSteps = maxSteps;
+  simulationStats_.steps = steps;
+  simulationStats_.backlog = simulationAccumulator_;
+  simulationStats_.clamped = simulationAccumulator_ >= step;
+  if (simulationStats_.clamped) {
+    ++simulationStats_.clampedUpdates;
+    simulationStats_.dropped += simulationAccumulator_;
+    simulationAccumulator_ = sf::Time::Zero;
+  }
+
+  // Lower or raise quality if the simulation is struggling or has room again
+  if (adaptiveSimulation_) {
+    adaptSimulation(dt, spent);
+  }
+  interpolation_ = simulationAccumulator_ / step;
+
+  // Present the simulation, interpolating between the last two steps
+  world_->updateGroup((unsigned)UpdateGroup::Presentation, dt);
+
+  // Nothing else touches the simulation until the next sync, so work can carry on while the frame renders
+  world_->emit<BackgroundWorkStartEvent>({});
+
+  // Let the renderer see the result
+  if (!Game::isHeadless()) {
+    publishSnapshot();
+  }
 }
 
-// Render the game every frame
+// Advance the simulation by a single step
 void
-Scene::render(sf::RenderWindow& window) {
+Scene::fixedUpdate(const sf::Time& step) {
+  PROFILE_SCOPE("Scene::fixedUpdate");
 
-  // Ensure the drawList_ is cleared
-  drawList_.clear();
-
-  // Get every entity with a sprite and add to draw queue
-  world_->each<Sprite>([&](ECS::Entity* e, ECS::ComponentHandle<Sprite> c) {
-    drawList_.insert(std::make_pair(0, static_cast<const sf::Drawable*>(&c.get())));
+  // Remember where everything was, so rendering can interpolate towards where it ends up
+  world_->parallelEach<Transform>([](ECS::Entity* e, ECS::ComponentHandle<Transform> t) {
+    t->recordPrevious();
   });
 
-  // Add text to draw queue
-  world_->each<Text>([&](ECS::Entity* e, ECS::ComponentHandle<Text> c) {
-    drawList_.insert(std::make_pair(0, static_cast<const sf::Drawable*>(&c.get())));
-  });
+  // Call scene's fixed update script
+  if (onFixedUpdate_.valid()) {
+    PROFILE_SCOPE("Scene::onFixedUpdate");
+    auto attempt = onFixedUpdate_(step);
+    if (!attempt.valid()) {
+      sol::error err = attempt;
+      Console::log("[Error] in Scene.fixedUpdate():\n> %s", err.what());
+    }
+  }
 
-  // Render everything in the queue, smallest first
-  for (auto it = drawList_.begin(); it != drawList_.end(); ++it) {
-    const sf::Drawable* const obj = it->second;
-    if (obj != nullptr) { window.draw(*obj); }
+  // Update the gameplay systems
+  world_->updateGroup((unsigned)UpdateGroup::Simulation, step);
+}
+
+// Copy what should be drawn out of the world and hand it to the renderer
+void
+Scene::publishSnapshot() {
+  PROFILE_SCOPE("Scene::publishSnapshot");
+
+  // Fill in the buffer the renderer isn't using
+  RenderSnapshot& snapshot = snapshots_.getWriteBuffer();
+  snapshot.view = Game::view;
+
+  // Collect whatever is within the view
+  snapshot.batch.clear();
+  const sf::Vector2f size = Game::view.getSize();
+  const sf::FloatRect area(Game::view.getCenter() - size * 0.5f, size);
+  world_->emit<GatherRenderablesEvent>({ area, snapshot.batch });
+
+  // Sort by layer and texture, so sprites sharing a texture are rendered together
+  snapshot.batch.build();
+  snapshotSprites_ = snapshot.batch.getSpriteCount();
+  snapshotDrawCalls_ = snapshot.batch.getDrawCallCount();
+
+  // Record any debug-only rendering
+  snapshot.debugLines.clear();
+  snapshot.debugTriangles.clear();
+  if (Game::getDebugMode()) {
+    world_->emit<DebugRenderPhysicsEvent>({ snapshot.debugLines, snapshot.debugTriangles });
   }
+
+  // Hand it over
+  snapshots_.publish();
+}
+
+// Render the game every frame
+void
+Scene::render(sf::RenderWindow& window) {
+  PROFILE_SCOPE("Scene::render");
+
+  // Take the latest snapshot, or draw the last one again if nothing new has been published
+  // The world may be updating at the same time, so only the snapshot can be used here
+  snapshots_.acquire();
+  const RenderSnapshot& snapshot = snapshots_.getReadBuffer();
+
+  // Render everything using the view it was collected with
+  window.setView(snapshot.view);
+  window.draw(snapshot.batch);
   
   // Do any debug-only rendering
-  if (Game::getDebugMode()) {
-    world_->emit<DebugRenderPhysicsEvent>({window});
-  }
+  if (snapshot.debugTriangles.getVertexCount() > 0) { window.draw(snapshot.debugTriangles); }
+  if (snapshot.debugLines.getVertexCount() > 0) { window.draw(snapshot.debugLines); }
 }
 
 // Handle keypresses
 void
 Scene::handleEvent(const sf::Event& event) {
 
+  // Scripts may touch the world
+  syncBackgroundWork();
+
   // Send event to control system
   ControlSystem::handleInput(event);
 
@@ -185,6 +329,7 @@ Scene::handleEvent(const sf::Event& event) {
 // When the game is quit
 void
 Scene::quit() {
+  syncBackgroundWork();
   bool quitAnyway = !onQuit_.valid();
   if (!quitAnyway) {
     auto attempt = onQuit_();
@@ -207,6 +352,117 @@ Scene::getWorld() {
   return world_;
 }
 
+// Wait for any work the world is doing in the background
+void
+Scene::syncBackgroundWork() {
+  world_->emit<BackgroundWorkSyncEvent>({});
+}
+
+// Get how far rendering is between the last two simulation steps
+float
+Scene::getInterpolation() const {
+  return interpolation_;
+}
+
+// Get how the simulation is keeping up
+const SimulationStats&
+Scene::getSimulationStats() const {
+  return simulationStats_;
+}
+
+// Set how many steps to simulate each second, zero uses the game's
+void
+Scene::setSimulationRate(float rate) {
+  simulationRate_ = std::max(rate, 0.f);
+}
+
+// Set how many steps can be taken in one update, zero uses the game's
+void
+Scene::setMaxSimulationSteps(unsigned steps) {
+  maxSimulationSteps_ = steps;
+}
+
+// Get how long each step is, including any adaptive changes
+// Headless ticks are each a single step of the game's timestep, so runs stay reproducible whatever the scene asks for
+sf::Time
+Scene::getSimulationStep() const {
+  if (Game::isHeadless()) { return Game::getSimulationStep(); }
+  const sf::Time step = simulationRate_ > 0.f ? sf::seconds(1.f / simulationRate_) : Game::getSimulationStep();
+  return step * simulationLevels[simulationLevel_].stepScale;
+}
+
+// Get how many steps can be taken in one update
+unsigned
+Scene::getMaxSimulationSteps() const {
+  return maxSimulationSteps_ > 0 ? maxSimulationSteps_ : Game::getMaxSimulationSteps();
+}
+
+// Trade simulation quality for speed when the scene can't keep up
+// Turning it off goes straight back to full quality
+void
+Scene::setAdaptiveSimulation(bool enable) {
+  if (enable && Game::isHeadless()) {
+    Console::log("[Note] Adaptive simulation is not used when headless, as it would make runs unreproducible.");
+    return;
+  }
+  adaptiveSimulation_ = enable;
+  simulationStats_.load = 0.f;
+  if (!enable && simulationLevel_ != 0) {
+    setSimulationLevel(0);
+  }
+}
+
+// Check whether adaptive simulation is on
+bool
+Scene::isAdaptiveSimulation() const {
+  return adaptiveSimulation_;
+}
+
+// Change quality as the share of each update spent simulating rises and falls
+// Quality drops when simulating takes most of each update, and only rises once the guessed cost at the higher level
+// leaves plenty of room, and never within a second of the last change, so it doesn't flip back and forth
+// This measures real time, so it's never enabled when headless
+void
+Scene::adaptSimulation(const sf::Time& dt, const sf::Time& spent) {
+  if (dt <= sf::Time::Zero) { return; }
+
+  // Smooth the load so a single slow update doesn't change anything
+  const float load = std::min(spent / dt, 2.f);
+  simulationStats_.load += (load - simulationStats_.load) * 0.1f;
+  timeAtLevel_ += dt;
+  if (timeAtLevel_ < sf::seconds(1.f)) { return; }
+
+  // Lower quality when falling behind, or raise it if it'd still fit
+  const float current = simulationStats_.load;
+  const SimulationLevel& level = simulationLevels[simulationLevel_];
+  if ((current > 0.75f || simulationStats_.clamped) && simulationLevel_ + 1 < simulationLevelCount) {
+    setSimulationLevel(simulationLevel_ + 1);
+  }
+  else if (simulationLevel_ > 0 && current * simulationLevels[simulationLevel_ - 1].cost / level.cost < 0.5f) {
+    setSimulationLevel(simulationLevel_ - 1);
+  }
+}
+
+// Change the level of adaptive simulation, telling systems about the new quality
+void
+Scene::setSimulationLevel(unsigned level) {
+  Console::log("[Note] Simulation quality %s to level %u.", level > simulationLevel_ ? "lowered" : "raised", level);
+  simulationLevel_ = level;
+  timeAtLevel_ = sf::Time::Zero;
+  simulationStats_.quality = simulationLevels[level].quality;
+  world_->emit<SimulationQualityEvent>({ simulationStats_.quality });
+}
+
+// Log statistics for the scene and have its systems do the same
+void
+Scene::reportStats() {
+  syncBackgroundWork();
+  Console::log("Simulation: %u updates hit the step limit, dropping %.3fs.",
+    simulationStats_.clampedUpdates,
+    simulationStats_.dropped.asSeconds());
+  world_->emit<ReportStatsEvent>({});
+}
+
 /////////////////////
 // DEBUG FUNCTIONS //
 /////////////////////
@@ -230,6 +486,23 @@ Scene::addDebugInfoToDefault() {
   // Add to default window
   ImGui::Begin("Debug");
   ImGui::Text("Entities in system: %lu", world_->getCount());
+
+  // Show how the world's pools are being used
+  if (ImGui::CollapsingHeader("ECS Pools")) {
+    const ECS::PoolStats entities = world_->getEntityPoolStats();
+    const ECS::PoolStats components = world_->getComponentPoolStats();
+    ImGui::Text("Entities: %lu live / %lu slots in %lu chunks", entities.live, entities.capacity, entities.chunks);
+    ImGui::Text("Entity slots reused: %lu", entities.reused);
+    ImGui::Text("Components: %lu live / %lu slots in %lu chunks", components.live, components.capacity, components.chunks);
+    ImGui::Text("Component slots reused: %lu", components.reused);
+    ImGui::Text("Archetypes: %lu", world_->getArchetypeCount());
+  }
+
+  // Show how well sprites are being batched
+  if (ImGui::CollapsingHeader("Rendering")) {
+    ImGui::Text("Sprites: %u", snapshotSprites_);
+    ImGui::Text("Draw calls: %u", snapshotDrawCalls_);
+  }
   ImGui::End();
 
   // Show the entity viewer
@@ -244,7 +517,7 @@ Scene::addDebugInfoToDefault() {
     for (ECS::Entity* e : world_->all()) {
       auto id = e->getEntityId();
 
-      ImGui::PushID(id);
+      ImGui::PushID(e->getHandle().getIndex());
       ImGui::AlignTextToFramePadding();
 
       bool node_open = ImGui::TreeNode("Entity", "%s_%lu", "Entity", id);
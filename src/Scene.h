@@ -6,11 +6,12 @@
 
 #include <string>
 #include <memory>
-#include <map>
 
 #include "Game.h"
 #include "Scripting.h"
 #include "PhysicsSystem.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
 
 // Represents it's own world of objects
 class Scene {
@@ -32,6 +33,7 @@ class Scene {
     void begin();
     void registerFunctions();
     void update(const sf::Time& dt);
+    void fixedUpdate(const sf::Time& step);
     void render(sf::RenderWindow& window);
     void handleEvent(const sf::Event& event);
     void showScene();
@@ -41,6 +43,33 @@ class Scene {
     // Get this scene's world
     ECS::World* getWorld();
 
+    // Wait for any work the world is doing in the background
+    // Call before touching the world from outside of an update
+    void syncBackgroundWork();
+
+    // Get how far rendering is between the last two simulation steps, from 0 to 1
+    float getInterpolation() const;
+
+    // Get how the simulation is keeping up
+    const SimulationStats& getSimulationStats() const;
+
+    // Set how many steps to simulate each second and how many can be taken in one update, zero uses the game's
+    // The rate is ignored when headless, where each tick is one step of the game's timestep
+    void setSimulationRate(float rate);
+    void setMaxSimulationSteps(unsigned steps);
+
+    // Get how long each step is and how many can be taken in one update, including any adaptive changes
+    sf::Time getSimulationStep() const;
+    unsigned getMaxSimulationSteps() const;
+
+    // Trade simulation quality for speed when the scene can't keep up, restoring it when there's room
+    // This can't be enabled when headless
+    void setAdaptiveSimulation(bool enable);
+    bool isAdaptiveSimulation() const;
+
+    // Log statistics for the scene and have its systems do the same
+    void reportStats();
+
     // Add a menu entry to the debug menu
     void addDebugMenuEntries();
 
@@ -63,11 +92,43 @@ class Scene {
     sol::protected_function onShow_;
     sol::protected_function onHide_;
     sol::protected_function onUpdate_;
+    sol::protected_function onFixedUpdate_;
     sol::protected_function onWindowEvent_;
     sol::protected_function onQuit_;
 
-    // Ordered collection of things to render
-    std::multimap<int, const sf::Drawable*> drawList_;
+    // Time waiting to be simulated, always less than a simulation step after updating
+    sf::Time simulationAccumulator_;
+
+    // How far rendering is between the last two simulation steps
+    float interpolation_;
+
+    // How the simulation is keeping up
+    SimulationStats simulationStats_;
+
+    // This scene's simulation rate and step limit, zero uses the game's
+    float simulationRate_;
+    unsigned maxSimulationSteps_;
+
+    // Whether adaptive simulation is on, how far the quality has been lowered, and how long it's been at that level
+    bool adaptiveSimulation_;
+    unsigned simulationLevel_;
+    sf::Time timeAtLevel_;
+
+    // Change quality as the share of each update spent simulating rises and falls
+    void adaptSimulation(const sf::Time& dt, const sf::Time& spent);
+
+    // Change the level of adaptive simulation, telling systems about the new quality
+    void setSimulationLevel(unsigned level);
+
+    // Snapshots of what to render, written after each update and drawn by the renderer
+    TripleBuffer<RenderSnapshot> snapshots_;
+
+    // Size of the last snapshot, for debugging
+    unsigned snapshotSprites_;
+    unsigned snapshotDrawCalls_;
+
+    // Copy what should be drawn out of the world and hand it to the renderer
+    void publishSnapshot();
 };
 
 #endif
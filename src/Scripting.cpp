@@ -18,6 +18,7 @@
 #include "Text.h"
 #include "UIWidget.h"
 #include "RigidBody.h"
+#include "PhysicsPrefab.h"
 #include "Possession.h"
 #include "Expire.h"
 #include "Stats.h"
@@ -119,8 +120,12 @@ Script::startLua() {
   Game::lua.set("Colour_TRANSPARENT", sf::Color::Transparent);
 
   // REGISTER ENTITY FUNCTIONS
-  Game::lua.new_usertype<ECS::Entity>("Entity",
-    "removeAllComponents", &ECS::Entity::removeAll
+  // Entities are given to Lua as handles so that stale references can be detected
+  Game::lua.new_usertype<ECS::EntityHandle>("Entity",
+    "isValid", sol::property(&Funcs::isValid),
+    "id", sol::property(&ECS::EntityHandle::getId),
+    "removeAllComponents", [](const ECS::EntityHandle& self) { Funcs::resolve(self)->removeAll(); },
+    sol::meta_function::equal_to, &ECS::EntityHandle::operator==
   );
 
   // CORE
@@ -130,6 +135,11 @@ Script::startLua() {
   Animation::registerAnimationType();
   Scene::registerSceneType();
 
+  // PHYSICS
+  // Prefabs are loaded with other resources, before any scene has a physics system
+  RigidBody::registerNonDependantTypes();
+  PhysicsPrefab::registerPhysicsPrefabType();
+
   // GAME MECHANICS
   Spell::registerSpellType();
 
@@ -140,9 +150,9 @@ void
 Script::registerSceneFunctions(sol::environment& env, ECS::World* world) {
 
   // Enable the creation and destruction of entities
-  env.set_function("createEntity", &ECS::World::create, world);
-  env.new_usertype<ECS::Entity>("Entity",
-    "destroy", [world](ECS::Entity& self) { world->destroy(&self);}
+  env.set_function("createEntity", [world]() { return world->create()->getHandle(); });
+  env.new_usertype<ECS::EntityHandle>("Entity",
+    "destroy", [world](const ECS::EntityHandle& self) { world->destroy(world->get(self)); }
   );
 
   // Register components that are not reliant on anything
@@ -151,7 +161,6 @@ Script::registerSceneFunctions(sol::environment& env, ECS::World* world) {
   Sprite::registerSpriteType(env);
   Text::registerTextType(env);
   UIWidget::registerUIWidgetType(env);
-  RigidBody::registerNonDependantTypes(env);
   Possession::registerPossessionType(env);
   Expire::registerExpireType(env);
   Stats::registerStatsType(env);
@@ -179,6 +188,20 @@ void Script::Funcs::emptyFunction() {}
 void Script::Funcs::emptyUpdateFunction(const sf::Time& dt) {}
 void Script::Funcs::emptyWindowEventFunction(const sf::Event& ev) {}
 
+ECS::Entity* Script::Funcs::resolve(const ECS::EntityHandle& handle) {
+  ECS::World* world = Game::getWorld();
+  ECS::Entity* e = world != nullptr ? world->get(handle) : nullptr;
+  if (e == nullptr) {
+    throw sol::error("Attempted to use a deleted entity (id " + std::to_string(handle.getId()) + ")");
+  }
+  return e;
+}
+
+bool Script::Funcs::isValid(const ECS::EntityHandle& handle) {
+  ECS::World* world = Game::getWorld();
+  return world != nullptr && world->isValid(handle);
+}
+
 int Script::Funcs::randomInt(int from, int to) {
   if (to <= from) { return from; }
   return from + std::rand() % (to - from + 1);
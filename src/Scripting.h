@@ -9,6 +9,7 @@
 #include <string>
 
 #include "Sol.h"
+#include "Profiler.h"
 #include "ECS.h"
 #include "Game.h"
 
@@ -45,17 +46,25 @@ namespace Script {
     // ENTITY COMPONENT FUNCTIONS //
     ////////////////////////////////
 
+    // Lua only holds entity handles, get the entity in the current world
+    // Raises a Lua error if the entity has been deleted
+    ECS::Entity* resolve(const ECS::EntityHandle& handle);
+
+    // Check whether a handle still refers to an entity
+    bool isValid(const ECS::EntityHandle& handle);
+
     // Generic component defaults for Lua
-    template <typename T> T& assign(ECS::Entity* e) { return (e->assign<T>(e)).get(); }
-    template <typename T> bool has(ECS::Entity* e) { return e->has<T>(); }
-    template <typename T> T& get(ECS::Entity* e) { return (e->get<T>()).get(); }
-    template <typename T> void remove(ECS::Entity* e) {e->remove<T>();}
+    // Components move when their entity changes, so scripts should keep entities and get components when needed
+    template <typename T> T& assign(const ECS::EntityHandle& h) { ECS::Entity* e = resolve(h); return (e->assign<T>(e)).get(); }
+    template <typename T> bool has(const ECS::EntityHandle& h) { return resolve(h)->has<T>(); }
+    template <typename T> T& get(const ECS::EntityHandle& h) { return (resolve(h)->get<T>()).get(); }
+    template <typename T> void remove(const ECS::EntityHandle& h) { resolve(h)->remove<T>(); }
   };
 
   // Convenience function for defining glue code in Lua
   template <typename T> void
   registerComponentToEntity(sol::environment& env, const std::string& name) {
-    sol::usertype<ECS::Entity> entityType = Game::lua["Entity"];
+    sol::usertype<ECS::EntityHandle> entityType = Game::lua["Entity"];
     entityType.set("assign" + name, &Funcs::assign<T>);
     entityType.set("has" + name, &Funcs::has<T>);
     entityType.set("get" + name, &Funcs::get<T>);
@@ -0,0 +1,137 @@
+// SpatialGrid.cpp
+// Loose uniform grid used to find entities in an area of the world
+
+#include "SpatialGrid.h"
+
+// Constructor
+SpatialGrid::SpatialGrid(float cellSize)
+  : cellSize_(cellSize)
+  , count_(0) {
+}
+
+// Place an entity, the grid is only changed when it moves to another cell
+void
+SpatialGrid::update(const ECS::EntityHandle& handle, const sf::FloatRect& bounds) {
+
+  // Work out which cell the entity belongs in
+  bool large;
+  uint64_t cell;
+  getPlacement(bounds, large, cell);
+
+  // Make room for the record
+  const uint32_t index = handle.getIndex();
+  if (index >= records_.size()) {
+    records_.resize(index + 1, Record{ 0, false, 0, 0 });
+  }
+
+  // Nothing to do if it's already in the right place
+  Record& record = records_[index];
+  if (record.generation == handle.getGeneration()) {
+    if (record.large == large && record.cell == cell) { return; }
+    unlink(record);
+  }
+
+  // A different entity that used this handle index before is still listed
+  else if (record.generation != 0) {
+    unlink(record);
+  }
+  else {
+    ++count_;
+  }
+
+  // Add to the new cell
+  auto& list = getList(large, cell);
+  record.generation = handle.getGeneration();
+  record.large = large;
+  record.cell = cell;
+  record.slot = list.size();
+  list.push_back(handle);
+}
+
+// Stop tracking an entity
+void
+SpatialGrid::remove(const ECS::EntityHandle& handle) {
+  const uint32_t index = handle.getIndex();
+  if (index >= records_.size()) { return; }
+  Record& record = records_[index];
+  if (record.generation == 0 || record.generation != handle.getGeneration()) { return; }
+  unlink(record);
+  record.generation = 0;
+  --count_;
+}
+
+// Check whether an entity is tracked
+bool
+SpatialGrid::contains(const ECS::EntityHandle& handle) const {
+  const uint32_t index = handle.getIndex();
+  return index < records_.size() && records_[index].generation != 0 && records_[index].generation == handle.getGeneration();
+}
+
+// Check whether an entity is tracked in the cell its bounds belong in
+bool
+SpatialGrid::isPlaced(const ECS::EntityHandle& handle, const sf::FloatRect& bounds) const {
+  if (!contains(handle)) { return false; }
+  bool large;
+  uint64_t cell;
+  getPlacement(bounds, large, cell);
+  const Record& record = records_[handle.getIndex()];
+  return record.large == large && record.cell == cell;
+}
+
+// Forget every entity
+void
+SpatialGrid::clear() {
+  records_.clear();
+  cells_.clear();
+  large_.clear();
+  count_ = 0;
+}
+
+// Get how many entities are being tracked
+std::size_t
+SpatialGrid::getCount() const {
+  return count_;
+}
+
+// Get how many cells have been used
+std::size_t
+SpatialGrid::getCellCount() const {
+  return cells_.size();
+}
+
+// Get the key of the cell containing a point
+uint64_t
+SpatialGrid::getCellKey(int x, int y) const {
+  return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+// Work out which cell bounds belong in by their centre, or whether they're too big for one
+void
+SpatialGrid::getPlacement(const sf::FloatRect& bounds, bool& large, uint64_t& cell) const {
+  large = bounds.width > cellSize_ || bounds.height > cellSize_;
+  cell = 0;
+  if (!large) {
+    const int x = (int)std::floor((bounds.left + bounds.width * 0.5f) / cellSize_);
+    const int y = (int)std::floor((bounds.top + bounds.height * 0.5f) / cellSize_);
+    cell = getCellKey(x, y);
+  }
+}
+
+// Get the list for a cell, or the list of large entities
+std::vector<ECS::EntityHandle>&
+SpatialGrid::getList(bool large, uint64_t cell) {
+  if (large) { return large_; }
+  return cells_[cell];
+}
+
+// Take an entity out of its list
+void
+SpatialGrid::unlink(const Record& record) {
+
+  // Swap the last entity in the list into this one's place
+  auto& list = getList(record.large, record.cell);
+  const ECS::EntityHandle last = list.back();
+  list[record.slot] = last;
+  records_[last.getIndex()].slot = record.slot;
+  list.pop_back();
+}
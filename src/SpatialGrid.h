@@ -0,0 +1,115 @@
+// SpatialGrid.h
+// Loose uniform grid used to find entities in an area of the world
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+
+#include <SFML/Graphics.hpp>
+
+#include "Profiler.h"
+#include "ECS.h"
+
+// Buckets entities into square cells by the centre of their bounds
+// Anything can overlap into neighbouring cells by up to half a cell, so queries look that much further out
+// Entities bigger than a cell are kept to one side and returned by every query
+class SpatialGrid {
+  public:
+
+    // Constructor
+    SpatialGrid(float cellSize = 256.f);
+
+    // Place an entity, the grid is only changed when it moves to another cell
+    void update(const ECS::EntityHandle& handle, const sf::FloatRect& bounds);
+
+    // Stop tracking an entity
+    void remove(const ECS::EntityHandle& handle);
+
+    // Check whether an entity is tracked, and whether it's in the cell its bounds belong in
+    // Neither changes the grid, so they're safe to call from several threads while nothing updates it
+    bool contains(const ECS::EntityHandle& handle) const;
+    bool isPlaced(const ECS::EntityHandle& handle, const sf::FloatRect& bounds) const;
+
+    // Forget every entity
+    void clear();
+
+    // Call a function with every entity that could overlap the area
+    template<typename Func>
+    void query(const sf::FloatRect& area, Func&& func) const;
+
+    // Get how many entities are being tracked
+    std::size_t getCount() const;
+
+    // Get how many cells have been used
+    std::size_t getCellCount() const;
+
+  private:
+
+    // Where an entity is in the grid
+    struct Record {
+      uint32_t generation;
+      bool large;
+      uint64_t cell;
+      std::size_t slot;
+    };
+
+    // Size of each cell in pixels
+    const float cellSize_;
+
+    // Records indexed by entity handle index, a generation of 0 is not tracked
+    std::vector<Record> records_;
+
+    // Entities in each cell, and entities too big for a cell
+    // Cells are kept when they empty so entities moving back and forth don't reallocate them
+    std::unordered_map<uint64_t, std::vector<ECS::EntityHandle>> cells_;
+    std::vector<ECS::EntityHandle> large_;
+
+    // How many entities are being tracked
+    std::size_t count_;
+
+    // Get the key of the cell containing a point
+    uint64_t getCellKey(int x, int y) const;
+
+    // Work out which cell bounds belong in, or whether they're too big for one
+    void getPlacement(const sf::FloatRect& bounds, bool& large, uint64_t& cell) const;
+
+    // Get the list for a cell, or the list of large entities
+    std::vector<ECS::EntityHandle>& getList(bool large, uint64_t cell);
+
+    // Take an entity out of its list
+    void unlink(const Record& record);
+};
+
+// Call a function with every entity that could overlap the area
+template<typename Func>
+void
+SpatialGrid::query(const sf::FloatRect& area, Func&& func) const {
+
+  // Anything big is always a candidate
+  for (const auto& handle : large_) {
+    func(handle);
+  }
+
+  // Look half a cell further out than the area, as that is as far as anything can overlap
+  const float margin = cellSize_ * 0.5f;
+  const int left = (int)std::floor((area.left - margin) / cellSize_);
+  const int top = (int)std::floor((area.top - margin) / cellSize_);
+  const int right = (int)std::floor((area.left + area.width + margin) / cellSize_);
+  const int bottom = (int)std::floor((area.top + area.height + margin) / cellSize_);
+  for (int y = top; y <= bottom; ++y) {
+    for (int x = left; x <= right; ++x) {
+      const auto it = cells_.find(getCellKey(x, y));
+      if (it != cells_.end()) {
+        for (const auto& handle : it->second) {
+          func(handle);
+        }
+      }
+    }
+  }
+}
+
+#endif
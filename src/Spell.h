@@ -34,12 +34,14 @@ class Spell {
     : name_("unnamed_spell") {}
 
     // Major component
-    void cast(ECS::Entity* const e) { safeCast(onCast_, e); }
-    void release(ECS::Entity* const e) { safeCast(onRelease_, e); }
+    // Spells receive handles as scripts may keep the caster around after it dies
+    void cast(const ECS::EntityHandle& e) { safeCast(onCast_, e); }
+    void release(const ECS::EntityHandle& e) { safeCast(onRelease_, e); }
 
     // Casts every frame
-    void passive(ECS::Entity* const e, const sf::Time& dt) { 
+    void passive(const ECS::EntityHandle& e, const sf::Time& dt) { 
       if (onPassive_.valid()) {
+        PROFILE_SCOPE("Spell::passive");
         auto attempt = onPassive_(e, dt);
         if (!attempt.valid()) {
           sol::error err = attempt;
@@ -57,7 +59,7 @@ class Spell {
   private:
 
     // Cast a spell comopnent
-    void safeCast(sol::protected_function& spell, ECS::Entity* const e) {
+    void safeCast(sol::protected_function& spell, const ECS::EntityHandle& e) {
 
       // If the script is valid, try to run it
       if (spell.valid()) {
@@ -26,6 +26,12 @@ class SpellSystem : public ECS::EntitySystem {
       });
     }
 
+    // Constructor, spells are scripted so this system runs exclusively
+    SpellSystem() {
+      setName("SpellSystem");
+      writes<Abilities>();
+    }
+
     // Update spell components
     virtual void update(ECS::World* world, const sf::Time& dt) override {
 
@@ -9,6 +9,7 @@ Sprite::Sprite(ECS::Entity* e, float frameInterval, bool paused, bool looped)
   , lockAnimation(false)
   , flipX(false)
   , flipY(false)
+  , layer(0)
   , texture_(nullptr)
   , animation_(nullptr)
   , frameTime_(sf::seconds(frameInterval))
@@ -20,7 +21,8 @@ Sprite::Sprite(ECS::Entity* e, float frameInterval, bool paused, bool looped)
   , spriteSheetAnchor_(sf::Vector2i(0, 0))
   , size_(1.f, 1.f)
   , scale_(1.f, 1.f)
-  , origin_(0.5f, 0.5f) {
+  , origin_(0.5f, 0.5f)
+  , resized_(true) {
 }
 
 // Allow the sprite to be constructed from the resource manager
@@ -222,9 +224,12 @@ Sprite::getLocalBounds() const {
 }
 
 // Get the bounds of the sprite in world space
+// The local bounds are in texture space, so use the quad that is actually drawn
 sf::FloatRect 
 Sprite::getGlobalBounds() const {
-  return getTransform().transformRect(getLocalBounds());
+  const sf::Vector2f topLeft = vertices_[0].position;
+  const sf::Vector2f bottomRight = vertices_[2].position;
+  return getTransform().transformRect(sf::FloatRect(topLeft, bottomRight - topLeft));
 }
 
 // Set which frame to play from
@@ -232,11 +237,15 @@ void
 Sprite::updateSprite() {
 
   // Set up vertices in local space with respect to the origin
+  // Changing frame keeps the same quad, so the bounds have only changed if its corners have
+  const sf::Vector2f topLeft = vertices_[0].position;
+  const sf::Vector2f bottomRight = vertices_[2].position;
   sf::Vector2f originOffset = sf::Vector2f(origin_.x * size_.x * scale_.x, origin_.y * size_.y * scale_.y);
   vertices_[0].position = sf::Vector2f(- originOffset.x, - originOffset.y);
   vertices_[1].position = sf::Vector2f(- originOffset.x, (1.f - originOffset.y) + size_.y * scale_.y);
   vertices_[2].position = sf::Vector2f((1.f - originOffset.x) + size_.x * scale_.x, (1.f - originOffset.y) + size_.y * scale_.y);
   vertices_[3].position = sf::Vector2f((1.f - originOffset.x) + size_.x * scale_.x, - originOffset.y);
+  if (vertices_[0].position != topLeft || vertices_[2].position != bottomRight) { resized_ = true; }
 
   // Get the local bounds for the texture
   const auto rect = getLocalBounds();
@@ -302,6 +311,22 @@ Sprite::getTextureSize() const {
   return sf::Vector2f(rect.width, rect.height);
 }
 
+// Get the texture used by this sprite
+const sf::Texture*
+Sprite::getTexture() const {
+  return texture_;
+}
+
+// Write this sprite's quad in world space to four vertices, for batching
+void
+Sprite::getVertices(sf::Vertex* out) const {
+  const sf::Transform& transform = getTransform();
+  for (int i = 0; i < 4; ++i) {
+    out[i] = vertices_[i];
+    out[i].position = transform.transformPoint(vertices_[i].position);
+  }
+}
+
 // Make world coords (such as origin coords) relative to texture size
 sf::Vector2f 
 Sprite::scaleToLocal(const sf::Vector2f& c) const {
@@ -337,6 +362,7 @@ Sprite::showDebugInformation() {
   ImGui::Text("Sprite size: %f, %f", size_.x, size_.y);
   ImGui::Text("Sprite scale: %f, %f", scale_.x, scale_.y);
   ImGui::Text("Sprite origin: %f, %f", origin_.x, origin_.y);
+  ImGui::Text("Layer: %d", layer);
   ImGui::Text("Sprite Colour:"); ImGui::SameLine(); 
   auto originalColour = getColour();
   auto col = showColourPicker(originalColour); 
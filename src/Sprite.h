@@ -26,6 +26,7 @@ class Sprite : Component, public sf::Drawable, public sf::Transformable {
       // Add extra sprite functionality
       env.new_usertype<Sprite>("Sprite",
         "lock", &Sprite::lockAnimation,
+        "layer", &Sprite::layer,
         "flipX", &Sprite::flipX,
         "flipY", &Sprite::flipY,
         "size", &Sprite::size_,
@@ -65,6 +66,9 @@ class Sprite : Component, public sf::Drawable, public sf::Transformable {
     // Whether we should flip the sprite vertically
     bool flipY;
 
+    // Draw order, sprites on higher layers are drawn on top
+    int layer;
+
     // Allow the sprite to be constructed from the resource manager
     bool setSpriteFromResources(const std::string& texName);
 
@@ -93,6 +97,7 @@ class Sprite : Component, public sf::Drawable, public sf::Transformable {
     bool playAnimation(const std::string& name, bool restart = false);
 
     // Play an animation with a callback
+    // The callback may be run from a worker thread while animations update
     bool playAnimationWithCallback(const std::string& name, std::function<void()> callback);
 
     // Pause the current animation
@@ -128,12 +133,21 @@ class Sprite : Component, public sf::Drawable, public sf::Transformable {
     // Update animation
     void updateAnimation(const sf::Time& dt);
 
+    // Check whether the bounds may have changed without the sprite moving, since this was last asked
+    bool takeResized() { const bool resized = resized_; resized_ = false; return resized; }
+
     // Reset the callback
     void resetCallback() { callback_ = std::function<void()>(); }
 
     // Get the width and height of texture
     sf::Vector2f getTextureSize() const;
 
+    // Get the texture used by this sprite
+    const sf::Texture* getTexture() const;
+
+    // Write this sprite's quad in world space to four vertices, for batching
+    void getVertices(sf::Vertex* out) const;
+
     // Shows the debug information to ImGui
     void showDebugInformation();
 
@@ -184,6 +198,9 @@ class Sprite : Component, public sf::Drawable, public sf::Transformable {
     // @TODO: Write this comment
     sf::Vertex vertices_[4];
 
+    // Whether the quad has been rebuilt
+    bool resized_;
+
     // Render this sprite
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 
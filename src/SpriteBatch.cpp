@@ -0,0 +1,207 @@
+// SpriteBatch.cpp
+// Draws many sprites with as few draw calls as possible
+
+#include "SpriteBatch.h"
+
+#include <algorithm>
+
+#include "Sprite.h"
+
+// Texture key used for text, which can't be batched, so it sorts after its layer's sprites
+static const uint32_t UnbatchedKey = 0x7FFFFFFF;
+
+// Text index used by batches of sprites
+static const std::size_t NoText = (std::size_t)-1;
+
+// Constructor
+SpriteBatch::SpriteBatch()
+  : spriteCount_(0) {
+}
+
+// Forget everything added last frame, but keep the memory
+void
+SpriteBatch::clear() {
+  items_.clear();
+  batches_.clear();
+  texts_.clear();
+  spriteCount_ = 0;
+}
+
+// Add a sprite to be batched with others on its layer that share its texture
+void
+SpriteBatch::add(const Sprite& sprite, int layer, bool overlay) {
+
+  // Sprites without a texture aren't drawn
+  const sf::Texture* texture = sprite.getTexture();
+  if (texture == nullptr) { return; }
+
+  items_.push_back({ makeKey(overlay, layer, texture->getNativeHandle()), &sprite, nullptr });
+  ++spriteCount_;
+}
+
+// Add text, which can't be batched so is drawn on its own after its layer's sprites
+void
+SpriteBatch::add(const sf::Text& text, int layer, bool overlay) {
+  items_.push_back({ makeKey(overlay, layer, UnbatchedKey), nullptr, &text });
+}
+
+// Sort everything that was added and build the vertices
+void
+SpriteBatch::build() {
+
+  // Order by layer, then texture
+  // The order only depends on the keys, so with as many items as last frame only those whose key changed need moving
+  // Lots of changes, such as the view jumping somewhere else, are quicker to sort from scratch
+  if (items_.size() != sortedKeys_.size()) {
+    radixSort();
+  }
+  else {
+    changed_.clear();
+    for (std::size_t i = 0; i < items_.size(); ++i) {
+      if (items_[i].key != sortedKeys_[i]) { changed_.push_back(i); }
+    }
+    if (changed_.size() > items_.size() / 8) { radixSort(); }
+    else if (!changed_.empty()) { reinsertChanged(); }
+  }
+
+  // Write each sprite's quad, starting a new batch whenever the key changes
+  vertices_.resize(spriteCount_ * 4);
+  std::size_t next = 0;
+  for (std::size_t i = 0; i < order_.size(); ++i) {
+    const Item& item = items_[order_[i]];
+
+    // Text always gets a batch to itself
+    if (item.text != nullptr) {
+      batches_.push_back({ nullptr, 0, 0, texts_.size() });
+      texts_.push_back(*item.text);
+      continue;
+    }
+
+    // Join the previous batch if it uses the same layer and texture
+    const Item* previous = i > 0 ? &items_[order_[i - 1]] : nullptr;
+    if (previous == nullptr || previous->key != item.key || previous->text != nullptr) {
+      batches_.push_back({ item.sprite->getTexture(), next, 0, NoText });
+    }
+    item.sprite->getVertices(&vertices_[next]);
+    batches_.back().count += 4;
+    next += 4;
+  }
+}
+
+// Get how many sprites were added
+unsigned
+SpriteBatch::getSpriteCount() const {
+  return spriteCount_;
+}
+
+// Get how many draw calls drawing the batch will take
+unsigned
+SpriteBatch::getDrawCallCount() const {
+  return batches_.size();
+}
+
+// Make a sorting key from a layer and a texture
+// From the top bit down, the key holds whether this is an overlay, the layer, then the texture
+uint64_t
+SpriteBatch::makeKey(bool overlay, int layer, uint32_t texture) {
+
+  // Flip the sign bit so negative layers sort before positive ones
+  const uint32_t orderedLayer = static_cast<uint32_t>(layer) ^ 0x80000000u;
+  return (static_cast<uint64_t>(overlay) << 63)
+    | (static_cast<uint64_t>(orderedLayer) << 31)
+    | (texture & UnbatchedKey);
+}
+
+// Sort items by key, keeping items with equal keys in the order they were added
+void
+SpriteBatch::radixSort() {
+
+  // Remember the keys the order was made from, and start from the order items were added
+  const std::size_t count = items_.size();
+  sortedKeys_.resize(count);
+  order_.resize(count);
+  scratch_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    sortedKeys_[i] = items_[i].key;
+    order_[i] = i;
+  }
+
+  // Least significant byte first, each pass is a stable counting sort
+  std::vector<uint32_t>* from = &order_;
+  std::vector<uint32_t>* to = &scratch_;
+  for (unsigned shift = 0; shift < 64; shift += 8) {
+
+    // Count how many items have each value of this byte
+    std::size_t counts[256] = {};
+    for (uint32_t index : *from) {
+      ++counts[(sortedKeys_[index] >> shift) & 0xFF];
+    }
+
+    // Most bytes are the same for every item (few layers, few textures) so skip those passes
+    if (from->empty() || counts[(sortedKeys_[from->front()] >> shift) & 0xFF] == from->size()) { continue; }
+
+    // Turn counts into where each value starts, then scatter
+    std::size_t offset = 0;
+    for (std::size_t& bucket : counts) {
+      const std::size_t start = offset;
+      offset += bucket;
+      bucket = start;
+    }
+    for (uint32_t index : *from) {
+      (*to)[counts[(sortedKeys_[index] >> shift) & 0xFF]++] = index;
+    }
+    std::swap(from, to);
+  }
+
+  // Make sure the result ends up in order_
+  if (from != &order_) {
+    order_.swap(scratch_);
+  }
+}
+
+// Take the changed items out of the order, then merge them back in where their new keys go
+// Unchanged items are still sorted by key and then by when they were added, so this gives the same order as sorting
+void
+SpriteBatch::reinsertChanged() {
+
+  // Both orders compare keys, then when the items were added
+  auto before = [this](uint32_t a, uint32_t b) {
+    return sortedKeys_[a] < sortedKeys_[b] || (sortedKeys_[a] == sortedKeys_[b] && a < b);
+  };
+
+  // Update the keys, and sort just the changed items
+  isChanged_.assign(items_.size(), false);
+  for (uint32_t index : changed_) {
+    sortedKeys_[index] = items_[index].key;
+    isChanged_[index] = true;
+  }
+  std::sort(changed_.begin(), changed_.end(), before);
+
+  // Merge them with everything else
+  scratch_.clear();
+  std::size_t next = 0;
+  for (uint32_t index : order_) {
+    if (isChanged_[index]) { continue; }
+    while (next < changed_.size() && before(changed_[next], index)) {
+      scratch_.push_back(changed_[next++]);
+    }
+    scratch_.push_back(index);
+  }
+  scratch_.insert(scratch_.end(), changed_.begin() + next, changed_.end());
+  order_.swap(scratch_);
+}
+
+// Draw every batch
+void
+SpriteBatch::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+  for (const Batch& batch : batches_) {
+    if (batch.text != NoText) {
+      target.draw(texts_[batch.text], states);
+    }
+    else {
+      sf::RenderStates batchStates = states;
+      batchStates.texture = batch.texture;
+      target.draw(&vertices_[batch.first], batch.count, sf::Quads, batchStates);
+    }
+  }
+}
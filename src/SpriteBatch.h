@@ -0,0 +1,98 @@
+// SpriteBatch.h
+// Draws many sprites with as few draw calls as possible
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <vector>
+#include <cstdint>
+
+#include <SFML/Graphics.hpp>
+
+class Sprite;
+
+// Collects everything drawn in a frame, sorted by layer and then by texture
+// Neighbouring sprites that share a texture are drawn together in one call
+// Overlays such as the UI are drawn after everything else, sorted by their own layers
+// Once built, the batch holds copies of everything it needs, so it can be drawn while the world changes
+class SpriteBatch : public sf::Drawable {
+  public:
+
+    // Constructor
+    SpriteBatch();
+
+    // Forget everything added last frame, but keep the memory
+    void clear();
+
+    // Add a sprite to be batched with others on its layer that share its texture
+    void add(const Sprite& sprite, int layer = 0, bool overlay = false);
+
+    // Add text, which can't be batched so is drawn on its own after its layer's sprites
+    void add(const sf::Text& text, int layer = 0, bool overlay = false);
+
+    // Sort everything that was added and build the vertices
+    // If as many things were added as last frame, only those whose layer or texture changed are sorted again
+    void build();
+
+    // Get how many sprites were added
+    unsigned getSpriteCount() const;
+
+    // Get how many draw calls drawing the batch will take
+    unsigned getDrawCallCount() const;
+
+  private:
+
+    // Something waiting to be sorted
+    // The key orders by layer and then by texture
+    struct Item {
+      uint64_t key;
+      const Sprite* sprite;
+      const sf::Text* text;
+    };
+
+    // A run of quads sharing a texture, or a single text
+    struct Batch {
+      const sf::Texture* texture;
+      std::size_t first;
+      std::size_t count;
+      std::size_t text;
+    };
+
+    // Items added this frame
+    std::vector<Item> items_;
+
+    // Indices of the items in draw order, and the key each index had when it was sorted
+    std::vector<uint32_t> order_;
+    std::vector<uint64_t> sortedKeys_;
+
+    // Space for sorting, and which indices have a different key to last frame
+    std::vector<uint32_t> scratch_;
+    std::vector<uint32_t> changed_;
+    std::vector<bool> isChanged_;
+
+    // The quads of every sprite in world space, in draw order
+    std::vector<sf::Vertex> vertices_;
+
+    // Copies of every text, in draw order
+    std::vector<sf::Text> texts_;
+
+    // Everything to draw, in order
+    std::vector<Batch> batches_;
+
+    // How many sprites were added
+    unsigned spriteCount_;
+
+    // Make a sorting key from a layer and a texture
+    static uint64_t makeKey(bool overlay, int layer, uint32_t texture);
+
+    // Sort items by key, keeping items with equal keys in the order they were added
+    void radixSort();
+
+    // Take the changed items out of the order, then merge them back in where their new keys go
+    void reinsertChanged();
+
+    // Draw every batch
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+};
+
+#endif
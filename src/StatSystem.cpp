@@ -19,6 +19,15 @@ StatSystem::registerStatSystem(sol::environment& env, ECS::World* world) {
   });
 }
 
+// Constructor
+// Missing components are assigned through the world's command buffer, so this can run anywhere
+StatSystem::StatSystem() {
+  setName("StatSystem");
+  reads<Stats>();
+  writes<Movement, Combat>();
+  setAffinity(Affinity::Any);
+}
+
 // Write to appropriate components
 void 
 StatSystem::update(ECS::World* world, const sf::Time& dt) {
@@ -29,17 +38,24 @@ StatSystem::update(ECS::World* world, const sf::Time& dt) {
     // Get stats component
     const Stats& stats = s.get();
 
-    // Write movement stats
-    bool missing = !e->has<Movement>();
-    if (missing) { e->assign<Movement>(e); }
+    // Write movement stats, missing components are written before being assigned
+    // as the assignment may not happen until the end of the update
     auto movement = e->get<Movement>();
-    writeMovementStats(stats, movement.get(), missing);
+    if (movement.isValid()) { writeMovementStats(stats, movement.get(), false); }
+    else {
+      Movement newMovement(e);
+      writeMovementStats(stats, newMovement, true);
+      e->assign<Movement>(newMovement);
+    }
 
     // Write combat stats
-    missing = !e->has<Combat>();
-    if (missing) { e->assign<Combat>(e); }
     auto combat = e->get<Combat>();
-    writeCombatStats(stats, combat.get(), missing);
+    if (combat.isValid()) { writeCombatStats(stats, combat.get(), false); }
+    else {
+      Combat newCombat(e);
+      writeCombatStats(stats, newCombat, true);
+      e->assign<Combat>(newCombat);
+    }
 
   });
 }
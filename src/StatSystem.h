@@ -18,6 +18,9 @@ class StatSystem : public ECS::EntitySystem {
     // Register this system in the world
     static void registerStatSystem(sol::environment& env, ECS::World* world);
 
+    // Constructor, declare component access for scheduling
+    StatSystem();
+
     // Write to appropriate components
     virtual void update(ECS::World* world, const sf::Time& dt) override;
 
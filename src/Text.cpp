@@ -29,6 +29,7 @@ Text::setFontFromResources(const std::string& fontName) {
 
   // Set the font of this text
   setFont(font->getFont());
+  resized_ = true;
   return true;
 }
 
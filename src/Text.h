@@ -24,16 +24,16 @@ class Text : Component, public sf::Text {
       env.new_usertype<Text>("Text",
         "text", sol::property(
           [](const Text& self) { return std::string(self.getString()); },
-          [](Text& self, const std::string& text) { self.setString(text); }),
+          [](Text& self, const std::string& text) { self.setString(text); self.resized_ = true; }),
         "size", sol::property(
           &sf::Text::getCharacterSize,
-          &sf::Text::setCharacterSize),
+          [](Text& self, unsigned size) { self.setCharacterSize(size); self.resized_ = true; }),
         "lineSpacing", sol::property(
           &sf::Text::getLineSpacing,
-          &sf::Text::setLineSpacing),
+          [](Text& self, float spacing) { self.setLineSpacing(spacing); self.resized_ = true; }),
         "outlineThickness", sol::property(
           &sf::Text::getOutlineThickness,
-          &sf::Text::setOutlineThickness),
+          [](Text& self, float thickness) { self.setOutlineThickness(thickness); self.resized_ = true; }),
         "fillColour", sol::property(
           &sf::Text::getFillColor,
           &sf::Text::setFillColor),
@@ -42,13 +42,14 @@ class Text : Component, public sf::Text {
           &sf::Text::setOutlineColor),
         "scale", sol::property(
           &sf::Text::getScale,
-          [](Text& self, const sf::Vector2f& scale) { self.setScale(scale); }),
+          [](Text& self, const sf::Vector2f& scale) { self.setScale(scale); self.resized_ = true; }),
         "origin", sol::property(
           &sf::Text::getOrigin,
-          [](Text& self, const sf::Vector2f& origin) { self.setOrigin(origin); }),
+          [](Text& self, const sf::Vector2f& origin) { self.setOrigin(origin); self.resized_ = true; }),
         "setRelativeOrigin", &Text::setRelativeOrigin,
         "centerText", &Text::centerText,
-        "setFont", &Text::setFontFromResources
+        "setFont", &Text::setFontFromResources,
+        "layer", &Text::layer
       );
 
       // Allow access to default font
@@ -62,19 +63,27 @@ class Text : Component, public sf::Text {
 
     // Constructor
     Text(ECS::Entity* e, const std::string& text = "", const std::string& font = "")
-      : Component(e) {
+      : Component(e)
+      , layer(0)
+      , resized_(true) {
       setString(text);
       setFontFromResources(font != "" ? font : defaultFontName_);
       setRelativeOrigin(0.5f, 0.5f);
     }
 
+    // Draw order, text on higher layers is drawn on top
+    int layer;
+
     // Gets a font from the resource manager for this component to use
     bool setFontFromResources(const std::string& font);
 
     // Sets the origin in relation to size of the text
+    // Measuring text needs the font's glyph textures, so this does nothing when headless
     void setRelativeOrigin(float x, float y) {
+      if (Game::isHeadless()) { return; }
       const sf::FloatRect size = getLocalBounds();
       setOrigin(x * size.width, y * size.height);
+      resized_ = true;
     }
 
     // Easily center the text
@@ -82,6 +91,9 @@ class Text : Component, public sf::Text {
       setRelativeOrigin(0.5f, 0.5f); 
     }
 
+    // Check whether the bounds may have changed without the text moving, since this was last asked
+    bool takeResized() { const bool resized = resized_; resized_ = false; return resized; }
+
     // Shows the debug information to ImGui
     void showDebugInformation();
 
@@ -90,6 +102,9 @@ class Text : Component, public sf::Text {
     // Font to use by default
     static std::string defaultFontName_;
 
+    // Whether the string, font, size or origin have changed
+    bool resized_;
+
 };
 
 #endif
@@ -40,7 +40,9 @@ class Texture {
     sf::Texture texture_;
 
     // Load texture from filepath
+    // Without a window there's no graphics context to upload to, and nothing is drawn anyway
     void loadFromFilepath() {
+      if (Game::isHeadless()) { return; }
       if (!texture_.loadFromFile(filepath_)) { 
         Console::log("[Error] Could not load texture from path: %s", filepath_.c_str());
       }
@@ -4,6 +4,8 @@
 #ifndef TRANSFORM_H
 #define TRANSFORM_H
 
+#include <cmath>
+
 #include "Game.h"
 #include "Scripting.h"
 
@@ -20,7 +22,8 @@ class Transform : Component {
       // Create the Transform usertype
       env.new_usertype<Transform>("Transform",
         "position", &Transform::position,
-        "rotation", &Transform::rotation
+        "rotation", &Transform::rotation,
+        "teleport", &Transform::teleport
       );
     }
 
@@ -28,11 +31,17 @@ class Transform : Component {
     Transform(ECS::Entity* e, float x = 0.f, float y = 0.f, float r = 0.f)
       : Component(e)
       , position(sf::Vector2f(x, y))
-      , rotation(r) {}
+      , rotation(r)
+      , previousPosition(position)
+      , previousRotation(r)
+      , hasPrevious_(false) {}
     Transform(ECS::Entity* e, const sf::Vector2f& pos, float r = 0.f)
       : Component(e)
       , position(pos)
-      , rotation(r) {}
+      , rotation(r)
+      , previousPosition(pos)
+      , previousRotation(r)
+      , hasPrevious_(false) {}
 
     // Position of the entity to render
     sf::Vector2f position;
@@ -40,6 +49,36 @@ class Transform : Component {
     // Rotation of the entity to render
     float rotation;
 
+    // Position and rotation before the last simulation step
+    sf::Vector2f previousPosition;
+    float previousRotation;
+
+    // Remember where we are before the simulation moves us
+    void recordPrevious() {
+      previousPosition = position;
+      previousRotation = rotation;
+      hasPrevious_ = true;
+    }
+
+    // Stop interpolating from the last position, so a jump isn't rendered as movement
+    void teleport() {
+      recordPrevious();
+    }
+
+    // Get where to render between the previous and current simulation steps
+    // Alpha is how far through the next step we are, from 0 to 1
+    sf::Vector2f getInterpolatedPosition(float alpha) const {
+      if (!hasPrevious_) { return position; }
+      return previousPosition + (position - previousPosition) * alpha;
+    }
+    float getInterpolatedRotation(float alpha) const {
+      if (!hasPrevious_) { return rotation; }
+
+      // Take the shortest way around, so 350 to 10 degrees turns through 0 rather than 180
+      const float difference = std::remainder(rotation - previousRotation, 360.f);
+      return previousRotation + difference * alpha;
+    }
+
     // Shows the debug information to ImGui
     void showDebugInformation() {
       ImGui::NextColumn();
@@ -49,6 +88,12 @@ class Transform : Component {
       ImGui::PopItemWidth();
       ImGui::NextColumn();
     }
+
+  private:
+
+    // Whether a previous state has been recorded yet
+    // Until then the entity is rendered where it is, so newly placed entities don't slide in from the origin
+    bool hasPrevious_;
 };
 
 #endif
@@ -0,0 +1,61 @@
+// TripleBuffer.h
+// Hands the latest of something from one thread to another without locking
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// One thread writes into its own buffer and publishes it, another reads the latest published buffer
+// Neither side ever waits for the other, the writer can publish as often as it likes and the reader
+// only sees whole buffers
+template<typename T>
+class TripleBuffer {
+  public:
+
+    // Constructor
+    TripleBuffer()
+      : write_(0)
+      , middle_(1)
+      , read_(2) {
+    }
+
+    // Get the buffer to fill in, only call from the writing thread
+    T& getWriteBuffer() { return buffers_[write_]; }
+
+    // Hand the write buffer to the reader, and take an old one to write into next
+    void publish() {
+      write_ = middle_.exchange(write_ | FreshBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Check whether something has been published since the reader last acquired
+    bool hasNewer() const {
+      return (middle_.load(std::memory_order_acquire) & FreshBit) != 0;
+    }
+
+    // Swap in the latest published buffer, returns false if there wasn't a newer one
+    bool acquire() {
+      if (!hasNewer()) { return false; }
+      read_ = middle_.exchange(read_, std::memory_order_acq_rel) & IndexMask;
+      return true;
+    }
+
+    // Get the buffer last acquired, only call from the reading thread
+    const T& getReadBuffer() const { return buffers_[read_]; }
+
+  private:
+
+    // The middle index carries a flag for whether it holds something the reader hasn't seen
+    static const unsigned FreshBit = 4;
+    static const unsigned IndexMask = 3;
+
+    // The three buffers
+    T buffers_[3];
+
+    // Which buffer each side owns, the middle one is shared
+    unsigned write_;
+    std::atomic<unsigned> middle_;
+    unsigned read_;
+};
+
+#endif
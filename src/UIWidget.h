@@ -19,23 +19,29 @@ class UIWidget : Component {
 
       // Create the UIWidget usertype
       env.new_usertype<UIWidget>("UIWidget",
-        "anchor", &UIWidget::anchor
+        "anchor", &UIWidget::anchor,
+        "layer", &UIWidget::layer
       );
     }
 
     // Constructors
     UIWidget(ECS::Entity* e)
       : Component(e)
-      , anchor(sf::Vector2f(-1.f, -1.f)) {
+      , anchor(sf::Vector2f(-1.f, -1.f))
+      , layer(0) {
     }
 
     // Where this widget is placed, relative to view
     sf::Vector2f anchor;
 
+    // Draw order among the UI, which is always drawn on top of the world
+    int layer;
+
     // Shows the debug information to ImGui
     void showDebugInformation() {
       ImGui::NextColumn();
       ImGui::Text("HUD anchor: %f, %f", anchor.x, anchor.y);
+      ImGui::Text("HUD layer: %d", layer);
       ImGui::PushItemWidth(-1);
       ImGui::PopItemWidth();
       ImGui::NextColumn();
@@ -2,13 +2,82 @@
 #include "ResourceManager.h"
 #include "Scene.h"
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 #ifdef linux
 #include <X11/Xlib.h>
 #endif
 
-// Create and start the game
+// How to run the game from the command line
+static const char* usage = "Usage: %s [--headless] [--ticks N] [--timestep SECONDS] [--input SCRIPT] [--profile TRACE] [SCENE]\n";
+
+// Read a whole argument as a number, returns false if it isn't one
+static bool
+parseNumber(const std::string& arg, unsigned long& out) {
+  if (arg.empty() || arg[0] == '-') { return false; }
+  try {
+    std::size_t read = 0;
+    out = std::stoul(arg, &read);
+    return read == arg.size();
+  }
+  catch (const std::exception&) { return false; }
+}
+static bool
+parseNumber(const std::string& arg, float& out) {
+  try {
+    std::size_t read = 0;
+    out = std::stof(arg, &read);
+    return read == arg.size();
+  }
+  catch (const std::exception&) { return false; }
+}
+
+// Create and start the game, see usage above
 int main(int argc, char* argv[]) {
 
+  // Read the command line
+  std::string sceneName = "BasicScene";
+  bool headless = false;
+  Game::HeadlessSettings headlessSettings;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--headless") { headless = true; }
+    else if (arg == "--ticks" && hasValue) {
+      unsigned long ticks = 0;
+      if (!parseNumber(argv[++i], ticks) || ticks == 0 || ticks > std::numeric_limits<unsigned>::max()) {
+        printf("Error: --ticks needs a whole number above 0, not %s\n", argv[i]);
+        printf(usage, argv[0]);
+        return 1;
+      }
+      headlessSettings.ticks = (unsigned)ticks;
+    }
+    else if (arg == "--timestep" && hasValue) {
+      float timestep = 0.f;
+      if (!parseNumber(argv[++i], timestep) || !(timestep > 0.f) || !std::isfinite(timestep)) {
+        printf("Error: --timestep needs a number of seconds above 0, not %s\n", argv[i]);
+        printf(usage, argv[0]);
+        return 1;
+      }
+      headlessSettings.timestep = timestep;
+    }
+    else if (arg == "--input" && hasValue) { headlessSettings.inputScript = argv[++i]; }
+    else if (arg == "--profile" && hasValue) { headlessSettings.profilePath = argv[++i]; }
+    else if (arg.rfind("--", 0) == 0) {
+      printf("Error: Unknown or incomplete option %s\n", arg.c_str());
+      printf(usage, argv[0]);
+      return 1;
+    }
+    else { sceneName = arg; }
+  }
+
+  // Simulate without a window if requested
+  if (headless) {
+    Game::setHeadless(headlessSettings);
+  }
+
   // Set up whether we should multi thread or not
   bool multiThread = true, multiThreadSuccess = false;
 
@@ -26,7 +95,8 @@ int main(int argc, char* argv[]) {
 
   // Initialise and start the game
   Game::initialise(sf::VideoMode(1920, 1080), "Game", multiThread && multiThreadSuccess);
-  auto& scene = ResourceManager::getResource("BasicScene");
+  // The scene to start with can be chosen on the command line
+  auto& scene = ResourceManager::getResource(sceneName);
   if (scene.getType() == Resource::Type::SCENE) {
     Game::switchScene((Scene*)scene.get());
     Game::start();
@@ -0,0 +1,149 @@
+// ECSTest.cpp
+// Checks parts of the ECS that are easy to break, exits with a failure if any check fails
+
+#include "../src/ECS.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Count failed checks, reporting where they were
+static int failures = 0;
+#define CHECK(condition) \
+  if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// A component most entities have
+struct Position { float x = 0.f, y = 0.f; };
+
+// Destroys another entity when deleted, like an effect cleaning up what it spawned
+struct Owner {
+  Owner() {}
+  Owner(Owner&& other) : world(other.world), owned(other.owned) { other.owned = nullptr; }
+  Owner& operator=(Owner&& other) { world = other.world; owned = other.owned; other.owned = nullptr; return *this; }
+  ~Owner() { if (world != nullptr && owned != nullptr) { world->destroy(owned); } }
+  ECS::World* world = nullptr;
+  ECS::Entity* owned = nullptr;
+};
+
+// Immediately destroys a victim when a trigger entity is destroyed
+struct Destroyer : public ECS::EventSubscriber<ECS::Events::OnEntityDestroyed> {
+  ECS::Entity* trigger = nullptr;
+  ECS::Entity* victim = nullptr;
+  void receive(ECS::World* world, const ECS::Events::OnEntityDestroyed& event) override {
+    if (event.entity == trigger) { world->destroy(victim, true); }
+  }
+};
+
+// Destroying an entity immediately while cleanup() is deleting it must delete it exactly once
+void
+testDestroyDuringCleanup() {
+  auto* world = ECS::World::createWorld();
+
+  // The owner's entity is deleted first, and its component destroys the spawned entity on the way out
+  ECS::Entity* owner = world->create();
+  ECS::Entity* spawned = world->create();
+  ECS::Entity* victim = world->create();
+  auto component = owner->assign<Owner>();
+  component->world = world;
+  component->owned = spawned;
+
+  // Destroying the spawned entity has the subscriber destroy the victim, which is still waiting in cleanup()
+  Destroyer destroyer;
+  destroyer.trigger = spawned;
+  destroyer.victim = victim;
+  world->subscribe<ECS::Events::OnEntityDestroyed>(&destroyer);
+
+  const ECS::EntityHandle victimHandle = victim->getHandle();
+  world->destroy(owner);
+  world->destroy(victim);
+  CHECK(world->cleanup());
+  CHECK(world->get(victimHandle) == nullptr);
+  CHECK(world->getCount() == 1);
+
+  // The spawned entity was queued during cleanup, so the next one deletes it
+  CHECK(world->cleanup());
+  CHECK(world->getCount() == 0);
+  CHECK(!world->cleanup());
+
+  world->unsubscribeAll(&destroyer);
+  world->destroyWorld();
+}
+
+// Owns something that can't be shared, like a RigidBody's b2Body
+struct MoveOnly {
+  MoveOnly(int v) : value(new int(v)) {}
+  MoveOnly(MoveOnly&& other) = default;
+  MoveOnly& operator=(MoveOnly&& other) = default;
+  std::unique_ptr<int> value;
+};
+
+// Components that can only be moved keep what they own however they're assigned
+void
+testMoveOnlyComponents() {
+  auto* world = ECS::World::createWorld();
+  ECS::Entity* e = world->create();
+  e->assign<Position>();
+  CHECK(*e->assign<MoveOnly>(1)->value == 1);
+
+  // Assigning over an existing component, and while changes are deferred
+  CHECK(*e->assign<MoveOnly>(2)->value == 2);
+  world->parallelEach<Position>([](ECS::Entity* ent, ECS::ComponentHandle<Position> p) {
+    ent->assign<MoveOnly>(3);
+  });
+  CHECK(*e->get<MoveOnly>()->value == 3);
+
+  world->destroyWorld();
+}
+
+// Components keep their values when rows move within and between archetypes
+void
+testComponentsMoveWithRows() {
+  auto* world = ECS::World::createWorld();
+
+  // Enough entities to fill more than one chunk of each column
+  const int count = ECS_COMPONENT_CHUNK_SIZE * 2 + 3;
+  std::vector<ECS::Entity*> entities;
+  for (int i = 0; i < count; ++i) {
+    ECS::Entity* e = world->create();
+    e->assign<Position>(Position{float(i), float(-i)});
+    e->assign<MoveOnly>(i);
+    entities.push_back(e);
+  }
+
+  // Removing rows moves the last row into their place, and removing a component moves the entity elsewhere
+  world->destroy(entities[0], true);
+  entities[1]->remove<MoveOnly>();
+  world->each<Position>([&](ECS::Entity* ent, ECS::ComponentHandle<Position> p) {
+    if (int(p->x) % 3 == 0) { world->destroy(ent, true); }
+  });
+
+  int checked = 0;
+  world->each<Position, MoveOnly>([&](ECS::Entity* ent, ECS::ComponentHandle<Position> p, ECS::ComponentHandle<MoveOnly> m) {
+    CHECK(int(p->x) % 3 != 0);
+    CHECK(p->y == -p->x);
+    CHECK(*m->value == int(p->x));
+    ++checked;
+  });
+  int expected = 0;
+  for (int i = 2; i < count; ++i) {
+    expected += i % 3 != 0;
+  }
+  CHECK(checked == expected);
+  CHECK(entities[1]->get<Position>()->x == 1.f);
+  CHECK(!entities[1]->has<MoveOnly>());
+
+  world->destroyWorld();
+}
+
+int
+main() {
+  testDestroyDuringCleanup();
+  testMoveOnlyComponents();
+  testComponentsMoveWithRows();
+  if (failures > 0) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}